@@ -0,0 +1,345 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Bytes of one asset, filled by AssetPack::load. Stored pack entries and
+// loose files point straight into a mapping, compressed entries into the
+// decoded copy held here. Valid while this and the pack are alive.
+class AssetData {
+public:
+    AssetData() : m_Data(nullptr), m_Size(0) {}
+
+    AssetData(const AssetData &) = delete;
+    AssetData &operator=(const AssetData &) = delete;
+
+    const char *data() const { return m_Data; }
+    size_t size() const { return m_Size; }
+
+private:
+    friend class AssetPack;
+
+    const char *m_Data;
+    size_t m_Size;
+    std::vector<char> m_Storage;
+    MappedFile m_File;
+};
+
+// Single file archive of the viewer's assets, written by
+// tools/pbr_pack.cpp:
+//
+//   Header | Entry[count], sorted by id | names | entries, page aligned
+//
+// The pack is mapped once at startup. An asset is found by the hash of
+// its path with a binary search of the index, no filesystem lookups.
+// Stored entries are used in place, compressed ones (LZ4 block format)
+// are decoded into the AssetData. Paths the pack doesn't have, or every
+// path while no pack is open, load the loose file instead.
+class AssetPack {
+public:
+    static const uint32_t MAGIC = 0x4B524250; // "PBRK"
+    static const uint32_t VERSION = 1;
+    static const size_t ALIGNMENT = 4096;
+    // An LZ4 length byte stands for at most 255 output bytes, so a larger
+    // size in the index is corrupt (and load() would allocate all of it)
+    static const uint64_t MAX_LZ4_RATIO = 255;
+
+    enum Codec {
+        CODEC_STORED,
+        CODEC_LZ4
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+        uint32_t namesSize;
+    };
+
+    struct Entry {
+        uint64_t id;
+        uint64_t offset; // from the start of the pack
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t codec;
+        uint32_t name; // offset in the names block, NUL terminated
+    };
+
+    AssetPack() : m_Entries(nullptr), m_Count(0), m_Names(nullptr) {}
+
+    AssetPack(const AssetPack &) = delete;
+    AssetPack &operator=(const AssetPack &) = delete;
+
+    bool open(const std::string &path) {
+        close();
+        if (!m_File.open(path, MappedFile::ACCESS_NORMAL))
+            return false;
+        const char *data = m_File.data();
+        size_t size = m_File.size();
+        Header header;
+        if (size < sizeof(header))
+            return fail(path);
+        std::memcpy(&header, data, sizeof(header));
+        size_t indexEnd = sizeof(Header) + (size_t)header.count * sizeof(Entry);
+        if (header.magic != MAGIC || header.version != VERSION || indexEnd > size ||
+            header.namesSize > size - indexEnd || (header.count && (header.namesSize == 0 ||
+                                                                    data[indexEnd + header.namesSize - 1] != '\0')))
+            return fail(path);
+        // The mapping is page aligned and Header keeps the index 8 byte aligned
+        const Entry *entries = (const Entry *)(data + sizeof(Header));
+        for (uint32_t i = 0; i < header.count; ++i) {
+            const Entry &entry = entries[i];
+            if (entry.offset > size || entry.storedSize > size - entry.offset || entry.name >= header.namesSize ||
+                entry.codec > CODEC_LZ4 || (entry.codec == CODEC_STORED && entry.storedSize != entry.size) ||
+                (entry.codec == CODEC_LZ4 && entry.size / MAX_LZ4_RATIO > entry.storedSize) ||
+                (i > 0 && entries[i - 1].id >= entry.id))
+                return fail(path);
+        }
+        m_Entries = entries;
+        m_Count = header.count;
+        m_Names = data + indexEnd;
+        return true;
+    }
+
+    void close() {
+        m_File.close();
+        m_Entries = nullptr;
+        m_Count = 0;
+        m_Names = nullptr;
+    }
+
+    bool isOpen() const { return m_File.data() != nullptr; }
+    size_t count() const { return m_Count; }
+    const Entry &entry(size_t index) const { return m_Entries[index]; }
+    const char *name(const Entry &entry) const { return m_Names + entry.name; }
+
+    // Paths are stored with / separators and without a leading ./
+    static std::string normalize(const std::string &path) {
+        std::string result = path;
+        std::replace(result.begin(), result.end(), '\\', '/');
+        size_t start = 0;
+        while (result.compare(start, 2, "./") == 0)
+            start += 2;
+        return result.substr(start);
+    }
+
+    // FNV-1a of the normalized path
+    static uint64_t id(const std::string &path) {
+        std::string name = normalize(path);
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : name)
+            hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+        return hash;
+    }
+
+    const Entry *find(uint64_t id) const {
+        const Entry *end = m_Entries + m_Count;
+        const Entry *entry =
+            std::lower_bound(m_Entries, end, id, [](const Entry &e, uint64_t value) { return e.id < value; });
+        return entry != end && entry->id == id ? entry : nullptr;
+    }
+
+    bool contains(const std::string &path) const { return find(id(path)) != nullptr; }
+
+    // The asset at path, from the pack if it has it, else the loose file.
+    // False without a message when neither exists, callers know whether
+    // that is an error.
+    bool load(const std::string &path, AssetData &data) const {
+        data.m_Storage.clear();
+        data.m_File.close();
+        data.m_Data = nullptr;
+        data.m_Size = 0;
+        if (const Entry *entry = find(id(path)))
+            return load(*entry, data);
+        if (!std::ifstream(path.c_str()) || !data.m_File.open(path))
+            return false;
+        data.m_Data = data.m_File.data();
+        data.m_Size = data.m_File.size();
+        return true;
+    }
+
+    bool load(const Entry &entry, AssetData &data) const {
+        const char *stored = m_File.data() + entry.offset;
+        if (entry.codec == CODEC_STORED) {
+            data.m_Data = stored;
+            data.m_Size = (size_t)entry.size;
+            return true;
+        }
+        data.m_Storage.resize((size_t)entry.size);
+        if (!decompress(stored, (size_t)entry.storedSize, data.m_Storage.data(), data.m_Storage.size())) {
+            std::cout << "ERROR::ASSET_PACK::ENTRY_NOT_DECODED " << name(entry) << std::endl;
+            data.m_Storage.clear();
+            return false;
+        }
+        data.m_Data = data.m_Storage.data();
+        data.m_Size = data.m_Storage.size();
+        return true;
+    }
+
+    // Readahead hint for an asset that is about to be loaded, so its
+    // pages are read while the caller does something else. No-op for
+    // paths not in the pack.
+    void prefetch(const std::string &path) const {
+        if (const Entry *entry = find(id(path)))
+            m_File.prefetch((size_t)entry->offset, (size_t)entry->storedSize);
+    }
+
+    // Counterpart for streaming: drops an entry's pages once its data has
+    // been consumed (uploaded, decoded). Any AssetData still pointing at
+    // it stays valid, the pages are read again if touched.
+    void release(const std::string &path) {
+        if (const Entry *entry = find(id(path)))
+            m_File.release((size_t)entry->offset, (size_t)entry->storedSize);
+    }
+
+    // LZ4 block format, no frame. Greedy matching over a 64K hash table:
+    // far from the best ratio, but decoding is a memcpy loop. Sources
+    // must be under 4 GB.
+    static std::vector<char> compress(const char *source, size_t size) {
+        const unsigned char *src = (const unsigned char *)source;
+        std::vector<char> out;
+        out.reserve(size + size / 255 + 16);
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+        // A block ends in at least LAST_LITERALS literals and no match
+        // starts in its last MATCH_START_LIMIT bytes
+        size_t matchLimit = size > LAST_LITERALS ? size - LAST_LITERALS : 0;
+        size_t startLimit = size > MATCH_START_LIMIT ? size - MATCH_START_LIMIT : 0;
+        size_t anchor = 0, at = 0;
+        while (at < startLimit) {
+            uint32_t sequence = read32(src + at);
+            uint32_t &slot = table[(sequence * 2654435761u) >> (32 - HASH_BITS)];
+            size_t candidate = slot;
+            slot = (uint32_t)at;
+            if (candidate >= at || at - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+                // Step faster the longer nothing matched
+                at += 1 + ((at - anchor) >> 6);
+                continue;
+            }
+            size_t matchEnd = at + MIN_MATCH;
+            while (matchEnd < matchLimit && src[matchEnd] == src[matchEnd - (at - candidate)])
+                ++matchEnd;
+            while (at > anchor && candidate > 0 && src[at - 1] == src[candidate - 1]) {
+                --at;
+                --candidate;
+            }
+            writeSequence(out, src + anchor, at - anchor, at - candidate, matchEnd - at);
+            at = anchor = matchEnd;
+        }
+        writeSequence(out, src + anchor, size - anchor, 0, 0);
+        return out;
+    }
+
+    // Every length is checked against both buffers, a corrupt entry
+    // fails instead of writing out of bounds
+    static bool decompress(const char *source, size_t sourceSize, char *dest, size_t destSize) {
+        const unsigned char *in = (const unsigned char *)source, *inEnd = in + sourceSize;
+        unsigned char *out = (unsigned char *)dest, *outEnd = out + destSize;
+        while (in < inEnd) {
+            unsigned int token = *in++;
+            size_t length = token >> 4;
+            if (!readLength(in, inEnd, length) || length > (size_t)(inEnd - in) || length > (size_t)(outEnd - out))
+                return false;
+            std::copy(in, in + length, out);
+            in += length;
+            out += length;
+            if (in == inEnd)
+                break; // last sequence, literals only
+            if (inEnd - in < 2)
+                return false;
+            size_t offset = in[0] | (size_t)in[1] << 8;
+            in += 2;
+            length = token & 15;
+            if (!readLength(in, inEnd, length))
+                return false;
+            length += MIN_MATCH;
+            if (offset == 0 || offset > (size_t)(out - (unsigned char *)dest) || length > (size_t)(outEnd - out))
+                return false;
+            // An overlapping match repeats the last offset bytes; copying
+            // from the same start doubles the run each step
+            const unsigned char *match = out - offset;
+            while (length) {
+                size_t count = std::min(length, (size_t)(out - match));
+                std::memcpy(out, match, count);
+                out += count;
+                length -= count;
+            }
+        }
+        return out == outEnd;
+    }
+
+private:
+    static const int HASH_BITS = 16;
+    static const size_t MIN_MATCH = 4;
+    static const size_t MAX_OFFSET = 65535;
+    static const size_t LAST_LITERALS = 5;
+    static const size_t MATCH_START_LIMIT = 12;
+
+    MappedFile m_File;
+    const Entry *m_Entries;
+    size_t m_Count;
+    const char *m_Names;
+
+    static uint32_t read32(const unsigned char *p) {
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+
+    static void writeLength(std::vector<char> &out, size_t length) {
+        if (length < 15)
+            return;
+        for (length -= 15; length >= 255; length -= 255)
+            out.push_back((char)255);
+        out.push_back((char)length);
+    }
+
+    static bool readLength(const unsigned char *&in, const unsigned char *inEnd, size_t &length) {
+        if (length != 15)
+            return true;
+        unsigned char byte;
+        do {
+            if (in >= inEnd)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // One token: literals, then a match unless matchLength is 0
+    static void writeSequence(std::vector<char> &out, const unsigned char *literals, size_t literalCount,
+                              size_t offset, size_t matchLength) {
+        size_t match = matchLength ? matchLength - MIN_MATCH : 0;
+        out.push_back((char)((std::min(literalCount, (size_t)15) << 4) | std::min(match, (size_t)15)));
+        writeLength(out, literalCount);
+        out.insert(out.end(), literals, literals + literalCount);
+        if (!matchLength)
+            return;
+        out.push_back((char)(offset & 0xFF));
+        out.push_back((char)(offset >> 8));
+        writeLength(out, match);
+    }
+
+    bool fail(const std::string &path) {
+        std::cout << "ERROR::ASSET_PACK::INVALID_FILE " << path << std::endl;
+        close();
+        return false;
+    }
+};
+
+// The viewer's pack, opened by --pack. While closed every load goes to
+// the loose files.
+inline AssetPack &assetPack() {
+    static AssetPack pack;
+    return pack;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef ASSET_STREAMER_H
+#define ASSET_STREAMER_H
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "profiler.h"
+#include "thread_pool.h"
+
+// Background asset loading so the first frame doesn't wait for the whole
+// scene. A request is split in two: the load half runs on a loader
+// thread (file reads, parsing, decoding) and returns the GL half, which
+// update() runs on the render thread under a per-frame time budget.
+// Callers render placeholders (1x1 textures, proxy meshes) until the GL
+// half swaps the real asset in.
+//
+// Loads get their own threads rather than the shared pool: pool waits
+// on the render thread help with queued tasks and would pick up a
+// second-long model parse in the middle of a frame.
+class AssetStreamer {
+public:
+    typedef std::function<void()> Finish;
+    typedef std::function<Finish()> Load;
+
+    explicit AssetStreamer(unsigned int loaderThreads = 2)
+        : m_Loaders(loaderThreads), m_Requested(0), m_Finished(0) {}
+
+    // Loads still running may reference what the GL halves would touch
+    ~AssetStreamer() {
+        for (std::future<void> &job : m_Jobs)
+            job.wait();
+    }
+
+    void request(const Load &load) {
+        ++m_Requested;
+        m_Jobs.push_back(m_Loaders.enqueue([this, load] {
+            Finish finish = load();
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Ready.push_back(finish);
+        }));
+    }
+
+    // GL halves of finished loads, in completion order, until budgetMs is
+    // spent. At least one runs per call so a big upload can't hold the
+    // rest back forever. Returns how many ran.
+    int update(float budgetMs) {
+        PROFILE_SCOPE("asset streaming");
+        // Requests go on for the whole session (texture mips), drop the
+        // futures of loads that are done
+        m_Jobs.erase(std::remove_if(m_Jobs.begin(), m_Jobs.end(),
+                                    [](const std::future<void> &job) {
+                                        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                    }),
+                     m_Jobs.end());
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int count = 0;
+        while (true) {
+            Finish finish;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Ready.empty())
+                    break;
+                finish = m_Ready.front();
+                m_Ready.pop_front();
+            }
+            finish();
+            ++count;
+            ++m_Finished;
+            if (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() >=
+                budgetMs)
+                break;
+        }
+        return count;
+    }
+
+    // Blocks until everything requested so far is in
+    void finishAll() {
+        for (std::future<void> &job : m_Jobs)
+            job.wait();
+        m_Jobs.clear();
+        update(std::numeric_limits<float>::infinity());
+    }
+
+    // For loads that split their own work, so it stays off the shared pool
+    ThreadPool *getLoaderPool() { return &m_Loaders; }
+
+    bool idle() const { return m_Finished == m_Requested; }
+    int pending() const { return m_Requested - m_Finished; }
+
+private:
+    ThreadPool m_Loaders;
+    std::vector<std::future<void>> m_Jobs;
+    std::mutex m_Mutex;
+    std::deque<Finish> m_Ready;
+    int m_Requested;
+    int m_Finished;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Frame timings for the flythrough benchmark. Frames [0, warmup) are
+// run but not recorded, the next measuredFrames are. GPU times come in
+// late (GpuTimer), so the benchmark is done once every measured frame
+// has its GPU result or a few extra frames have passed without one.
+class Benchmark {
+public:
+    struct Settings {
+        int warmupFrames;
+        int measuredFrames;
+        std::string csvPath;
+        std::string jsonPath;
+    };
+
+    struct Frame {
+        float cpuMs;
+        float gpuMs; // < 0 until the query result arrives
+        size_t drawCalls;
+        size_t triangles;
+    };
+
+    struct Summary {
+        float mean, median, p95, p99, min, max;
+        int count;
+    };
+
+    // Frames allowed after the last measured one for GPU results
+    static const int DRAIN_FRAMES = 8;
+
+    explicit Benchmark(const Settings &settings)
+        : m_Settings(settings), m_Frames(std::max(settings.measuredFrames, 0), Frame{0.0f, -1.0f, 0, 0}),
+          m_FrameIndex(-1) {}
+
+    const Settings &getSettings() const { return m_Settings; }
+
+    bool isDone() const {
+        int pastEnd = m_FrameIndex + 1 - (m_Settings.warmupFrames + m_Settings.measuredFrames);
+        if (pastEnd < 0)
+            return false;
+        if (pastEnd >= DRAIN_FRAMES)
+            return true;
+        for (const Frame &frame : m_Frames)
+            if (frame.gpuMs < 0.0f)
+                return false;
+        return true;
+    }
+
+    void beginFrame(int frameIndex) {
+        m_FrameIndex = frameIndex;
+        m_CpuStart = std::chrono::steady_clock::now();
+    }
+
+    // CPU side of the frame is over (before swap/vsync)
+    void endFrame(size_t drawCalls, size_t triangles) {
+        float cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_CpuStart).count();
+        Frame *frame = measured(m_FrameIndex);
+        if (!frame)
+            return;
+        frame->cpuMs = cpuMs;
+        frame->drawCalls = drawCalls;
+        frame->triangles = triangles;
+    }
+
+    void addGpuTime(int frameIndex, float gpuMs) {
+        if (Frame *frame = measured(frameIndex))
+            frame->gpuMs = gpuMs;
+    }
+
+    Summary summarizeCpu() const { return summarize(&Frame::cpuMs); }
+    Summary summarizeGpu() const { return summarize(&Frame::gpuMs); }
+
+    // description is free text recorded with the results (renderer, GL
+    // version, toggles) so runs can be compared later
+    void writeResults(const std::string &description) const {
+        Summary cpu = summarizeCpu();
+        Summary gpu = summarizeGpu();
+        double drawCalls = 0.0, triangles = 0.0;
+        for (const Frame &frame : m_Frames) {
+            drawCalls += frame.drawCalls;
+            triangles += frame.triangles;
+        }
+        if (!m_Frames.empty()) {
+            drawCalls /= m_Frames.size();
+            triangles /= m_Frames.size();
+        }
+
+        std::cout << "Benchmark: " << m_Frames.size() << " frames after " << m_Settings.warmupFrames
+                  << " warm-up" << std::endl;
+        print("CPU", cpu);
+        print("GPU", gpu);
+        std::cout << "  " << drawCalls << " draw calls, " << triangles << " triangles per frame" << std::endl;
+
+        if (!m_Settings.csvPath.empty()) {
+            std::ofstream csv(m_Settings.csvPath.c_str());
+            if (!csv) {
+                std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN " << m_Settings.csvPath << std::endl;
+            } else {
+                csv << "frame,cpu_ms,gpu_ms,draw_calls,triangles\n";
+                for (size_t i = 0; i < m_Frames.size(); ++i)
+                    csv << i << "," << m_Frames[i].cpuMs << "," << m_Frames[i].gpuMs << "," << m_Frames[i].drawCalls
+                        << "," << m_Frames[i].triangles << "\n";
+            }
+        }
+
+        if (!m_Settings.jsonPath.empty()) {
+            std::ofstream json(m_Settings.jsonPath.c_str());
+            if (!json) {
+                std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN " << m_Settings.jsonPath << std::endl;
+                return;
+            }
+            json << "{\n  \"description\": \"" << escape(description) << "\",\n"
+                 << "  \"warmup_frames\": " << m_Settings.warmupFrames << ",\n"
+                 << "  \"measured_frames\": " << m_Frames.size() << ",\n"
+                 << "  \"cpu_ms\": " << toJson(cpu) << ",\n"
+                 << "  \"gpu_ms\": " << toJson(gpu) << ",\n"
+                 << "  \"draw_calls\": " << drawCalls << ",\n"
+                 << "  \"triangles\": " << triangles << "\n}\n";
+        }
+    }
+
+private:
+    Settings m_Settings;
+    std::vector<Frame> m_Frames;
+    int m_FrameIndex;
+    std::chrono::steady_clock::time_point m_CpuStart;
+
+    Frame *measured(int frameIndex) {
+        int i = frameIndex - m_Settings.warmupFrames;
+        return i >= 0 && i < (int)m_Frames.size() ? &m_Frames[i] : nullptr;
+    }
+
+    // Nearest-rank percentiles over the frames that have a value
+    Summary summarize(float Frame::*field) const {
+        std::vector<float> values;
+        for (const Frame &frame : m_Frames)
+            if (frame.*field >= 0.0f)
+                values.push_back(frame.*field);
+        Summary summary = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, (int)values.size()};
+        if (values.empty())
+            return summary;
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (float v : values)
+            sum += v;
+        auto percentile = [&](float p) {
+            size_t rank = (size_t)std::ceil(p * values.size());
+            return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+        };
+        summary.mean = (float)(sum / values.size());
+        summary.median = percentile(0.5f);
+        summary.p95 = percentile(0.95f);
+        summary.p99 = percentile(0.99f);
+        summary.min = values.front();
+        summary.max = values.back();
+        return summary;
+    }
+
+    static void print(const char *label, const Summary &s) {
+        std::cout << "  " << label << " ms: mean " << s.mean << ", median " << s.median << ", p95 " << s.p95
+                  << ", p99 " << s.p99 << ", min " << s.min << ", max " << s.max << " (" << s.count << " frames)"
+                  << std::endl;
+    }
+
+    static std::string toJson(const Summary &s) {
+        std::ostringstream out;
+        out << "{\"mean\": " << s.mean << ", \"median\": " << s.median << ", \"p95\": " << s.p95
+            << ", \"p99\": " << s.p99 << ", \"min\": " << s.min << ", \"max\": " << s.max
+            << ", \"frames\": " << s.count << "}";
+        return out.str();
+    }
+
+    static std::string escape(const std::string &text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+};
+
+#endif
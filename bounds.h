@@ -0,0 +1,175 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+    AABB(const glm::vec3 &mn, const glm::vec3 &mx) : min(mn), max(mx) {}
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    void expand(const glm::vec3 &p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void expand(const AABB &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    float surfaceArea() const {
+        if (!valid())
+            return 0.0f;
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool contains(const AABB &other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+               max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    bool overlaps(const AABB &other) const {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    // Conservative world box of a transformed box (Arvo's method)
+    AABB transformed(const glm::mat4 &m) const {
+        glm::vec3 t(m[3]);
+        AABB result(t, t);
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                float a = m[j][i] * min[j];
+                float b = m[j][i] * max[j];
+                result.min[i] += std::min(a, b);
+                result.max[i] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+
+    static AABB merge(const AABB &a, const AABB &b) {
+        return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+};
+
+// The 8 corners of the volume a (view-)projection matrix maps to the NDC cube
+inline void frustumCorners(const glm::mat4 &viewProjection, glm::vec3 corners[8]) {
+    glm::mat4 inv = glm::inverse(viewProjection);
+    int i = 0;
+    for (int x = 0; x < 2; ++x) {
+        for (int y = 0; y < 2; ++y) {
+            for (int z = 0; z < 2; ++z) {
+                glm::vec4 p = inv * glm::vec4(2.0f * x - 1.0f, 2.0f * y - 1.0f, 2.0f * z - 1.0f, 1.0f);
+                corners[i++] = glm::vec3(p) / p.w;
+            }
+        }
+    }
+}
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f) {}
+    Ray(const glm::vec3 &o, const glm::vec3 &d) : origin(o), direction(d) {}
+};
+
+// Slab test. invDir is 1/direction, precomputed by the caller for traversal.
+inline bool intersectRayAABB(const glm::vec3 &origin, const glm::vec3 &invDir, const AABB &box,
+                             float maxT, float &tHit) {
+    float tmin = 0.0f;
+    float tmax = maxT;
+    for (int i = 0; i < 3; ++i) {
+        float t0 = (box.min[i] - origin[i]) * invDir[i];
+        float t1 = (box.max[i] - origin[i]) * invDir[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax)
+            return false;
+    }
+    tHit = tmin;
+    return true;
+}
+
+inline bool intersectSphereAABB(const glm::vec3 &center, float radius, const AABB &box) {
+    glm::vec3 closest = glm::clamp(center, box.min, box.max);
+    glm::vec3 d = closest - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+enum FrustumResult {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+// Six planes (left, right, bottom, top, near, far) pointing inwards,
+// extracted from a view-projection matrix (Gribb/Hartmann).
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4 &viewProjection) {
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+        for (int i = 0; i < 6; ++i) {
+            float len = glm::length(glm::vec3(planes[i]));
+            planes[i] = planes[i] / len;
+        }
+    }
+
+    // planeMask has a bit set for every plane the box still has to be
+    // tested against; planes the parent was fully inside get cleared so
+    // tree traversals can skip them.
+    FrustumResult classify(const AABB &box, unsigned int &planeMask) const {
+        glm::vec3 c = box.center();
+        glm::vec3 e = box.extents();
+        FrustumResult result = FRUSTUM_INSIDE;
+        for (int i = 0; i < 6; ++i) {
+            unsigned int bit = 1u << i;
+            if (!(planeMask & bit))
+                continue;
+            glm::vec3 n(planes[i]);
+            float r = e.x * std::abs(n.x) + e.y * std::abs(n.y) + e.z * std::abs(n.z);
+            float d = glm::dot(n, c) + planes[i].w;
+            if (d < -r)
+                return FRUSTUM_OUTSIDE;
+            if (d < r)
+                result = FRUSTUM_INTERSECTS;
+            else
+                planeMask &= ~bit;
+        }
+        return result;
+    }
+
+    bool intersects(const AABB &box) const {
+        unsigned int mask = 0x3f;
+        return classify(box, mask) != FRUSTUM_OUTSIDE;
+    }
+};
+
+#endif
@@ -0,0 +1,568 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <functional>
+#include <vector>
+
+#include "bounds.h"
+#include "thread_pool.h"
+
+struct BVHNode {
+    AABB bounds;
+    int parent;
+    int child1;
+    int child2;
+    int height;
+    int proxy;
+
+    bool isLeaf() const { return child1 == -1; }
+};
+
+// Dynamic bounding volume hierarchy over object world bounds.
+//
+// Proxies are stable handles (the caller usually uses the object index).
+// Leaves store "fat" boxes grown by a margin so small movements don't touch
+// the tree at all. Bulk rebuilds use a binned SAH split and can fan out
+// over a ThreadPool; single moves refit the ancestors and apply local tree
+// rotations so the tree quality doesn't drift with incremental updates.
+class BVH {
+public:
+    typedef std::function<bool(int proxy, float &t)> RayCallback;
+
+    explicit BVH(float margin = 0.1f) : m_Root(-1), m_FreeList(-1), m_Margin(margin), m_BuildCost(0.0f) {}
+
+    int getRoot() const { return m_Root; }
+    int getHeight() const { return m_Root == -1 ? 0 : m_Nodes[m_Root].height; }
+    int getProxyCount() const { return (int)m_ProxyNodes.size(); }
+    const AABB &getFatAABB(int proxy) const { return m_Nodes[m_ProxyNodes[proxy]].bounds; }
+
+    void clear() {
+        m_Nodes.clear();
+        m_ProxyNodes.clear();
+        m_Root = -1;
+        m_FreeList = -1;
+        m_BuildCost = 0.0f;
+    }
+
+    // Bulk build from scratch; proxy i refers to boxes[i].
+    void build(const std::vector<AABB> &boxes, ThreadPool *pool = nullptr) {
+        m_ProxyNodes.assign(boxes.size(), -1);
+        std::vector<BuildItem> items(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i)
+            items[i] = makeBuildItem(fatten(boxes[i]), (int)i);
+        buildFromItems(items, pool);
+    }
+
+    // Rebuilds the tree from the proxies' current fat boxes, keeping handles.
+    void rebuild(ThreadPool *pool = nullptr) {
+        std::vector<BuildItem> items;
+        items.reserve(m_ProxyNodes.size());
+        for (size_t i = 0; i < m_ProxyNodes.size(); ++i) {
+            if (m_ProxyNodes[i] != -1)
+                items.push_back(makeBuildItem(m_Nodes[m_ProxyNodes[i]].bounds, (int)i));
+        }
+        buildFromItems(items, pool);
+    }
+
+    int createProxy(const AABB &box) {
+        int proxy = (int)m_ProxyNodes.size();
+        int leaf = allocateNode();
+        m_Nodes[leaf].bounds = fatten(box);
+        m_Nodes[leaf].proxy = proxy;
+        m_Nodes[leaf].height = 0;
+        m_ProxyNodes.push_back(leaf);
+        insertLeaf(leaf);
+        return proxy;
+    }
+
+    void destroyProxy(int proxy) {
+        int leaf = m_ProxyNodes[proxy];
+        if (leaf == -1)
+            return;
+        removeLeaf(leaf);
+        freeNode(leaf);
+        m_ProxyNodes[proxy] = -1;
+    }
+
+    // Returns true if the tree had to change. Boxes that stay inside their
+    // fat bounds are free; boxes that jumped away from their old bounds are
+    // reinserted, everything else is refit + rotated in place.
+    bool moveProxy(int proxy, const AABB &box) {
+        int leaf = m_ProxyNodes[proxy];
+        if (m_Nodes[leaf].bounds.contains(box))
+            return false;
+
+        AABB fat = fatten(box);
+        if (!m_Nodes[leaf].bounds.overlaps(box)) {
+            removeLeaf(leaf);
+            m_Nodes[leaf].bounds = fat;
+            insertLeaf(leaf);
+            return true;
+        }
+
+        m_Nodes[leaf].bounds = fat;
+        refitUpwards(m_Nodes[leaf].parent);
+        return true;
+    }
+
+    // SAH cost relative to the root; compared against the cost right after
+    // the last bulk build to decide when incremental updates have degraded
+    // the tree enough to rebuild.
+    float computeCost() const {
+        if (m_Root == -1)
+            return 0.0f;
+        float rootArea = std::max(m_Nodes[m_Root].bounds.surfaceArea(), 1e-6f);
+        float total = 0.0f;
+        for (size_t i = 0; i < m_Nodes.size(); ++i) {
+            if (m_Nodes[i].height > 0)
+                total += m_Nodes[i].bounds.surfaceArea();
+        }
+        return total / rootArea;
+    }
+
+    bool isDegraded(float threshold = 1.4f) const {
+        return m_BuildCost > 0.0f && computeCost() > m_BuildCost * threshold;
+    }
+
+    void queryFrustum(const Frustum &frustum, std::vector<int> &out) const {
+        if (m_Root == -1)
+            return;
+        struct Entry { int node; unsigned int mask; };
+        std::vector<Entry> stack;
+        stack.reserve(64);
+        stack.push_back({m_Root, 0x3fu});
+        while (!stack.empty()) {
+            Entry e = stack.back();
+            stack.pop_back();
+            const BVHNode &node = m_Nodes[e.node];
+            FrustumResult r = frustum.classify(node.bounds, e.mask);
+            if (r == FRUSTUM_OUTSIDE)
+                continue;
+            if (r == FRUSTUM_INSIDE) {
+                collectLeaves(e.node, out);
+                continue;
+            }
+            if (node.isLeaf()) {
+                out.push_back(node.proxy);
+            } else {
+                stack.push_back({node.child1, e.mask});
+                stack.push_back({node.child2, e.mask});
+            }
+        }
+    }
+
+    void queryAABB(const AABB &box, std::vector<int> &out) const {
+        query(out, [&](const AABB &b) { return b.overlaps(box); });
+    }
+
+    // Objects a point light of the given radius can reach
+    void querySphere(const glm::vec3 &center, float radius, std::vector<int> &out) const {
+        query(out, [&](const AABB &b) { return intersectSphereAABB(center, radius, b); });
+    }
+
+    // Closest hit along the ray. Without a callback the hit is against the
+    // fat leaf box; the callback can refine (or reject) a leaf hit.
+    int raycast(const Ray &ray, float maxT, float &tHit, const RayCallback &refine = RayCallback()) const {
+        int hitProxy = -1;
+        if (m_Root == -1)
+            return hitProxy;
+        glm::vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+        float best = maxT;
+        std::vector<int> stack;
+        stack.reserve(64);
+        stack.push_back(m_Root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            const BVHNode &node = m_Nodes[index];
+            float t;
+            if (!intersectRayAABB(ray.origin, invDir, node.bounds, best, t))
+                continue;
+            if (node.isLeaf()) {
+                if (refine && !refine(node.proxy, t))
+                    continue;
+                if (t < best) {
+                    best = t;
+                    hitProxy = node.proxy;
+                }
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+        tHit = best;
+        return hitProxy;
+    }
+
+private:
+    struct BuildItem {
+        AABB bounds;
+        glm::vec3 centroid;
+        int proxy;
+    };
+
+    static const int BIN_COUNT = 12;
+    static const size_t PARALLEL_THRESHOLD = 1024;
+
+    std::vector<BVHNode> m_Nodes;
+    std::vector<int> m_ProxyNodes;
+    int m_Root;
+    int m_FreeList;
+    float m_Margin;
+    float m_BuildCost;
+    std::atomic<int> m_BuildNodeCount;
+
+    AABB fatten(const AABB &box) const {
+        glm::vec3 m(m_Margin);
+        return AABB(box.min - m, box.max + m);
+    }
+
+    static BuildItem makeBuildItem(const AABB &box, int proxy) {
+        BuildItem item;
+        item.bounds = box;
+        item.centroid = box.center();
+        item.proxy = proxy;
+        return item;
+    }
+
+    int allocateNode() {
+        int index;
+        if (m_FreeList != -1) {
+            index = m_FreeList;
+            m_FreeList = m_Nodes[index].parent;
+        } else {
+            index = (int)m_Nodes.size();
+            m_Nodes.push_back(BVHNode());
+        }
+        BVHNode &node = m_Nodes[index];
+        node.parent = -1;
+        node.child1 = -1;
+        node.child2 = -1;
+        node.height = 0;
+        node.proxy = -1;
+        return index;
+    }
+
+    void freeNode(int index) {
+        m_Nodes[index].parent = m_FreeList;
+        m_Nodes[index].height = -1;
+        m_FreeList = index;
+    }
+
+    template <typename Test>
+    void query(std::vector<int> &out, Test test) const {
+        if (m_Root == -1)
+            return;
+        std::vector<int> stack;
+        stack.reserve(64);
+        stack.push_back(m_Root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            const BVHNode &node = m_Nodes[index];
+            if (!test(node.bounds))
+                continue;
+            if (node.isLeaf()) {
+                out.push_back(node.proxy);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    void collectLeaves(int index, std::vector<int> &out) const {
+        std::vector<int> stack;
+        stack.push_back(index);
+        while (!stack.empty()) {
+            const BVHNode &node = m_Nodes[stack.back()];
+            stack.pop_back();
+            if (node.isLeaf()) {
+                out.push_back(node.proxy);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    //----------------------------------------------------------- bulk build
+
+    void buildFromItems(std::vector<BuildItem> &items, ThreadPool *pool) {
+        m_FreeList = -1;
+        m_Root = -1;
+        m_Nodes.clear();
+        if (items.empty()) {
+            m_BuildCost = 0.0f;
+            return;
+        }
+        m_Nodes.resize(items.size() * 2 - 1);
+        m_BuildNodeCount = 0;
+        m_Root = buildRange(items, 0, items.size(), -1, pool);
+        m_Nodes.resize(m_BuildNodeCount.load());
+        m_BuildCost = computeCost();
+    }
+
+    int buildRange(std::vector<BuildItem> &items, size_t begin, size_t end, int parent, ThreadPool *pool) {
+        int index = m_BuildNodeCount.fetch_add(1);
+        BVHNode &node = m_Nodes[index];
+        node.parent = parent;
+        node.proxy = -1;
+
+        if (end - begin == 1) {
+            node.bounds = items[begin].bounds;
+            node.child1 = -1;
+            node.child2 = -1;
+            node.height = 0;
+            node.proxy = items[begin].proxy;
+            m_ProxyNodes[node.proxy] = index;
+            return index;
+        }
+
+        size_t mid = partitionSAH(items, begin, end);
+
+        int left, right;
+        if (pool && end - begin > PARALLEL_THRESHOLD) {
+            std::future<void> f = pool->enqueue([&, begin, mid, index] {
+                left = buildRange(items, begin, mid, index, pool);
+            });
+            right = buildRange(items, mid, end, index, pool);
+            pool->wait(f);
+        } else {
+            left = buildRange(items, begin, mid, index, nullptr);
+            right = buildRange(items, mid, end, index, nullptr);
+        }
+
+        BVHNode &n = m_Nodes[index];
+        n.child1 = left;
+        n.child2 = right;
+        n.bounds = AABB::merge(m_Nodes[left].bounds, m_Nodes[right].bounds);
+        n.height = 1 + std::max(m_Nodes[left].height, m_Nodes[right].height);
+        return index;
+    }
+
+    // Binned SAH split over the centroid bounds; falls back to a median
+    // split when all centroids coincide or no split beats the leaf cost.
+    size_t partitionSAH(std::vector<BuildItem> &items, size_t begin, size_t end) {
+        AABB centroidBounds;
+        for (size_t i = begin; i < end; ++i)
+            centroidBounds.expand(items[i].centroid);
+
+        int bestAxis = -1;
+        int bestBin = -1;
+        float bestCost = FLT_MAX;
+        glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 1e-6f)
+                continue;
+            AABB binBounds[BIN_COUNT];
+            int binCounts[BIN_COUNT] = {0};
+            float scale = BIN_COUNT / extent[axis];
+            for (size_t i = begin; i < end; ++i) {
+                int b = std::min(BIN_COUNT - 1, (int)((items[i].centroid[axis] - centroidBounds.min[axis]) * scale));
+                binCounts[b]++;
+                binBounds[b].expand(items[i].bounds);
+            }
+
+            float rightArea[BIN_COUNT];
+            int rightCount[BIN_COUNT];
+            AABB acc;
+            int count = 0;
+            for (int b = BIN_COUNT - 1; b > 0; --b) {
+                acc.expand(binBounds[b]);
+                count += binCounts[b];
+                rightArea[b] = acc.surfaceArea();
+                rightCount[b] = count;
+            }
+
+            acc = AABB();
+            count = 0;
+            for (int b = 0; b < BIN_COUNT - 1; ++b) {
+                acc.expand(binBounds[b]);
+                count += binCounts[b];
+                if (count == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = acc.surfaceArea() * count + rightArea[b + 1] * rightCount[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        size_t mid;
+        if (bestAxis == -1) {
+            mid = begin + (end - begin) / 2;
+            int axis = 0;
+            if (extent.y > extent[axis]) axis = 1;
+            if (extent.z > extent[axis]) axis = 2;
+            std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                             [axis](const BuildItem &a, const BuildItem &b) { return a.centroid[axis] < b.centroid[axis]; });
+            return mid;
+        }
+
+        float scale = BIN_COUNT / extent[bestAxis];
+        float minC = centroidBounds.min[bestAxis];
+        auto it = std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem &item) {
+            int b = std::min(BIN_COUNT - 1, (int)((item.centroid[bestAxis] - minC) * scale));
+            return b <= bestBin;
+        });
+        mid = (size_t)(it - items.begin());
+        if (mid == begin || mid == end)
+            mid = begin + (end - begin) / 2;
+        return mid;
+    }
+
+    //----------------------------------------------------- incremental update
+
+    void insertLeaf(int leaf) {
+        if (m_Root == -1) {
+            m_Root = leaf;
+            m_Nodes[leaf].parent = -1;
+            return;
+        }
+
+        // Walk down picking the child with the lowest SAH insertion cost
+        AABB leafBox = m_Nodes[leaf].bounds;
+        int index = m_Root;
+        while (!m_Nodes[index].isLeaf()) {
+            const BVHNode &node = m_Nodes[index];
+            float area = node.bounds.surfaceArea();
+            float combinedArea = AABB::merge(node.bounds, leafBox).surfaceArea();
+            float cost = 2.0f * combinedArea;
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float cost1 = childInsertCost(node.child1, leafBox) + inheritanceCost;
+            float cost2 = childInsertCost(node.child2, leafBox) + inheritanceCost;
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        int sibling = index;
+        int oldParent = m_Nodes[sibling].parent;
+        int newParent = allocateNode();
+        m_Nodes[newParent].parent = oldParent;
+        m_Nodes[newParent].bounds = AABB::merge(leafBox, m_Nodes[sibling].bounds);
+        m_Nodes[newParent].height = m_Nodes[sibling].height + 1;
+        m_Nodes[newParent].child1 = sibling;
+        m_Nodes[newParent].child2 = leaf;
+        m_Nodes[sibling].parent = newParent;
+        m_Nodes[leaf].parent = newParent;
+
+        if (oldParent != -1) {
+            if (m_Nodes[oldParent].child1 == sibling)
+                m_Nodes[oldParent].child1 = newParent;
+            else
+                m_Nodes[oldParent].child2 = newParent;
+        } else {
+            m_Root = newParent;
+        }
+
+        refitUpwards(m_Nodes[leaf].parent);
+    }
+
+    float childInsertCost(int child, const AABB &leafBox) const {
+        const BVHNode &c = m_Nodes[child];
+        float merged = AABB::merge(c.bounds, leafBox).surfaceArea();
+        return c.isLeaf() ? merged : merged - c.bounds.surfaceArea();
+    }
+
+    void removeLeaf(int leaf) {
+        if (leaf == m_Root) {
+            m_Root = -1;
+            return;
+        }
+        int parent = m_Nodes[leaf].parent;
+        int grandParent = m_Nodes[parent].parent;
+        int sibling = m_Nodes[parent].child1 == leaf ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+        if (grandParent != -1) {
+            if (m_Nodes[grandParent].child1 == parent)
+                m_Nodes[grandParent].child1 = sibling;
+            else
+                m_Nodes[grandParent].child2 = sibling;
+            m_Nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            refitUpwards(grandParent);
+        } else {
+            m_Root = sibling;
+            m_Nodes[sibling].parent = -1;
+            freeNode(parent);
+        }
+        m_Nodes[leaf].parent = -1;
+    }
+
+    void refitUpwards(int index) {
+        while (index != -1) {
+            BVHNode &node = m_Nodes[index];
+            node.bounds = AABB::merge(m_Nodes[node.child1].bounds, m_Nodes[node.child2].bounds);
+            node.height = 1 + std::max(m_Nodes[node.child1].height, m_Nodes[node.child2].height);
+            rotate(index);
+            index = m_Nodes[index].parent;
+        }
+    }
+
+    // Tree rotation (Kopta et al.): try swapping a child of this node with
+    // a grandchild under its other child and keep the swap that shrinks the
+    // surface area of the affected inner node the most.
+    void rotate(int index) {
+        BVHNode &node = m_Nodes[index];
+        int b = node.child1;
+        int c = node.child2;
+
+        float bestGain = 0.0f;
+        int swapA = -1, swapB = -1;
+        tryRotation(b, c, bestGain, swapA, swapB);
+        tryRotation(c, b, bestGain, swapA, swapB);
+        if (swapA == -1)
+            return;
+
+        // swapA is a direct child of index, swapB a grandchild on the other side
+        int inner = m_Nodes[swapB].parent;
+        if (m_Nodes[index].child1 == swapA)
+            m_Nodes[index].child1 = swapB;
+        else
+            m_Nodes[index].child2 = swapB;
+        if (m_Nodes[inner].child1 == swapB)
+            m_Nodes[inner].child1 = swapA;
+        else
+            m_Nodes[inner].child2 = swapA;
+        m_Nodes[swapB].parent = index;
+        m_Nodes[swapA].parent = inner;
+
+        BVHNode &in = m_Nodes[inner];
+        in.bounds = AABB::merge(m_Nodes[in.child1].bounds, m_Nodes[in.child2].bounds);
+        in.height = 1 + std::max(m_Nodes[in.child1].height, m_Nodes[in.child2].height);
+        BVHNode &n = m_Nodes[index];
+        n.height = 1 + std::max(m_Nodes[n.child1].height, m_Nodes[n.child2].height);
+    }
+
+    void tryRotation(int child, int other, float &bestGain, int &swapA, int &swapB) const {
+        const BVHNode &o = m_Nodes[other];
+        if (o.isLeaf())
+            return;
+        float area = o.bounds.surfaceArea();
+        // child <-> o.child1 leaves o = child + o.child2, and vice versa
+        float gain1 = area - AABB::merge(m_Nodes[child].bounds, m_Nodes[o.child2].bounds).surfaceArea();
+        float gain2 = area - AABB::merge(m_Nodes[child].bounds, m_Nodes[o.child1].bounds).surfaceArea();
+        if (gain1 > bestGain) {
+            bestGain = gain1;
+            swapA = child;
+            swapB = o.child1;
+        }
+        if (gain2 > bestGain) {
+            bestGain = gain2;
+            swapA = child;
+            swapB = o.child2;
+        }
+    }
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "bounds.h"
+
 enum Camera_Movement {
     FORWARD,
     BACKWARD,
@@ -47,6 +49,16 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // World space ray through a window pixel (origin top-left), for picking
+    Ray GetPickRay(float x, float y, float width, float height) const {
+        float ndcX = 2.0f * x / width - 1.0f;
+        float ndcY = 1.0f - 2.0f * y / height;
+        float tanHalfFov = tan(glm::radians(Zoom) * 0.5f);
+        float aspect = width / height;
+        glm::vec3 dir = Front + Right * (ndcX * tanHalfFov * aspect) + Up * (ndcY * tanHalfFov);
+        return Ray(Position, glm::normalize(dir));
+    }
+
     void ProcessKeyboard(Camera_Movement direction, float deltaTime) {
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
@@ -76,6 +88,15 @@ public:
         updateCameraVectors();
     }
 
+    // Places the camera at position facing target (scripted paths)
+    void LookAt(const glm::vec3 &position, const glm::vec3 &target) {
+        Position = position;
+        glm::vec3 dir = glm::normalize(target - position);
+        Yaw = glm::degrees(atan2(dir.z, dir.x));
+        Pitch = glm::degrees(asin(glm::clamp(dir.y, -1.0f, 1.0f)));
+        updateCameraVectors();
+    }
+
     void ProcessMouseScroll(float yoffset) {
         Zoom -= (float)yoffset;
         if (Zoom < 1.0f)
@@ -0,0 +1,106 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scripted camera: keyframes of (time, position, look-at target), both
+// interpolated with a Catmull-Rom spline so the motion has no kinks at
+// the keys. Sampling only depends on the time passed in.
+class CameraPath {
+public:
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+
+    void add(float time, const glm::vec3 &position, const glm::vec3 &target) {
+        m_Keys.push_back(Keyframe{time, position, target});
+        std::sort(m_Keys.begin(), m_Keys.end(),
+                  [](const Keyframe &a, const Keyframe &b) { return a.time < b.time; });
+    }
+
+    // One keyframe per line: "time px py pz tx ty tz", # starts a comment
+    bool load(const std::string &path) {
+        std::ifstream in(path.c_str());
+        if (!in) {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READ " << path << std::endl;
+            return false;
+        }
+        m_Keys.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            float t;
+            glm::vec3 p, target;
+            if (fields >> t >> p.x >> p.y >> p.z >> target.x >> target.y >> target.z)
+                add(t, p, target);
+        }
+        if (m_Keys.size() < 2) {
+            std::cout << "ERROR::CAMERA_PATH::NEEDS_TWO_KEYFRAMES " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Loop around the demo scene: the table, along the building and back
+    static CameraPath demo() {
+        CameraPath path;
+        path.add(0.0f, glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(1.0f, 1.5f, 0.0f));
+        path.add(3.0f, glm::vec3(4.0f, 1.5f, 4.0f), glm::vec3(1.0f, 1.5f, 0.0f));
+        path.add(6.0f, glm::vec3(6.0f, 3.0f, -6.0f), glm::vec3(12.0f, 2.0f, 0.0f));
+        path.add(9.0f, glm::vec3(18.0f, 5.0f, -8.0f), glm::vec3(12.0f, 2.0f, 0.0f));
+        path.add(12.0f, glm::vec3(20.0f, 4.0f, 8.0f), glm::vec3(6.0f, 1.0f, 0.0f));
+        path.add(15.0f, glm::vec3(-6.0f, 6.0f, 12.0f), glm::vec3(4.0f, 0.0f, 0.0f));
+        path.add(18.0f, glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(1.0f, 1.5f, 0.0f));
+        return path;
+    }
+
+    float getDuration() const { return m_Keys.empty() ? 0.0f : m_Keys.back().time; }
+    bool empty() const { return m_Keys.empty(); }
+
+    // Clamped to the first/last keyframe outside the path
+    void sample(float time, glm::vec3 &position, glm::vec3 &target) const {
+        if (m_Keys.size() == 1 || time <= m_Keys.front().time) {
+            position = m_Keys.front().position;
+            target = m_Keys.front().target;
+            return;
+        }
+        if (time >= m_Keys.back().time) {
+            position = m_Keys.back().position;
+            target = m_Keys.back().target;
+            return;
+        }
+        size_t i = 1;
+        while (m_Keys[i].time < time)
+            ++i;
+        const Keyframe &k1 = m_Keys[i - 1];
+        const Keyframe &k2 = m_Keys[i];
+        // End keys are repeated as their own neighbours
+        const Keyframe &k0 = m_Keys[i >= 2 ? i - 2 : i - 1];
+        const Keyframe &k3 = m_Keys[std::min(i + 1, m_Keys.size() - 1)];
+        float t = (time - k1.time) / std::max(k2.time - k1.time, 1e-6f);
+        position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+        target = catmullRom(k0.target, k1.target, k2.target, k3.target, t);
+    }
+
+private:
+    std::vector<Keyframe> m_Keys;
+
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3,
+                                float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+};
+
+#endif
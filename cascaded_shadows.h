@@ -0,0 +1,270 @@
+#ifndef CASCADED_SHADOWS_H
+#define CASCADED_SHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "bounds.h"
+#include "shader.h"
+#include "shadow_culling.h"
+
+const int MAX_CASCADES = 4;
+
+// Sun shadow split into cascades along the camera frustum, all stored as
+// layers of one depth texture array.
+//
+// Splits use the practical split scheme (blend of log and uniform). Each
+// cascade is fitted to the bounding sphere of its frustum slice so its
+// size doesn't change with camera rotation, and the light-space origin is
+// snapped to whole texels so the map doesn't shimmer when the camera moves.
+//
+// With caching on, static casters go into a separate static array that is
+// only re-rendered when its cascade matrix changes or a static object
+// inside it moves. Each frame the static layer is copied into the final
+// layer and dynamic casters are drawn on top; when a cascade has no
+// dynamic casters and nothing changed, it costs nothing. To keep cascade
+// matrices stable while the camera moves, cached cascades snap their
+// centre to a coarse grid (cacheSnap * radius) and grow by one grid step.
+class CascadedShadowMap {
+public:
+    unsigned int depthArray;
+    unsigned int FBO;
+    unsigned int staticDepthArray;
+    unsigned int staticFBO;
+
+    CascadedShadowMap(unsigned int resolution = 2048, int cascadeCount = MAX_CASCADES,
+                      float shadowDistance = 60.0f, float splitLambda = 0.75f,
+                      bool caching = true, float cacheSnap = 0.125f)
+        : m_Resolution(resolution), m_CascadeCount(std::min(cascadeCount, MAX_CASCADES)),
+          m_ShadowDistance(shadowDistance), m_SplitLambda(splitLambda),
+          m_Caching(caching), m_CacheSnap(cacheSnap), m_StaticRenders(0) {
+        depthArray = createDepthArray();
+        FBO = createFBO(depthArray);
+        staticDepthArray = createDepthArray();
+        staticFBO = createFBO(staticDepthArray);
+        invalidateAll();
+    }
+
+    int getCascadeCount() const { return m_CascadeCount; }
+    unsigned int getResolution() const { return m_Resolution; }
+    const glm::mat4 &getLightSpaceMatrix(int cascade) const { return m_LightSpace[cascade]; }
+    const ShadowCasterCuller &getCasterCuller(int cascade) const { return m_Cullers[cascade]; }
+    const ShadowCasterCuller &getStaticCasterCuller(int cascade) const { return m_StaticCullers[cascade]; }
+    bool isCaching() const { return m_Caching; }
+    // Number of static layer re-renders so far, to see how often the cache misses
+    unsigned int getStaticRenderCount() const { return m_StaticRenders; }
+
+    void setCaching(bool caching) {
+        m_Caching = caching;
+        invalidateAll();
+    }
+
+    void invalidateAll() {
+        for (int i = 0; i < MAX_CASCADES; ++i) {
+            m_StaticValid[i] = false;
+            m_FinalCurrent[i] = false;
+            m_FinalHasDynamic[i] = false;
+        }
+    }
+
+    // A static object changed inside this box (call with both its old and
+    // new bounds); drops the static layer of every cascade it touches.
+    void invalidate(const AABB &worldBounds) {
+        for (int i = 0; i < m_CascadeCount; ++i) {
+            if (m_StaticCullers[i].getLightFrustum().intersects(worldBounds))
+                m_StaticValid[i] = false;
+        }
+    }
+
+    bool needsStaticUpdate(int cascade) const { return m_Caching && !m_StaticValid[cascade]; }
+
+    // Binds and clears the static layer; draw the static casters after this
+    void beginStaticUpdate(int cascade) {
+        bindLayer(staticFBO, staticDepthArray, cascade);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_StaticValid[cascade] = true;
+        m_StaticLightSpace[cascade] = m_LightSpace[cascade];
+        m_FinalCurrent[cascade] = false;
+        m_StaticRenders++;
+    }
+
+    // Prepares the final layer for dynamic casters. Returns false when the
+    // final layer is already up to date and there is nothing to draw.
+    // Without caching this just clears the layer for all casters.
+    bool beginDynamicUpdate(int cascade, bool hasDynamicCasters) {
+        if (!m_Caching) {
+            bindLayer(FBO, depthArray, cascade);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            return true;
+        }
+        if (m_FinalCurrent[cascade] && !hasDynamicCasters && !m_FinalHasDynamic[cascade])
+            return false;
+
+        // Composite: copy the cached static depth, dynamic casters go on top
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBO);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthArray, 0, cascade);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, cascade);
+        glBlitFramebuffer(0, 0, m_Resolution, m_Resolution, 0, 0, m_Resolution, m_Resolution,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        bindLayer(FBO, depthArray, cascade);
+        m_FinalCurrent[cascade] = true;
+        m_FinalHasDynamic[cascade] = hasDynamicCasters;
+        return hasDynamicCasters;
+    }
+
+    // Refits every cascade to the current camera. sceneBounds extends the
+    // light depth range so casters outside a cascade's slice still land in
+    // its map.
+    void update(const glm::mat4 &view, float fovY, float aspect, float zNear, float zFar,
+                const glm::vec3 &lightDir, const AABB &sceneBounds) {
+        float farPlane = std::min(zFar, m_ShadowDistance);
+        glm::vec3 dir = glm::normalize(lightDir);
+        glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+        float prevSplit = zNear;
+        for (int i = 0; i < m_CascadeCount; ++i) {
+            float p = (i + 1) / (float)m_CascadeCount;
+            float logSplit = zNear * std::pow(farPlane / zNear, p);
+            float uniformSplit = zNear + (farPlane - zNear) * p;
+            float split = m_SplitLambda * logSplit + (1.0f - m_SplitLambda) * uniformSplit;
+            m_Splits[i] = split;
+
+            glm::mat4 sliceViewProjection = glm::perspective(fovY, aspect, prevSplit, split) * view;
+            glm::vec3 corners[8];
+            frustumCorners(sliceViewProjection, corners);
+
+            glm::vec3 center(0.0f);
+            for (int c = 0; c < 8; ++c)
+                center += corners[c];
+            center /= 8.0f;
+            float radius = 0.0f;
+            for (int c = 0; c < 8; ++c)
+                radius = std::max(radius, glm::length(corners[c] - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            if (m_Caching) {
+                // Coarse snap in light orientation space so the matrix only
+                // changes after the camera moved a fraction of the cascade
+                float step = radius * m_CacheSnap;
+                glm::mat3 lightRotation(glm::lookAt(glm::vec3(0.0f), dir, up));
+                glm::vec3 snapped = glm::floor(lightRotation * center / step + 0.5f) * step;
+                center = glm::transpose(lightRotation) * snapped;
+                radius += step;
+            }
+
+            glm::mat4 lightView = glm::lookAt(center - dir * radius, center, up);
+
+            // Depth range covers the slice sphere plus any scene geometry
+            // between it and the light, quantized so moving objects don't
+            // change the matrix every frame
+            float nearZ = 0.0f;
+            float farZ = 2.0f * radius;
+            if (sceneBounds.valid()) {
+                AABB lightSpaceScene = sceneBounds.transformed(lightView);
+                nearZ = std::min(nearZ, -lightSpaceScene.max.z);
+                nearZ = std::floor(nearZ / radius) * radius;
+            }
+            glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, nearZ, farZ);
+
+            // Snap the light-space origin to the texel grid
+            glm::mat4 shadowMatrix = lightProjection * lightView;
+            glm::vec4 origin = shadowMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float halfRes = m_Resolution * 0.5f;
+            glm::vec2 texelOrigin(origin.x * halfRes, origin.y * halfRes);
+            glm::vec2 offset = (glm::round(texelOrigin) - texelOrigin) / halfRes;
+            lightProjection[3][0] += offset.x;
+            lightProjection[3][1] += offset.y;
+
+            m_LightSpace[i] = lightProjection * lightView;
+            m_Cullers[i].setup(lightView, lightProjection, sliceViewProjection);
+            // The cached layer has to hold everything in the cascade volume,
+            // not just what the current slice needs
+            m_StaticCullers[i].setup(lightView, lightProjection, m_LightSpace[i]);
+            if (m_StaticValid[i] && !sameMatrix(m_LightSpace[i], m_StaticLightSpace[i]))
+                m_StaticValid[i] = false;
+
+            // Constant world-space bias expressed in this cascade's depth units
+            float texelWorldSize = 2.0f * radius / m_Resolution;
+            m_Bias[i] = 1.5f * texelWorldSize / (farZ - nearZ);
+            prevSplit = split;
+        }
+    }
+
+    void setUniforms(Shader &shader) const {
+        shader.setInt("cascadeCount", m_CascadeCount);
+        for (int i = 0; i < m_CascadeCount; ++i) {
+            std::string index = "[" + std::to_string(i) + "]";
+            shader.setMat4("lightSpaceMatrices" + index, m_LightSpace[i]);
+            shader.setFloat("cascadePlaneDistances" + index, m_Splits[i]);
+            shader.setFloat("cascadeBias" + index, m_Bias[i]);
+        }
+    }
+
+private:
+    unsigned int m_Resolution;
+    int m_CascadeCount;
+    float m_ShadowDistance;
+    float m_SplitLambda;
+    bool m_Caching;
+    float m_CacheSnap;
+    unsigned int m_StaticRenders;
+    float m_Splits[MAX_CASCADES];
+    float m_Bias[MAX_CASCADES];
+    glm::mat4 m_LightSpace[MAX_CASCADES];
+    glm::mat4 m_StaticLightSpace[MAX_CASCADES];
+    bool m_StaticValid[MAX_CASCADES];
+    bool m_FinalCurrent[MAX_CASCADES];
+    bool m_FinalHasDynamic[MAX_CASCADES];
+    ShadowCasterCuller m_Cullers[MAX_CASCADES];
+    ShadowCasterCuller m_StaticCullers[MAX_CASCADES];
+
+    unsigned int createDepthArray() {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, m_Resolution, m_Resolution,
+                     m_CascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+        return texture;
+    }
+
+    unsigned int createFBO(unsigned int texture) {
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Cascaded shadow map FBO is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return fbo;
+    }
+
+    void bindLayer(unsigned int fbo, unsigned int texture, int cascade) {
+        glViewport(0, 0, m_Resolution, m_Resolution);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+    }
+
+    static bool sameMatrix(const glm::mat4 &a, const glm::mat4 &b) {
+        for (int c = 0; c < 4; ++c) {
+            if (!(a[c] == b[c]))
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
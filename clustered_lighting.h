@@ -0,0 +1,300 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CLUSTER_SIMD 1
+#endif
+
+#include "shader.h"
+#include "thread_pool.h"
+
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 color;
+    float radius;
+
+    PointLight(glm::vec3 lightPosition, glm::vec3 lightColor, float influenceRadius)
+        : position(lightPosition), color(lightColor), radius(influenceRadius) {}
+
+    // Distance where inverse-square falloff drops below cutoff
+    static float radiusForIntensity(glm::vec3 lightColor, float cutoff = 0.05f) {
+        float peak = std::max(lightColor.x, std::max(lightColor.y, lightColor.z));
+        return std::sqrt(peak / cutoff);
+    }
+};
+
+// Clustered forward shading. The view frustum is cut into a 16x9 grid of
+// screen tiles and 24 exponential depth slices; every frame each cluster
+// gets the list of point lights whose influence sphere touches its
+// view-space box. Slices are built in parallel on the pool and the sphere
+// tests run four clusters at a time with SSE.
+//
+// The result goes to the GPU as three texture buffers (light data, per
+// cluster offset/count, flat index list) which pbr.fs walks for its own
+// cluster only.
+class ClusteredLighting {
+public:
+    static const int DIM_X = 16;
+    static const int DIM_Y = 9;
+    static const int DIM_Z = 24;
+    static const int CLUSTER_COUNT = DIM_X * DIM_Y * DIM_Z;
+    static_assert(DIM_X % 4 == 0, "cluster rows are tested four at a time");
+
+    // Texture units the buffers are bound to
+    static const int LIGHT_DATA_UNIT = 7;
+    static const int CLUSTER_GRID_UNIT = 8;
+    static const int LIGHT_INDEX_UNIT = 9;
+
+    ClusteredLighting() : m_Near(0.0f), m_Far(0.0f), m_ProjX(0.0f), m_ProjY(0.0f), m_IndexCount(0) {
+        unsigned int buffers[3];
+        unsigned int textures[3];
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        m_LightBuffer = buffers[0];
+        m_GridBuffer = buffers[1];
+        m_IndexBuffer = buffers[2];
+        m_LightTexture = textures[0];
+        m_GridTexture = textures[1];
+        m_IndexTexture = textures[2];
+        m_Grid.resize(CLUSTER_COUNT * 2);
+    }
+
+    ~ClusteredLighting() {
+        unsigned int buffers[3] = {m_LightBuffer, m_GridBuffer, m_IndexBuffer};
+        unsigned int textures[3] = {m_LightTexture, m_GridTexture, m_IndexTexture};
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+    }
+
+    unsigned int getIndexCount() const { return m_IndexCount; }
+
+    // Assigns lights to clusters for this view. zNear/zFar must match the
+    // projection used for rendering.
+    void build(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+               float zNear, float zFar, ThreadPool *pool = nullptr) {
+        if (zNear != m_Near || zFar != m_Far || projection[0][0] != m_ProjX || projection[1][1] != m_ProjY)
+            computeClusterBounds(projection, zNear, zFar);
+
+        // View-space spheres plus the slice range each one covers
+        m_ViewLights.resize(lights.size());
+        float logRatio = std::log(m_Far / m_Near);
+        for (size_t i = 0; i < lights.size(); ++i) {
+            glm::vec3 p(view * glm::vec4(lights[i].position, 1.0f));
+            ViewLight &vl = m_ViewLights[i];
+            vl.x = p.x;
+            vl.y = p.y;
+            vl.z = p.z;
+            vl.radius = lights[i].radius;
+            float dMin = std::max(-p.z - vl.radius, m_Near);
+            float dMax = -p.z + vl.radius;
+            if (dMax < m_Near || dMin > m_Far) {
+                vl.sliceMin = 1;
+                vl.sliceMax = 0;
+                continue;
+            }
+            vl.sliceMin = std::max(0, (int)std::floor(std::log(dMin / m_Near) / logRatio * DIM_Z));
+            vl.sliceMax = std::min(DIM_Z - 1, (int)std::floor(std::log(std::min(dMax, m_Far) / m_Near) / logRatio * DIM_Z));
+        }
+
+        for (int z = 0; z < DIM_Z; ++z)
+            m_SliceIndices[z].clear();
+
+        if (pool)
+            pool->parallelFor(0, DIM_Z, 1, [this](size_t b, size_t e) {
+                for (size_t z = b; z < e; ++z)
+                    buildSlice((int)z);
+            });
+        else
+            for (int z = 0; z < DIM_Z; ++z)
+                buildSlice(z);
+
+        // Stitch the per-slice lists into one index buffer
+        m_Indices.clear();
+        for (int z = 0; z < DIM_Z; ++z) {
+            uint32_t base = (uint32_t)m_Indices.size();
+            uint32_t *grid = &m_Grid[z * DIM_X * DIM_Y * 2];
+            for (int c = 0; c < DIM_X * DIM_Y; ++c)
+                grid[c * 2] += base;
+            m_Indices.insert(m_Indices.end(), m_SliceIndices[z].begin(), m_SliceIndices[z].end());
+        }
+        m_IndexCount = (unsigned int)m_Indices.size();
+
+        m_LightData.resize(std::max<size_t>(lights.size(), 1) * 8);
+        for (size_t i = 0; i < lights.size(); ++i) {
+            float *d = &m_LightData[i * 8];
+            d[0] = lights[i].position.x;
+            d[1] = lights[i].position.y;
+            d[2] = lights[i].position.z;
+            d[3] = lights[i].radius;
+            d[4] = lights[i].color.x;
+            d[5] = lights[i].color.y;
+            d[6] = lights[i].color.z;
+            d[7] = 0.0f;
+        }
+        if (m_Indices.empty())
+            m_Indices.push_back(0);
+
+        upload(m_LightBuffer, m_LightTexture, GL_RGBA32F, m_LightData.size() * sizeof(float), &m_LightData[0]);
+        upload(m_GridBuffer, m_GridTexture, GL_RG32UI, m_Grid.size() * sizeof(uint32_t), &m_Grid[0]);
+        upload(m_IndexBuffer, m_IndexTexture, GL_R32UI, m_Indices.size() * sizeof(uint32_t), &m_Indices[0]);
+    }
+
+    void bind(Shader &shader, float screenWidth, float screenHeight) const {
+        glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, m_LightTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, m_GridTexture);
+        glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, m_IndexTexture);
+
+        shader.setInt("lightData", LIGHT_DATA_UNIT);
+        shader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+        shader.setInt("lightIndices", LIGHT_INDEX_UNIT);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterDims"), DIM_X, DIM_Y, DIM_Z);
+        float logRatio = std::log(m_Far / m_Near);
+        shader.setVec2("clusterScaleBias", glm::vec2(DIM_Z / logRatio, -DIM_Z * std::log(m_Near) / logRatio));
+        shader.setVec2("screenSize", glm::vec2(screenWidth, screenHeight));
+    }
+
+private:
+    struct ViewLight {
+        float x, y, z, radius;
+        int sliceMin, sliceMax;
+    };
+
+    // View-space cluster boxes in SoA form, one row of DIM_X per (y, z)
+    float m_MinX[CLUSTER_COUNT], m_MinY[CLUSTER_COUNT], m_MinZ[CLUSTER_COUNT];
+    float m_MaxX[CLUSTER_COUNT], m_MaxY[CLUSTER_COUNT], m_MaxZ[CLUSTER_COUNT];
+    float m_Near, m_Far, m_ProjX, m_ProjY;
+
+    std::vector<ViewLight> m_ViewLights;
+    std::vector<uint32_t> m_SliceIndices[DIM_Z];
+    std::vector<uint32_t> m_Grid;
+    std::vector<uint32_t> m_Indices;
+    std::vector<float> m_LightData;
+    unsigned int m_IndexCount;
+
+    unsigned int m_LightBuffer, m_GridBuffer, m_IndexBuffer;
+    unsigned int m_LightTexture, m_GridTexture, m_IndexTexture;
+
+    void computeClusterBounds(const glm::mat4 &projection, float zNear, float zFar) {
+        m_Near = zNear;
+        m_Far = zFar;
+        m_ProjX = projection[0][0];
+        m_ProjY = projection[1][1];
+        for (int z = 0; z < DIM_Z; ++z) {
+            float d0 = zNear * std::pow(zFar / zNear, (float)z / DIM_Z);
+            float d1 = zNear * std::pow(zFar / zNear, (float)(z + 1) / DIM_Z);
+            for (int y = 0; y < DIM_Y; ++y) {
+                float ny0 = -1.0f + 2.0f * y / DIM_Y;
+                float ny1 = -1.0f + 2.0f * (y + 1) / DIM_Y;
+                for (int x = 0; x < DIM_X; ++x) {
+                    float nx0 = -1.0f + 2.0f * x / DIM_X;
+                    float nx1 = -1.0f + 2.0f * (x + 1) / DIM_X;
+                    // Tile corners at both slice depths; view x = ndc.x * d / P[0][0]
+                    float xs[4] = {nx0 * d0 / m_ProjX, nx1 * d0 / m_ProjX, nx0 * d1 / m_ProjX, nx1 * d1 / m_ProjX};
+                    float ys[4] = {ny0 * d0 / m_ProjY, ny1 * d0 / m_ProjY, ny0 * d1 / m_ProjY, ny1 * d1 / m_ProjY};
+                    int c = clusterIndex(x, y, z);
+                    m_MinX[c] = *std::min_element(xs, xs + 4);
+                    m_MaxX[c] = *std::max_element(xs, xs + 4);
+                    m_MinY[c] = *std::min_element(ys, ys + 4);
+                    m_MaxY[c] = *std::max_element(ys, ys + 4);
+                    m_MinZ[c] = -d1;
+                    m_MaxZ[c] = -d0;
+                }
+            }
+        }
+    }
+
+    static int clusterIndex(int x, int y, int z) { return x + DIM_X * (y + DIM_Y * z); }
+
+    // Fills offset (relative to the slice) and count for every cluster in
+    // slice z, and the slice's index list
+    void buildSlice(int z) {
+        std::vector<uint32_t> candidates;
+        for (size_t i = 0; i < m_ViewLights.size(); ++i) {
+            if (m_ViewLights[i].sliceMin <= z && z <= m_ViewLights[i].sliceMax)
+                candidates.push_back((uint32_t)i);
+        }
+
+        std::vector<uint32_t> &indices = m_SliceIndices[z];
+        std::vector<uint32_t> rowLists[DIM_X];
+        for (int y = 0; y < DIM_Y; ++y) {
+            for (int x = 0; x < DIM_X; ++x)
+                rowLists[x].clear();
+            int rowStart = clusterIndex(0, y, z);
+            for (uint32_t li : candidates) {
+                unsigned int mask = testRow(rowStart, m_ViewLights[li]);
+                while (mask) {
+                    int x = ctz(mask);
+                    rowLists[x].push_back(li);
+                    mask &= mask - 1;
+                }
+            }
+            for (int x = 0; x < DIM_X; ++x) {
+                uint32_t *cell = &m_Grid[(rowStart + x) * 2];
+                cell[0] = (uint32_t)indices.size();
+                cell[1] = (uint32_t)rowLists[x].size();
+                indices.insert(indices.end(), rowLists[x].begin(), rowLists[x].end());
+            }
+        }
+    }
+
+    // Bit x set if the sphere touches cluster (x, row)
+    unsigned int testRow(int rowStart, const ViewLight &l) const {
+        unsigned int mask = 0;
+#ifdef CLUSTER_SIMD
+        __m128 cx = _mm_set1_ps(l.x), cy = _mm_set1_ps(l.y), cz = _mm_set1_ps(l.z);
+        __m128 r2 = _mm_set1_ps(l.radius * l.radius);
+        __m128 zero = _mm_setzero_ps();
+        for (int x = 0; x < DIM_X; x += 4) {
+            int c = rowStart + x;
+            // distance from the centre to the box along each axis, 0 inside
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinX[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&m_MaxX[c]))), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinY[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&m_MaxY[c]))), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinZ[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&m_MaxZ[c]))), zero);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            mask |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(d2, r2)) << x;
+        }
+#else
+        for (int x = 0; x < DIM_X; ++x) {
+            int c = rowStart + x;
+            float dx = std::max(std::max(m_MinX[c] - l.x, l.x - m_MaxX[c]), 0.0f);
+            float dy = std::max(std::max(m_MinY[c] - l.y, l.y - m_MaxY[c]), 0.0f);
+            float dz = std::max(std::max(m_MinZ[c] - l.z, l.z - m_MaxZ[c]), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= l.radius * l.radius)
+                mask |= 1u << x;
+        }
+#endif
+        return mask;
+    }
+
+    static int ctz(unsigned int v) {
+        int n = 0;
+        while (!(v & 1u)) {
+            v >>= 1;
+            n++;
+        }
+        return n;
+    }
+
+    static void upload(unsigned int buffer, unsigned int texture, GLenum format, size_t bytes, const void *data) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // Orphan the old storage so the driver doesn't sync with last frame
+        glBufferData(GL_TEXTURE_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef COOKED_ASSET_H
+#define COOKED_ASSET_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+#include "mapped_file.h"
+#include "model.h"
+
+// Decoded image with its whole mip chain, rows in upload order
+struct CookedImage {
+    int width, height, channels;
+    bool hdr; // float texels, else 8 bit
+    std::vector<std::vector<unsigned char>> levels;
+
+    CookedImage() : width(0), height(0), channels(0), hdr(false) {}
+};
+
+// Runtime assets written by tools/pbr_cook.cpp. A cooked file mirrors
+// its source path under the cooked directory with an extra extension
+// (models/cup/cup.obj -> cooked/models/cup/cup.obj.mesh) and starts with
+// the hash of the source bytes and the cook settings, so the cooker only
+// rebuilds what changed. Loading one is a header check and a few copies.
+class CookedAsset {
+public:
+    static const uint32_t MESH_MAGIC = 0x4D524250;    // "PBRM"
+    static const uint32_t TEXTURE_MAGIC = 0x54524250; // "PBRT"
+    static const uint32_t VERSION = 1;
+
+    // FNV-1a, chain calls through seed
+    static uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; ++i)
+            seed = (seed ^ bytes[i]) * 1099511628211ull;
+        return seed;
+    }
+
+    static std::string meshPath(const std::string &cookedDir, const std::string &source) {
+        return cookedDir + "/" + source + ".mesh";
+    }
+
+    static std::string texturePath(const std::string &cookedDir, const std::string &source) {
+        return cookedDir + "/" + source + ".tex";
+    }
+
+    // Source hash a cooked file was built from, false if it is missing,
+    // of another kind or from an older cooker
+    static bool readHash(const std::string &file, uint32_t magic, uint64_t &sourceHash) {
+        std::ifstream in(file.c_str(), std::ios::binary);
+        Header header;
+        if (!in.read((char *)&header, sizeof(header)) || header.magic != magic || header.version != VERSION)
+            return false;
+        sourceHash = header.sourceHash;
+        return true;
+    }
+
+    static bool writeModel(const std::string &file, const ModelData &data, uint64_t sourceHash) {
+        std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+        Header header = {MESH_MAGIC, VERSION, sourceHash};
+        uint32_t meshCount = (uint32_t)data.meshes.size();
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)&meshCount, sizeof(meshCount));
+        out.write((const char *)&data.bounds, sizeof(AABB));
+        for (const MeshData &mesh : data.meshes) {
+            uint32_t counts[2] = {(uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size()};
+            out.write((const char *)counts, sizeof(counts));
+        }
+        for (const MeshData &mesh : data.meshes) {
+            out.write((const char *)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            out.write((const char *)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+        if (!out)
+            std::cout << "ERROR::COOKED_ASSET::FILE_NOT_WRITTEN " << file << std::endl;
+        return (bool)out;
+    }
+
+    static bool readModel(const std::string &file, ModelData &data) {
+        MappedFile mapped;
+        if (!fileExists(file) || !mapped.open(file))
+            return false;
+        return readModel(mapped.data(), mapped.size(), data, file);
+    }
+
+    // Same from bytes already in memory (an asset pack entry), name is
+    // only for messages
+    static bool readModel(const char *bytes, size_t size, ModelData &data, const std::string &name) {
+        Reader reader(bytes, size, MESH_MAGIC);
+        uint32_t meshCount = 0;
+        if (!reader.read(&meshCount, sizeof(meshCount)) || !reader.read(&data.bounds, sizeof(AABB)))
+            return fail(name);
+        // Counts are checked against the bytes left before anything is
+        // sized from them, a corrupt header fails instead of allocating
+        if (2 * (size_t)meshCount * sizeof(uint32_t) > reader.remaining())
+            return fail(name);
+        std::vector<uint32_t> counts(2 * (size_t)meshCount);
+        if (!reader.read(counts.data(), counts.size() * sizeof(uint32_t)))
+            return fail(name);
+        data.meshes.assign(meshCount, MeshData());
+        for (uint32_t m = 0; m < meshCount; ++m) {
+            MeshData &mesh = data.meshes[m];
+            if ((size_t)counts[2 * m] * sizeof(Vertex) + (size_t)counts[2 * m + 1] * sizeof(unsigned int) >
+                reader.remaining())
+                return fail(name);
+            mesh.vertices.resize(counts[2 * m]);
+            mesh.indices.resize(counts[2 * m + 1]);
+            if (!reader.read(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) ||
+                !reader.read(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)))
+                return fail(name);
+            for (unsigned int index : mesh.indices)
+                if (index >= mesh.vertices.size())
+                    return fail(name);
+        }
+        data.uvDensity = Model::computeUvDensity(data.meshes);
+        return true;
+    }
+
+    static bool writeTexture(const std::string &file, const CookedImage &image, uint64_t sourceHash) {
+        std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+        Header header = {TEXTURE_MAGIC, VERSION, sourceHash};
+        uint32_t info[5] = {(uint32_t)image.width, (uint32_t)image.height, (uint32_t)image.channels,
+                            (uint32_t)image.hdr, (uint32_t)image.levels.size()};
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)info, sizeof(info));
+        for (const std::vector<unsigned char> &level : image.levels)
+            out.write((const char *)level.data(), level.size());
+        if (!out)
+            std::cout << "ERROR::COOKED_ASSET::FILE_NOT_WRITTEN " << file << std::endl;
+        return (bool)out;
+    }
+
+    static bool readTexture(const std::string &file, CookedImage &image) {
+        MappedFile mapped;
+        if (!fileExists(file) || !mapped.open(file))
+            return false;
+        std::vector<const unsigned char *> levels;
+        if (!parseTexture(mapped.data(), mapped.size(), image, levels))
+            return fail(file);
+        for (size_t l = 0; l < levels.size(); ++l)
+            image.levels[l].assign(levels[l], levels[l] + levelSize(image, l));
+        return true;
+    }
+
+    // Box filtered mips down to 1x1 from levels[0]
+    static void buildMips(CookedImage &image) {
+        image.levels.resize(1);
+        int width = image.width, height = image.height, level = 0;
+        while (width > 1 || height > 1) {
+            int nextWidth = std::max(width / 2, 1), nextHeight = std::max(height / 2, 1);
+            image.levels.push_back(std::vector<unsigned char>(levelSize(image, level + 1)));
+            const std::vector<unsigned char> &src = image.levels[level];
+            std::vector<unsigned char> &dst = image.levels[level + 1];
+            for (int y = 0; y < nextHeight; ++y) {
+                for (int x = 0; x < nextWidth; ++x) {
+                    int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                    int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                    for (int c = 0; c < image.channels; ++c) {
+                        size_t texels[4] = {((size_t)y0 * width + x0) * image.channels + c,
+                                            ((size_t)y0 * width + x1) * image.channels + c,
+                                            ((size_t)y1 * width + x0) * image.channels + c,
+                                            ((size_t)y1 * width + x1) * image.channels + c};
+                        size_t out = ((size_t)y * nextWidth + x) * image.channels + c;
+                        if (image.hdr) {
+                            float sum = 0.0f, value;
+                            for (size_t t : texels) {
+                                std::memcpy(&value, &src[t * 4], 4);
+                                sum += value;
+                            }
+                            value = sum * 0.25f;
+                            std::memcpy(&dst[out * 4], &value, 4);
+                        } else {
+                            dst[out] = (unsigned char)((src[texels[0]] + src[texels[1]] + src[texels[2]] +
+                                                        src[texels[3]] + 2) / 4);
+                        }
+                    }
+                }
+            }
+            width = nextWidth;
+            height = nextHeight;
+            ++level;
+        }
+    }
+
+    // Same sampler setup as the viewer's uploadTexture, with the stored
+    // mips instead of glGenerateMipmap
+    static unsigned int uploadTexture(const CookedImage &image) {
+        std::vector<const unsigned char *> levels;
+        for (const std::vector<unsigned char> &level : image.levels)
+            levels.push_back(level.data());
+        unsigned int textureID = 0;
+        upload(image, levels, textureID);
+        return textureID;
+    }
+
+    // Uploads a cooked texture file that is already in memory (mapped or
+    // in an asset pack) straight from its bytes, no CookedImage copy. A
+    // textureID of 0 creates a texture, anything else is respecified
+    // (placeholders are replaced in place).
+    static bool uploadTexture(const char *bytes, size_t size, unsigned int &textureID, const std::string &name) {
+        CookedImage image;
+        std::vector<const unsigned char *> levels;
+        if (!parseTexture(bytes, size, image, levels))
+            return fail(name);
+        upload(image, levels, textureID);
+        return true;
+    }
+
+    // Just the bounds of a cooked mesh, for a proxy until it is loaded
+    static bool readBounds(const char *bytes, size_t size, AABB &bounds) {
+        Reader reader(bytes, size, MESH_MAGIC);
+        uint32_t meshCount;
+        return reader.read(&meshCount, sizeof(meshCount)) && reader.read(&bounds, sizeof(AABB)) && bounds.valid();
+    }
+
+    // Header and level pointers into bytes, image.levels is left empty
+    static bool parseTexture(const char *bytes, size_t size, CookedImage &image,
+                             std::vector<const unsigned char *> &levels) {
+        Reader reader(bytes, size, TEXTURE_MAGIC);
+        uint32_t info[5];
+        if (!reader.read(info, sizeof(info)) || info[0] == 0 || info[1] == 0 || info[2] < 1 || info[2] > 4 ||
+            info[4] > 32)
+            return false;
+        image.width = (int)info[0];
+        image.height = (int)info[1];
+        image.channels = (int)info[2];
+        image.hdr = info[3] != 0;
+        image.levels.assign(info[4], std::vector<unsigned char>());
+        levels.clear();
+        for (uint32_t l = 0; l < info[4]; ++l) {
+            const char *level = reader.skip(levelSize(image, l));
+            if (!level)
+                return false;
+            levels.push_back((const unsigned char *)level);
+        }
+        return true;
+    }
+
+    static size_t levelSize(const CookedImage &image, size_t level) {
+        size_t width = std::max(image.width >> level, 1), height = std::max(image.height >> level, 1);
+        return width * height * image.channels * (image.hdr ? 4 : 1);
+    }
+
+    // One level into the bound texture. Null pixels give an empty (0x0)
+    // level, which hands its memory back; TextureStreamer drops levels
+    // under GL_TEXTURE_BASE_LEVEL this way.
+    static void uploadLevel(const CookedImage &image, int level, const unsigned char *pixels) {
+        static const GLenum FORMATS[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        static const GLenum HDR_FORMATS[4] = {GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F};
+        GLenum format = FORMATS[image.channels - 1];
+        GLint internalFormat = image.hdr ? HDR_FORMATS[image.channels - 1] : format;
+        int width = pixels ? std::max(image.width >> level, 1) : 0;
+        int height = pixels ? std::max(image.height >> level, 1) : 0;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format,
+                     image.hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Sampler state of the bound texture, sampling levels base..count-1
+    static void setSampler(const CookedImage &image, int base, int count) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+        GLint wrap = image.hdr ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+    };
+
+    // Bounds checked reads from a mapped cooked file
+    struct Reader {
+        const char *at, *end;
+
+        Reader(const char *data, size_t size, uint32_t magic) : at(data), end(data + size) {
+            Header header;
+            if (!read(&header, sizeof(header)) || header.magic != magic || header.version != VERSION)
+                at = end = nullptr;
+        }
+
+        bool read(void *out, size_t size) {
+            if (!at || (size_t)(end - at) < size)
+                return false;
+            std::memcpy(out, at, size);
+            at += size;
+            return true;
+        }
+
+        size_t remaining() const { return at ? (size_t)(end - at) : 0; }
+
+        const char *skip(size_t size) {
+            if (!at || (size_t)(end - at) < size)
+                return nullptr;
+            at += size;
+            return at - size;
+        }
+    };
+
+    static void upload(const CookedImage &image, const std::vector<const unsigned char *> &levels,
+                       unsigned int &textureID) {
+        if (textureID == 0)
+            glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (size_t l = 0; l < levels.size(); ++l)
+            uploadLevel(image, (int)l, levels[l]);
+        setSampler(image, 0, (int)levels.size());
+    }
+
+    // Missing cooked files are normal (not cooked yet), quietly
+    static bool fileExists(const std::string &file) { return (bool)std::ifstream(file.c_str()); }
+
+    static bool fail(const std::string &file) {
+        std::cout << "ERROR::COOKED_ASSET::INVALID_FILE " << file << std::endl;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// GPU time of a span of commands, read a few frames late (like
+// OverdrawCounter) so the CPU never waits. Uses a pair of GL_TIMESTAMP
+// queries rather than GL_TIME_ELAPSED: those can't nest, and llvmpipe
+// sometimes returns a raw timestamp for them.
+class GpuTimer {
+public:
+    static const int FRAMES = 4;
+
+    GpuTimer() : m_Frame(0), m_LastFrame(0), m_LastMs(0.0f), m_LastTag(0.0f) {
+        glGenQueries(FRAMES * 2, &m_Queries[0][0]);
+        for (int i = 0; i < FRAMES; ++i)
+            m_Issued[i] = false;
+    }
+
+    ~GpuTimer() { glDeleteQueries(FRAMES * 2, &m_Queries[0][0]); }
+
+    // tag is handed back with the result, e.g. the settings the frame
+    // was rendered with
+    void begin(float tag = 0.0f) {
+        m_Tags[m_Frame % FRAMES] = tag;
+        glQueryCounter(m_Queries[m_Frame % FRAMES][0], GL_TIMESTAMP);
+    }
+
+    void end() {
+        glQueryCounter(m_Queries[m_Frame % FRAMES][1], GL_TIMESTAMP);
+        m_Issued[m_Frame % FRAMES] = true;
+    }
+
+    // Call once per frame after end(). Returns true when an older frame's
+    // result came in (getLastMs() then holds it).
+    bool endFrame() {
+        m_Frame++;
+        int oldest = m_Frame % FRAMES;
+        if (!m_Issued[oldest])
+            return false;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[oldest][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(m_Queries[oldest][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(m_Queries[oldest][1], GL_QUERY_RESULT, &end);
+        m_LastMs = (end - start) / 1.0e6f;
+        m_LastTag = m_Tags[oldest];
+        m_LastFrame = m_Frame - FRAMES;
+        m_Issued[oldest] = false;
+        return true;
+    }
+
+    float getLastMs() const { return m_LastMs; }
+    float getLastTag() const { return m_LastTag; }
+    // Which frame (counting endFrame() calls from 0) the result is for
+    unsigned int getLastFrame() const { return m_LastFrame; }
+
+private:
+    unsigned int m_Queries[FRAMES][2];
+    float m_Tags[FRAMES];
+    bool m_Issued[FRAMES];
+    unsigned int m_Frame;
+    unsigned int m_LastFrame;
+    float m_LastMs;
+    float m_LastTag;
+};
+
+// Picks the main pass resolution from measured GPU frame time. Each
+// timing is divided by the pixel fraction that frame was rendered at,
+// giving an estimate of what a full resolution frame would cost; the
+// scale is then the one that fits that estimate into the budget. Because
+// the estimate doesn't depend on the current scale, the timer latency
+// can't wind the controller up. Changes are still rate limited.
+class DynamicResolution {
+public:
+    struct Settings {
+        float targetMs;  // GPU budget for the scaled passes
+        float minScale;  // per axis, of the window size
+        float maxScale;
+        float maxStep;   // largest relative change per update
+        float deadBand;  // relative error that is left alone
+    };
+
+    // One entry per timer result
+    struct Sample {
+        float gpuMs;
+        float scale;
+    };
+
+    static const int HISTORY = 240;
+
+    explicit DynamicResolution(const Settings &settings)
+        : m_Settings(settings), m_Scale(settings.maxScale), m_FullResolutionMs(0.0f), m_Next(0) {}
+
+    const Settings &getSettings() const { return m_Settings; }
+    void setTargetMs(float targetMs) { m_Settings.targetMs = targetMs; }
+
+    float getScale() const { return m_Scale; }
+    // Smoothed estimate of a full resolution frame
+    float getFullResolutionMs() const { return m_FullResolutionMs; }
+
+    // Render size for a window size, rounded to 8 pixels so small scale
+    // changes don't each need new render targets
+    int scaledSize(int windowSize) const {
+        int size = (int)std::lround(windowSize * m_Scale / 8.0f) * 8;
+        return std::max(8, std::min(size, windowSize));
+    }
+
+    // Feeds one GPU frame time and the fraction of the window's pixels
+    // that frame rendered, returns the new scale
+    float update(float gpuMs, float pixelFraction) {
+        float fullMs = gpuMs / std::max(pixelFraction, 0.01f);
+        m_FullResolutionMs =
+            m_FullResolutionMs <= 0.0f ? fullMs : m_FullResolutionMs + (fullMs - m_FullResolutionMs) * 0.2f;
+        float desired = std::sqrt(m_Settings.targetMs / std::max(m_FullResolutionMs, 0.01f));
+        float change = desired / m_Scale;
+        if (std::fabs(change - 1.0f) > m_Settings.deadBand) {
+            change = std::max(1.0f - m_Settings.maxStep, std::min(change, 1.0f + m_Settings.maxStep));
+            m_Scale = std::max(m_Settings.minScale, std::min(m_Scale * change, m_Settings.maxScale));
+        }
+        record(gpuMs);
+        return m_Scale;
+    }
+
+    // Oldest first
+    std::vector<Sample> getHistory() const {
+        std::vector<Sample> history;
+        size_t count = m_History.size();
+        for (size_t i = 0; i < count; ++i)
+            history.push_back(m_History[(m_Next + i) % count]);
+        return history;
+    }
+
+    void printHistory() const {
+        std::cout << "gpu_ms,scale" << std::endl;
+        for (const Sample &sample : getHistory())
+            std::cout << sample.gpuMs << "," << sample.scale << std::endl;
+    }
+
+private:
+    Settings m_Settings;
+    float m_Scale;
+    float m_FullResolutionMs;
+    std::vector<Sample> m_History;
+    size_t m_Next;
+
+    void record(float gpuMs) {
+        Sample sample = {gpuMs, m_Scale};
+        if (m_History.size() < HISTORY) {
+            m_History.push_back(sample);
+            return;
+        }
+        m_History[m_Next] = sample;
+        m_Next = (m_Next + 1) % HISTORY;
+    }
+};
+
+#endif
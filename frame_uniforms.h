@@ -0,0 +1,31 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// Uniform block bindings shared by every program that includes
+// shaders/frame_data.glsl or shaders/draw_data.glsl
+const unsigned int FRAME_DATA_BINDING = 0;
+const unsigned int DRAW_DATA_BINDING = 1;
+
+// std140 mirror of the FrameData block (vec3s padded to vec4)
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 camPos;
+    glm::vec4 sunPosition;
+    glm::vec4 sunColor;
+};
+
+struct DrawData {
+    glm::mat4 model;
+};
+
+inline void bindFrameUniformBlocks(Shader &shader) {
+    shader.setUniformBlock("FrameData", FRAME_DATA_BINDING);
+    shader.setUniformBlock("DrawData", DRAW_DATA_BINDING);
+}
+
+#endif
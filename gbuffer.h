@@ -0,0 +1,78 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+#include "render_graph.h"
+#include "render_stats.h"
+#include "shader.h"
+
+// Render targets for the deferred path, 12 bytes of colour per pixel:
+//   0  RGBA8   albedo (gamma encoded)
+//   1  RG16    octahedral world normal
+//   2  RGBA8   ao, roughness, metallic
+//   depth      DEPTH24_STENCIL8, sampled by the lighting pass to rebuild
+//              world position, so there is no position target
+class GBuffer {
+public:
+    // Texture units used by the lighting pass
+    static const int ALBEDO_UNIT = 0;
+    static const int NORMAL_UNIT = 1;
+    static const int ORM_UNIT = 2;
+    static const int DEPTH_UNIT = 3;
+
+    // One frame's targets, transients of the render graph. Depth is the
+    // scene depth buffer, shared with the pre-pass and the skybox.
+    struct Targets {
+        RenderResource albedo, normal, orm, depth;
+    };
+
+    GBuffer() { glGenVertexArrays(1, &m_EmptyVAO); }
+
+    ~GBuffer() { glDeleteVertexArrays(1, &m_EmptyVAO); }
+
+    static Targets createTargets(RenderGraph &graph, int width, int height, RenderResource depth) {
+        Targets targets;
+        targets.albedo = graph.createTarget("gAlbedo", {width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE});
+        targets.normal = graph.createTarget("gNormal", {width, height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT});
+        targets.orm = graph.createTarget("gORM", {width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE});
+        targets.depth = depth;
+        return targets;
+    }
+
+    // Draws the fullscreen lighting pass into the currently bound
+    // framebuffer. The shader's other inputs (lights, shadows, env map)
+    // must already be set up.
+    void drawLightingPass(Shader &shader, const glm::mat4 &invViewProjection, const RenderGraph &graph,
+                          const Targets &targets) {
+        shader.setInt("gAlbedo", ALBEDO_UNIT);
+        shader.setInt("gNormal", NORMAL_UNIT);
+        shader.setInt("gORM", ORM_UNIT);
+        shader.setInt("gDepth", DEPTH_UNIT);
+        shader.setMat4("invViewProjection", invViewProjection);
+
+        glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.albedo));
+        glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.normal));
+        glActiveTexture(GL_TEXTURE0 + ORM_UNIT);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.orm));
+        glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.depth));
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(m_EmptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        renderStats().addDraw(1);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int m_EmptyVAO;
+};
+
+#endif
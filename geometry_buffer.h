@@ -0,0 +1,122 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+#include "model.h"
+
+// Where one mesh lives inside the merged buffers
+struct MeshRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+// Every model's meshes in one vertex and one index buffer behind a single
+// VAO (same layout as Mesh), so a whole scene can be drawn with
+// multi-draw calls. Attribute 5 is a per-instance draw id that a draw
+// picks through its baseInstance, so shaders can find per-object data
+// without gl_DrawID (GL 4.6).
+class GeometryBuffer {
+public:
+    static const int DRAW_ID_LOCATION = 5;
+
+    unsigned int VAO;
+
+    GeometryBuffer() : VAO(0), m_VBO(0), m_EBO(0), m_DrawIdVBO(0) {}
+
+    ~GeometryBuffer() {
+        if (VAO) {
+            unsigned int buffers[3] = {m_VBO, m_EBO, m_DrawIdVBO};
+            glDeleteBuffers(3, buffers);
+            glDeleteVertexArrays(1, &VAO);
+        }
+    }
+
+    // Appends a model's meshes, returns the index of its first range.
+    // Adding the same model twice returns the earlier ranges.
+    size_t add(const Model *model) {
+        for (size_t i = 0; i < m_Models.size(); ++i)
+            if (m_Models[i].model == model)
+                return m_Models[i].firstRange;
+        m_Models.push_back(ModelEntry{model, m_Ranges.size()});
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (const Mesh &mesh : model->meshes) {
+            mesh.getGeometry(vertices, indices);
+            MeshRange range;
+            range.firstIndex = (unsigned int)m_Indices.size();
+            range.indexCount = (unsigned int)indices.size();
+            range.baseVertex = (int)m_Vertices.size();
+            m_Ranges.push_back(range);
+            m_Vertices.insert(m_Vertices.end(), vertices.begin(), vertices.end());
+            m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+        }
+        return m_Models.back().firstRange;
+    }
+
+    const MeshRange &getRange(size_t index) const { return m_Ranges[index]; }
+    size_t getRangeCount() const { return m_Ranges.size(); }
+
+    // Forgets every model (the GL buffers stay until the next upload).
+    // Needed when models are replaced, a new one may reuse a freed address.
+    void clear() {
+        m_Models.clear();
+        m_Ranges.clear();
+        m_Vertices.clear();
+        m_Indices.clear();
+    }
+
+    // Uploads everything added so far. maxDraws sizes the draw id stream,
+    // it must cover the largest baseInstance used.
+    void upload(unsigned int maxDraws) {
+        if (!VAO) {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &m_VBO);
+            glGenBuffers(1, &m_EBO);
+            glGenBuffers(1, &m_DrawIdVBO);
+        }
+        std::vector<unsigned int> drawIds(maxDraws);
+        for (unsigned int i = 0; i < maxDraws; ++i)
+            drawIds[i] = i;
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), m_Vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), m_Indices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_DrawIdVBO);
+        glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(unsigned int), drawIds.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+        glBindVertexArray(0);
+    }
+
+private:
+    struct ModelEntry {
+        const Model *model;
+        size_t firstRange;
+    };
+
+    std::vector<ModelEntry> m_Models;
+    std::vector<MeshRange> m_Ranges;
+    std::vector<Vertex> m_Vertices;
+    std::vector<unsigned int> m_Indices;
+    unsigned int m_VBO, m_EBO, m_DrawIdVBO;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// The bundled glad only covers GL 3.3 core. The optional GPU-driven path
+// needs a few GL 4.3 entry points and the streaming buffers use 4.4
+// buffer storage when present. They are loaded here at runtime with the
+// same loader glad used. Names follow glad (glad_glX plus a glX macro),
+// so the blocks can go once glad is regenerated for 4.4.
+//
+// Call loadGLExtensions() after gladLoadGLLoader(), then check hasGL43()
+// or hasBufferStorage() before using anything declared here. Like
+// glad.c, one translation unit holds the pointers: define
+// GL_EXT_IMPLEMENTATION before including this file in it.
+
+#ifndef GL_VERSION_4_3
+#define GL_VERSION_4_3 1
+#define GL_EXT_DECLARES_4_3
+
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                  GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect,
+                                                           GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLCOPYIMAGESUBDATAPROC)(GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX,
+                                                  GLint srcY, GLint srcZ, GLuint dstName, GLenum dstTarget,
+                                                  GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ,
+                                                  GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+
+extern PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute;
+extern PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier;
+extern PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture;
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect;
+extern PFNGLCOPYIMAGESUBDATAPROC glad_glCopyImageSubData;
+
+#define glDispatchCompute glad_glDispatchCompute
+#define glMemoryBarrier glad_glMemoryBarrier
+#define glBindImageTexture glad_glBindImageTexture
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#define glCopyImageSubData glad_glCopyImageSubData
+#endif
+
+// GL 4.4 / ARB_buffer_storage, for persistently mapped streaming buffers
+#ifndef GL_VERSION_4_4
+#define GL_VERSION_4_4 1
+#define GL_EXT_DECLARES_4_4
+
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+extern PFNGLBUFFERSTORAGEPROC glad_glBufferStorage;
+
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+extern bool g_GL43Available;
+extern bool g_BufferStorageAvailable;
+
+inline bool hasGL43() { return g_GL43Available; }
+inline bool hasBufferStorage() { return g_BufferStorageAvailable; }
+
+inline bool hasGLExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Returns whether the GL 4.3 set is usable, buffer storage is reported
+// separately by hasBufferStorage()
+inline bool loadGLExtensions(GLADloadproc load) {
+    g_GL43Available = false;
+    g_BufferStorageAvailable = false;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) ||
+        hasGLExtension("GL_ARB_buffer_storage")) {
+        glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+        g_BufferStorageAvailable = glad_glBufferStorage != nullptr;
+    }
+    if (GLVersion.major < 4 || (GLVersion.major == 4 && GLVersion.minor < 3))
+        return false;
+    glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+    glad_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+    glad_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)load("glBindImageTexture");
+    glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    glad_glCopyImageSubData = (PFNGLCOPYIMAGESUBDATAPROC)load("glCopyImageSubData");
+    g_GL43Available = glad_glDispatchCompute && glad_glMemoryBarrier && glad_glBindImageTexture &&
+                      glad_glMultiDrawElementsIndirect && glad_glCopyImageSubData;
+    return g_GL43Available;
+}
+
+#endif
+
+#if defined(GL_EXT_IMPLEMENTATION) && !defined(GL_EXT_IMPLEMENTED)
+#define GL_EXT_IMPLEMENTED
+#ifdef GL_EXT_DECLARES_4_3
+PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute = nullptr;
+PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier = nullptr;
+PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = nullptr;
+PFNGLCOPYIMAGESUBDATAPROC glad_glCopyImageSubData = nullptr;
+#endif
+#ifdef GL_EXT_DECLARES_4_4
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = nullptr;
+#endif
+bool g_GL43Available = false;
+bool g_BufferStorageAvailable = false;
+#endif
@@ -0,0 +1,591 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+#include "json.h"
+#include "mapped_file.h"
+#include "model.h"
+#include "profiler.h"
+#include "scene_objects.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+// Everything in a .glb drawn with one material. SceneObject carries one
+// Material per model, so a file with several materials becomes several
+// parts sharing the same node transforms.
+struct GltfPart {
+    std::string name;
+    std::unique_ptr<Model> model;
+    Material material;
+};
+
+// glTF 2.0 binary loader. The file is memory mapped and its BIN chunk
+// goes to one GL buffer in a single glBufferData, straight from the
+// mapping. Primitives whose accessors the PBR shaders can read as they
+// are (float position/normal/uv/tangent, indexed, identity node
+// transform) draw from that buffer without touching a vertex on the CPU;
+// anything else is converted to Vertex and uploaded the usual way.
+class GltfLoader {
+public:
+    explicit GltfLoader(ThreadPool *pool = nullptr) : m_Pool(pool), m_Bin(nullptr), m_BinSize(0) {}
+
+    bool load(const std::string &path, std::vector<GltfPart> &parts) {
+        PROFILE_SCOPE("load glb");
+        if (!m_File.open(path))
+            return false;
+        const char *data = m_File.data();
+        size_t size = m_File.size();
+        if (size < 12 || read32(data) != GLB_MAGIC || read32(data + 4) != 2) {
+            std::cout << "ERROR::GLTF::NOT_A_GLB_V2 " << path << std::endl;
+            return false;
+        }
+        size_t length = read32(data + 8);
+        if (length > size) {
+            std::cout << "ERROR::GLTF::TRUNCATED " << path << std::endl;
+            return false;
+        }
+
+        const char *json = nullptr;
+        size_t jsonSize = 0;
+        for (size_t offset = 12; offset + 8 <= length;) {
+            size_t chunkLength = read32(data + offset);
+            uint32_t chunkType = read32(data + offset + 4);
+            offset += 8;
+            if (chunkLength > length - offset) {
+                std::cout << "ERROR::GLTF::TRUNCATED " << path << std::endl;
+                return false;
+            }
+            if (chunkType == CHUNK_JSON && !json) {
+                json = data + offset;
+                jsonSize = chunkLength;
+            } else if (chunkType == CHUNK_BIN && !m_Bin) {
+                m_Bin = data + offset;
+                m_BinSize = chunkLength;
+            }
+            offset += chunkLength;
+        }
+        std::string error;
+        if (!json || !JsonValue::parse(json, json + jsonSize, m_Json, error)) {
+            std::cout << "ERROR::GLTF::JSON_NOT_PARSED " << path << " " << error << std::endl;
+            return false;
+        }
+        // Only the embedded buffer; .gltf files with external .bin
+        // buffers are not supported
+        const JsonValue &buffers = m_Json["buffers"];
+        if (buffers.size() > 1 || buffers[(size_t)0].has("uri")) {
+            std::cout << "ERROR::GLTF::EXTERNAL_BUFFERS_NOT_SUPPORTED " << path << std::endl;
+            return false;
+        }
+
+        size_t slash = path.find_last_of("/\\");
+        m_Directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        std::string stem = path.substr(slash == std::string::npos ? 0 : slash + 1);
+
+        if (m_Bin && m_BinSize > 0) {
+            PROFILE_SCOPE("upload glb buffer");
+            unsigned int buffer;
+            glGenBuffers(1, &buffer);
+            m_Buffer = makeSharedBuffer(buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, m_BinSize, m_Bin, GL_STATIC_DRAW);
+        }
+
+        // Meshes grouped by material, -1 is the glTF default material
+        std::map<int, Group> groups;
+        collectNodes(groups);
+
+        decodeImages(groups);
+        for (std::map<int, Group>::iterator it = groups.begin(); it != groups.end(); ++it) {
+            if (it->second.meshes.empty())
+                continue;
+            GltfPart part;
+            const JsonValue &material = m_Json["materials"][(size_t)std::max(it->first, 0)];
+            part.name = it->first >= 0 && !material["name"].asString().empty()
+                            ? material["name"].asString()
+                            : stem + "#" + std::to_string(it->first);
+            part.model.reset(new Model(part.name, std::move(it->second.meshes), it->second.bounds));
+            part.material = makeMaterial(it->first);
+            parts.push_back(std::move(part));
+        }
+        for (Image &image : m_Images)
+            stbi_image_free(image.pixels);
+        m_Images.clear();
+        return !parts.empty();
+    }
+
+    // GL buffer holding the BIN chunk. The in-place meshes share it, it
+    // is deleted with the last of them (or the loader, if none uses it).
+    unsigned int getBuffer() const { return m_Buffer ? *m_Buffer : 0; }
+
+private:
+    static const uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+    static const uint32_t CHUNK_JSON = 0x4E4F534A; // "JSON"
+    static const uint32_t CHUNK_BIN = 0x004E4942;  // "BIN\0"
+    static const int MAX_NODE_DEPTH = 64;
+
+    struct Group {
+        std::vector<Mesh> meshes;
+        AABB bounds;
+    };
+
+    struct Accessor {
+        size_t offset; // into the BIN chunk
+        size_t count;
+        size_t stride;
+        int components;
+        GLenum componentType;
+        bool normalized;
+    };
+
+    struct Image {
+        unsigned char *pixels;
+        int width, height, channels;
+    };
+
+    ThreadPool *m_Pool;
+    MappedFile m_File;
+    JsonValue m_Json;
+    std::string m_Directory;
+    SharedBuffer m_Buffer;
+    const char *m_Bin;
+    size_t m_BinSize;
+    std::vector<Image> m_Images;
+    std::map<std::string, unsigned int> m_Textures;
+
+    static uint32_t read32(const char *p) {
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+
+    static int componentSize(GLenum type) {
+        switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    // glTF componentType values are the GL enums
+    bool accessor(int index, Accessor &out) const {
+        const JsonValue &a = m_Json["accessors"][(size_t)index];
+        if (index < 0 || !a.isObject() || a.has("sparse") || !a.has("bufferView"))
+            return false;
+        const JsonValue &view = m_Json["bufferViews"][(size_t)a["bufferView"].asInt(-1)];
+        const std::string &type = a["type"].asString();
+        out.components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+        out.componentType = (GLenum)a["componentType"].asInt();
+        out.normalized = a["normalized"].asBool();
+        out.count = (size_t)a["count"].asNumber();
+        int elementSize = out.components * componentSize(out.componentType);
+        if (!view.isObject() || elementSize == 0 || out.count == 0)
+            return false;
+        size_t viewOffset = (size_t)view["byteOffset"].asNumber();
+        size_t viewLength = (size_t)view["byteLength"].asNumber();
+        out.offset = viewOffset + (size_t)a["byteOffset"].asNumber();
+        out.stride = (size_t)view["byteStride"].asNumber(elementSize);
+        size_t last = out.offset + out.stride * (out.count - 1) + elementSize;
+        return out.stride >= (size_t)elementSize && last <= viewOffset + viewLength && last <= m_BinSize;
+    }
+
+    glm::vec4 element(const Accessor &a, size_t i) const {
+        const char *p = m_Bin + a.offset + a.stride * i;
+        glm::vec4 v(0.0f);
+        for (int c = 0; c < a.components; ++c) {
+            switch (a.componentType) {
+            case GL_FLOAT: {
+                float f;
+                std::memcpy(&f, p + c * 4, 4);
+                v[c] = f;
+                break;
+            }
+            case GL_UNSIGNED_BYTE: v[c] = ((const uint8_t *)p)[c] / (a.normalized ? 255.0f : 1.0f); break;
+            case GL_BYTE: {
+                int8_t b = ((const int8_t *)p)[c];
+                v[c] = a.normalized ? std::max(b / 127.0f, -1.0f) : b;
+                break;
+            }
+            case GL_UNSIGNED_SHORT: {
+                uint16_t s;
+                std::memcpy(&s, p + c * 2, 2);
+                v[c] = s / (a.normalized ? 65535.0f : 1.0f);
+                break;
+            }
+            case GL_SHORT: {
+                int16_t s;
+                std::memcpy(&s, p + c * 2, 2);
+                v[c] = a.normalized ? std::max(s / 32767.0f, -1.0f) : s;
+                break;
+            }
+            case GL_UNSIGNED_INT: {
+                uint32_t u;
+                std::memcpy(&u, p + c * 4, 4);
+                v[c] = (float)u;
+                break;
+            }
+            }
+        }
+        return v;
+    }
+
+    unsigned int index(const Accessor &a, size_t i) const {
+        const char *p = m_Bin + a.offset + a.stride * i;
+        if (a.componentType == GL_UNSIGNED_BYTE)
+            return *(const uint8_t *)p;
+        if (a.componentType == GL_UNSIGNED_SHORT) {
+            uint16_t s;
+            std::memcpy(&s, p, 2);
+            return s;
+        }
+        uint32_t u;
+        std::memcpy(&u, p, 4);
+        return u;
+    }
+
+    static glm::mat4 nodeMatrix(const JsonValue &node) {
+        glm::mat4 m(1.0f);
+        const JsonValue &matrix = node["matrix"];
+        if (matrix.size() == 16) {
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 4; ++r)
+                    m[c][r] = (float)matrix[(size_t)(c * 4 + r)].asNumber();
+            return m;
+        }
+        const JsonValue &t = node["translation"];
+        const JsonValue &r = node["rotation"];
+        const JsonValue &s = node["scale"];
+        float x = (float)r[(size_t)0].asNumber(), y = (float)r[1].asNumber(), z = (float)r[2].asNumber();
+        float w = (float)r[3].asNumber(1.0);
+        // Rotation from the unit quaternion, then scale the columns
+        m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f);
+        m[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f);
+        m[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f);
+        for (int c = 0; c < 3; ++c)
+            m[c] *= (float)s[(size_t)c].asNumber(1.0);
+        m[3] = glm::vec4((float)t[(size_t)0].asNumber(), (float)t[1].asNumber(), (float)t[2].asNumber(), 1.0f);
+        return m;
+    }
+
+    static bool isIdentity(const glm::mat4 &m) {
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                if (std::fabs(m[c][r] - (c == r ? 1.0f : 0.0f)) > 1e-6f)
+                    return false;
+        return true;
+    }
+
+    void collectNodes(std::map<int, Group> &groups) {
+        const JsonValue &nodes = m_Json["nodes"];
+        const JsonValue &scene = m_Json["scenes"][(size_t)m_Json["scene"].asInt(0)];
+        if (scene.isObject()) {
+            for (size_t i = 0; i < scene["nodes"].size(); ++i)
+                visitNode(scene["nodes"][i].asInt(-1), glm::mat4(1.0f), 0, groups);
+            return;
+        }
+        // No scene: every node nobody lists as a child is a root
+        std::vector<bool> isChild(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); ++i)
+            for (size_t c = 0; c < nodes[i]["children"].size(); ++c) {
+                int child = nodes[i]["children"][c].asInt(-1);
+                if (child >= 0 && (size_t)child < nodes.size())
+                    isChild[child] = true;
+            }
+        for (size_t i = 0; i < nodes.size(); ++i)
+            if (!isChild[i])
+                visitNode((int)i, glm::mat4(1.0f), 0, groups);
+    }
+
+    void visitNode(int index, const glm::mat4 &parent, int depth, std::map<int, Group> &groups) {
+        const JsonValue &node = m_Json["nodes"][(size_t)index];
+        if (index < 0 || !node.isObject() || depth > MAX_NODE_DEPTH)
+            return;
+        glm::mat4 world = parent * nodeMatrix(node);
+        if (node.has("mesh")) {
+            const JsonValue &primitives = m_Json["meshes"][(size_t)node["mesh"].asInt(-1)]["primitives"];
+            for (size_t p = 0; p < primitives.size(); ++p)
+                addPrimitive(primitives[p], world, groups[primitives[p]["material"].asInt(-1)]);
+        }
+        for (size_t c = 0; c < node["children"].size(); ++c)
+            visitNode(node["children"][c].asInt(-1), world, depth + 1, groups);
+    }
+
+    static bool isFloat(const Accessor &a, int components) {
+        return a.componentType == GL_FLOAT && a.components == components;
+    }
+
+    void addPrimitive(const JsonValue &primitive, const glm::mat4 &world, Group &group) {
+        if (primitive["mode"].asInt(4) != 4) {
+            std::cout << "ERROR::GLTF::PRIMITIVE_MODE_NOT_SUPPORTED " << primitive["mode"].asInt() << std::endl;
+            return;
+        }
+        const JsonValue &attributes = primitive["attributes"];
+        Accessor position, normal, texCoords, tangent, indices;
+        if (!accessor(attributes["POSITION"].asInt(-1), position) || !isFloat(position, 3)) {
+            std::cout << "ERROR::GLTF::PRIMITIVE_WITHOUT_POSITIONS" << std::endl;
+            return;
+        }
+        bool hasNormal = accessor(attributes["NORMAL"].asInt(-1), normal) && isFloat(normal, 3);
+        bool hasTexCoords = accessor(attributes["TEXCOORD_0"].asInt(-1), texCoords) && texCoords.components == 2;
+        bool hasTangent = accessor(attributes["TANGENT"].asInt(-1), tangent) && isFloat(tangent, 4);
+        bool hasIndices = primitive.has("indices");
+        if (hasIndices && (!accessor(primitive["indices"].asInt(-1), indices) || indices.components != 1 ||
+                           indices.componentType == GL_FLOAT || indices.stride != (size_t)componentSize(indices.componentType))) {
+            std::cout << "ERROR::GLTF::INVALID_INDICES" << std::endl;
+            return;
+        }
+
+        // In place: every stream already is what the shaders read. Float
+        // streams only, Mesh::getGeometry reads them back as floats. The
+        // indices still get one pass so a bad file cannot read past the
+        // vertex streams.
+        if (hasNormal && hasTexCoords && isFloat(texCoords, 2) && hasTangent && hasIndices && isIdentity(world)) {
+            for (size_t i = 0; i < indices.count; ++i) {
+                if (index(indices, i) >= position.count) {
+                    std::cout << "ERROR::GLTF::INDEX_OUT_OF_RANGE" << std::endl;
+                    return;
+                }
+            }
+            MeshStreams streams;
+            streams.buffer = m_Buffer;
+            streams.position = stream(position);
+            streams.normal = stream(normal);
+            streams.texCoords = stream(texCoords);
+            streams.tangent = stream(tangent);
+            streams.vertexCount = (unsigned int)position.count;
+            streams.indexType = indices.componentType;
+            streams.indexOffset = indices.offset;
+            streams.indexCount = (unsigned int)indices.count;
+            group.meshes.push_back(Mesh(streams));
+            group.bounds.expand(positionBounds(attributes["POSITION"].asInt(), position));
+            return;
+        }
+
+        MeshData mesh;
+        mesh.vertices.resize(position.count);
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+        // Mirroring transforms flip the bitangent
+        glm::vec3 x(world[0]), y(world[1]), z(world[2]);
+        float handedness = glm::dot(glm::cross(x, y), z) < 0.0f ? -1.0f : 1.0f;
+        for (size_t i = 0; i < position.count; ++i) {
+            Vertex &v = mesh.vertices[i];
+            v.Position = glm::vec3(world * glm::vec4(glm::vec3(element(position, i)), 1.0f));
+            v.Normal = hasNormal ? glm::normalize(normalMatrix * glm::vec3(element(normal, i))) : glm::vec3(0.0f);
+            v.TexCoords = glm::vec2(0.0f);
+            if (hasTexCoords) {
+                glm::vec4 uv = element(texCoords, i);
+                v.TexCoords = glm::vec2(uv.x, uv.y);
+            }
+            if (hasTangent) {
+                glm::vec4 t = element(tangent, i);
+                v.Tangent = glm::vec4(glm::normalize(glm::mat3(world) * glm::vec3(t)), t.w * handedness);
+            } else {
+                v.Tangent = glm::vec4(0.0f);
+            }
+            group.bounds.expand(v.Position);
+        }
+        mesh.indices.resize(hasIndices ? indices.count : position.count);
+        for (size_t i = 0; i < mesh.indices.size(); ++i) {
+            mesh.indices[i] = hasIndices ? index(indices, i) : (unsigned int)i;
+            if (mesh.indices[i] >= position.count) {
+                std::cout << "ERROR::GLTF::INDEX_OUT_OF_RANGE" << std::endl;
+                return;
+            }
+        }
+        mesh.indices.resize(mesh.indices.size() - mesh.indices.size() % 3);
+        if (!hasTangent && hasNormal && hasTexCoords)
+            Model::computeTangents(mesh, m_Pool);
+        if (!hasIndices)
+            Model::weldVertices(mesh);
+        group.meshes.push_back(Mesh(mesh.vertices, mesh.indices, vector<Texture>()));
+    }
+
+    static VertexStream stream(const Accessor &a) {
+        VertexStream s = {a.components, a.componentType, (GLboolean)(a.normalized ? GL_TRUE : GL_FALSE),
+                          (GLsizei)a.stride, a.offset};
+        return s;
+    }
+
+    // POSITION must carry min/max in valid files, scan when it does not
+    AABB positionBounds(int index, const Accessor &position) const {
+        const JsonValue &a = m_Json["accessors"][(size_t)index];
+        if (a["min"].size() == 3 && a["max"].size() == 3)
+            return AABB(glm::vec3(a["min"][(size_t)0].asNumber(), a["min"][1].asNumber(), a["min"][2].asNumber()),
+                        glm::vec3(a["max"][(size_t)0].asNumber(), a["max"][1].asNumber(), a["max"][2].asNumber()));
+        AABB bounds;
+        for (size_t i = 0; i < position.count; ++i)
+            bounds.expand(glm::vec3(element(position, i)));
+        return bounds;
+    }
+
+    int textureImage(const JsonValue &textureInfo) const {
+        if (!textureInfo.has("index"))
+            return -1;
+        return m_Json["textures"][(size_t)textureInfo["index"].asInt(-1)]["source"].asInt(-1);
+    }
+
+    // Decodes every image the used materials point at, in parallel
+    void decodeImages(const std::map<int, Group> &groups) {
+        PROFILE_SCOPE("decode glb images");
+        const JsonValue &images = m_Json["images"];
+        m_Images.assign(images.size(), Image{nullptr, 0, 0, 0});
+        std::vector<size_t> needed;
+        std::vector<bool> seen(images.size(), false);
+        for (std::map<int, Group>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+            const JsonValue &material = m_Json["materials"][(size_t)it->first];
+            if (it->first < 0 || it->second.meshes.empty())
+                continue;
+            const JsonValue *infos[4] = {&material["pbrMetallicRoughness"]["baseColorTexture"], &material["normalTexture"],
+                                         &material["pbrMetallicRoughness"]["metallicRoughnessTexture"],
+                                         &material["occlusionTexture"]};
+            for (const JsonValue *info : infos) {
+                int image = textureImage(*info);
+                if (image >= 0 && (size_t)image < images.size() && !seen[image]) {
+                    seen[image] = true;
+                    needed.push_back(image);
+                }
+            }
+        }
+        auto decode = [&](size_t begin, size_t end) {
+            // glTF puts the UV origin at the top-left of the image. Set per
+            // thread, the viewer may be decoding flipped OBJ textures on
+            // other threads at the same time.
+            stbi_set_flip_vertically_on_load_thread(false);
+            for (size_t n = begin; n < end; ++n) {
+                const JsonValue &image = images[needed[n]];
+                Image &out = m_Images[needed[n]];
+                if (image.has("bufferView")) {
+                    const JsonValue &bufferView = m_Json["bufferViews"][(size_t)image["bufferView"].asInt(-1)];
+                    size_t offset = (size_t)bufferView["byteOffset"].asNumber();
+                    size_t length = (size_t)bufferView["byteLength"].asNumber();
+                    if (offset + length <= m_BinSize)
+                        out.pixels = stbi_load_from_memory((const stbi_uc *)m_Bin + offset, (int)length, &out.width,
+                                                           &out.height, &out.channels, 0);
+                } else if (image.has("uri") && image["uri"].asString().compare(0, 5, "data:") != 0) {
+                    std::string file = m_Directory + "/" + image["uri"].asString();
+                    out.pixels = stbi_load(file.c_str(), &out.width, &out.height, &out.channels, 0);
+                }
+                if (!out.pixels)
+                    std::cout << "ERROR::GLTF::IMAGE_NOT_DECODED " << needed[n] << std::endl;
+            }
+        };
+        if (m_Pool)
+            m_Pool->parallelFor(0, needed.size(), 1, decode);
+        else
+            decode(0, needed.size());
+    }
+
+    // channel -1 keeps the image as is, 1/2 reads green/blue through red
+    // (metallic and roughness share one glTF texture). factor scales the
+    // texels since the shaders have no material constants.
+    unsigned int texture(int imageIndex, int channel, const glm::vec4 &factor) {
+        const Image *image = imageIndex >= 0 && (size_t)imageIndex < m_Images.size() && m_Images[imageIndex].pixels
+                                 ? &m_Images[imageIndex]
+                                 : nullptr;
+        if (!image)
+            return 0;
+        if (image->channels < 3)
+            channel = -1;
+        std::string key = std::to_string(imageIndex) + ":" + std::to_string(channel) + ":" + std::to_string(factor.x) +
+                          "," + std::to_string(factor.y) + "," + std::to_string(factor.z);
+        std::map<std::string, unsigned int>::iterator cached = m_Textures.find(key);
+        if (cached != m_Textures.end())
+            return cached->second;
+
+        const unsigned char *pixels = image->pixels;
+        std::vector<unsigned char> scaled;
+        if (factor.x != 1.0f || factor.y != 1.0f || factor.z != 1.0f) {
+            size_t texels = (size_t)image->width * image->height;
+            scaled.assign(pixels, pixels + texels * image->channels);
+            for (size_t i = 0; i < texels; ++i)
+                for (int c = 0; c < std::min(image->channels, 3); ++c)
+                    scaled[i * image->channels + c] =
+                        (unsigned char)std::min(scaled[i * image->channels + c] * factor[c] + 0.5f, 255.0f);
+            pixels = scaled.data();
+        }
+        GLenum format = image->channels == 1 ? GL_RED : image->channels == 2 ? GL_RG : image->channels == 3 ? GL_RGB : GL_RGBA;
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (channel == 1)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_GREEN);
+        else if (channel == 2)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+        m_Textures[key] = id;
+        return id;
+    }
+
+    // 1x1 texture for a constant material value
+    static unsigned int solid(const glm::vec4 &value) {
+        unsigned char texel[4];
+        for (int c = 0; c < 4; ++c)
+            texel[c] = (unsigned char)(glm::clamp(value[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return id;
+    }
+
+    // glTF metallic-roughness onto the viewer's five maps. The albedo
+    // map is sRGB and the shaders square it by 2.2, so the linear base
+    // color factor goes in as factor^(1/2.2).
+    Material makeMaterial(int index) {
+        const JsonValue &material = m_Json["materials"][(size_t)index];
+        const JsonValue &pbr = material["pbrMetallicRoughness"];
+        const JsonValue &baseColor = pbr["baseColorFactor"];
+        glm::vec4 baseFactor(1.0f);
+        for (size_t c = 0; c < 4 && c < baseColor.size(); ++c)
+            baseFactor[(int)c] = (float)baseColor[c].asNumber(1.0);
+        glm::vec4 albedoFactor(std::pow(baseFactor.x, 1.0f / 2.2f), std::pow(baseFactor.y, 1.0f / 2.2f),
+                               std::pow(baseFactor.z, 1.0f / 2.2f), baseFactor.w);
+        float metallic = (float)pbr["metallicFactor"].asNumber(1.0);
+        float roughness = (float)pbr["roughnessFactor"].asNumber(1.0);
+        int metallicRoughness = textureImage(pbr["metallicRoughnessTexture"]);
+
+        Material result;
+        result.albedo = texture(textureImage(pbr["baseColorTexture"]), -1, glm::vec4(glm::vec3(albedoFactor), 1.0f));
+        if (!result.albedo)
+            result.albedo = solid(albedoFactor);
+        result.normal = texture(textureImage(material["normalTexture"]), -1, glm::vec4(1.0f));
+        if (!result.normal)
+            result.normal = solid(glm::vec4(0.5f, 0.5f, 1.0f, 1.0f));
+        result.metallic = texture(metallicRoughness, 2, glm::vec4(1.0f, 1.0f, metallic, 1.0f));
+        if (!result.metallic)
+            result.metallic = solid(glm::vec4(metallic));
+        result.roughness = texture(metallicRoughness, 1, glm::vec4(1.0f, roughness, 1.0f, 1.0f));
+        if (!result.roughness)
+            result.roughness = solid(glm::vec4(roughness));
+        result.ao = texture(textureImage(material["occlusionTexture"]), -1, glm::vec4(1.0f));
+        if (!result.ao)
+            result.ao = solid(glm::vec4(1.0f));
+        return result;
+    }
+};
+
+#endif
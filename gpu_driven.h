@@ -0,0 +1,345 @@
+#ifndef GPU_DRIVEN_H
+#define GPU_DRIVEN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "bounds.h"
+#include "geometry_buffer.h"
+#include "gl_ext.h"
+#include "material_pool.h"
+#include "render_stats.h"
+#include "scene_objects.h"
+#include "shader.h"
+
+// GPU-driven submission (needs GL 4.3, see gl_ext.h). Object transforms
+// and bounds live in a shader storage buffer and every (object, mesh) pair
+// has a fixed DrawElementsIndirectCommand. Each frame a compute shader
+// culls the commands against the frustum and against a Hi-Z pyramid built
+// from last frame's depth, and the scene is drawn from the merged
+// geometry buffer with one glMultiDrawElementsIndirect per material.
+//
+// The CPU work per frame is a dispatch plus one draw per material, no
+// matter how many objects there are. Only objects that moved are
+// re-uploaded. With material pooling on, materials that fit a texture
+// array pool (see material_pool.h) share one draw per pool instead.
+class GpuDrivenRenderer {
+public:
+    static const int OBJECT_BINDING = 0;
+    static const int COMMAND_BINDING = 1;
+    static const int PYRAMID_UNIT = 10;
+
+    // Draw programs matching pbrShader, gBufferShader and the pre-pass
+    Shader forwardShader;
+    Shader gBufferShader;
+    Shader prepassShader;
+
+    static bool isSupported() { return hasGL43(); }
+
+    GpuDrivenRenderer(const Scene &scene, int width, int height)
+        : forwardShader("shaders/pbr_indirect.vs", "shaders/pbr.fs", "#define MATERIAL_ARRAYS\n"),
+          gBufferShader("shaders/pbr_indirect.vs", "shaders/gbuffer.fs", "#define MATERIAL_ARRAYS\n"),
+          prepassShader("shaders/pbr_indirect.vs", "shaders/shadow_depth.fs"),
+          m_CullShader("shaders/gpu_cull.comp"), m_DownsampleShader("shaders/hiz_downsample.comp"),
+          m_ObjectCount(0), m_Invalid(false), m_MaterialsInvalid(false), m_Pooling(false), m_UploadedRanges(0),
+          m_UploadedDraws(0), m_OcclusionCulling(true), m_HasPyramid(false), m_Width(0), m_Height(0),
+          m_Pyramid(0) {
+        glGenBuffers(1, &m_ObjectBuffer);
+        glGenBuffers(1, &m_CommandBuffer);
+        build(scene);
+        resize(width, height);
+    }
+
+    ~GpuDrivenRenderer() {
+        glDeleteBuffers(1, &m_ObjectBuffer);
+        glDeleteBuffers(1, &m_CommandBuffer);
+        glDeleteTextures(1, &m_Pyramid);
+    }
+
+    unsigned int getCommandCount() const { return (unsigned int)m_Commands.size(); }
+    unsigned int getBatchCount() const { return (unsigned int)m_Batches.size(); }
+    int getPoolCount() const { return m_Pools.getPoolCount(); }
+
+    void setOcclusionCulling(bool enabled) { m_OcclusionCulling = enabled; }
+
+    // Texture array pools cost a second copy of the pooled maps, so they
+    // only exist while this is on
+    void setMaterialPooling(bool enabled) {
+        if (enabled == m_Pooling)
+            return;
+        m_Pooling = enabled;
+        m_MaterialsInvalid = true;
+        if (!enabled)
+            m_Pools.clear();
+    }
+
+    void setPoolFilter(const std::function<bool(unsigned int)> &filter) { m_Pools.setFilter(filter); }
+
+    // A material map was respecified (a streamed texture came in), its
+    // pool copy is refreshed by the next update()
+    void textureChanged(unsigned int textureID) {
+        if (!m_Pooling)
+            return;
+        m_Pools.textureChanged(textureID);
+        m_MaterialsInvalid = true;
+    }
+
+    // An object's model was replaced (a streamed asset swapped in for
+    // its proxy), the next update() rebuilds the geometry. The old model
+    // is gone and a new one may have its address, so nothing is reused.
+    void invalidate() {
+        m_Invalid = true;
+        m_Geometry.clear();
+        m_UploadedRanges = 0;
+    }
+
+    // Rebuilds everything when objects were added or a model or material
+    // changed, otherwise re-uploads the ones Scene::update() moved
+    void update(const Scene &scene) {
+        if (m_Invalid || m_MaterialsInvalid || scene.objects.size() != m_ObjectCount) {
+            build(scene);
+            return;
+        }
+        const std::vector<int> &moved = scene.getMovedObjects();
+        if (moved.empty())
+            return;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ObjectBuffer);
+        for (int i : moved) {
+            GpuObject object = toGpu(scene.objects[i], i);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, i * sizeof(GpuObject), sizeof(GpuObject), &object);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void resize(int width, int height) {
+        if (width == m_Width && height == m_Height)
+            return;
+        m_Width = width;
+        m_Height = height;
+        m_HasPyramid = false;
+        glDeleteTextures(1, &m_Pyramid);
+
+        // Pyramid starts at half resolution, every level fully allocated
+        // so the texture is complete for texelFetch
+        m_PyramidWidth = std::max(1, width / 2);
+        m_PyramidHeight = std::max(1, height / 2);
+        m_PyramidLevels = 1 + (int)std::floor(std::log2((float)std::max(m_PyramidWidth, m_PyramidHeight)));
+        glGenTextures(1, &m_Pyramid);
+        glBindTexture(GL_TEXTURE_2D, m_Pyramid);
+        for (int level = 0; level < m_PyramidLevels; ++level)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, m_PyramidWidth >> level),
+                         std::max(1, m_PyramidHeight >> level), 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_PyramidLevels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Writes this frame's instance counts into the command buffer
+    void cull(const glm::mat4 &viewProjection) {
+        Frustum frustum(viewProjection);
+        m_CullShader.use();
+        glUniform1ui(glGetUniformLocation(m_CullShader.ID, "commandCount"), (GLuint)m_Commands.size());
+        glUniform4fv(glGetUniformLocation(m_CullShader.ID, "frustumPlanes"), 6, &frustum.planes[0][0]);
+        m_CullShader.setBool("occlusionCulling", m_OcclusionCulling && m_HasPyramid);
+        m_CullShader.setInt("depthPyramid", PYRAMID_UNIT);
+        glUniform2i(glGetUniformLocation(m_CullShader.ID, "pyramidSize"), m_PyramidWidth, m_PyramidHeight);
+        m_CullShader.setInt("pyramidLevels", m_PyramidLevels);
+        m_CullShader.setMat4("previousViewProjection", m_PyramidViewProjection);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+        glBindTexture(GL_TEXTURE_2D, m_Pyramid);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, m_ObjectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_CommandBuffer);
+        glDispatchCompute(((GLuint)m_Commands.size() + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        m_ViewProjection = viewProjection;
+    }
+
+    // Draws the culled commands with the given program (one of the three
+    // above). Material textures go to units 0-4 unless bindMaterials is
+    // false (depth-only passes).
+    void draw(Shader &shader, bool bindMaterials = true) {
+        shader.use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, m_ObjectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+        glBindVertexArray(m_Geometry.VAO);
+        for (const Batch &batch : m_Batches) {
+            if (bindMaterials && batch.pool >= 0) {
+                m_Pools.bind(batch.pool);
+            } else if (bindMaterials) {
+                unsigned int textures[5] = {batch.material.albedo, batch.material.normal, batch.material.metallic,
+                                            batch.material.roughness, batch.material.ao};
+                for (int t = 0; t < 5; ++t) {
+                    glActiveTexture(GL_TEXTURE0 + t);
+                    glBindTexture(GL_TEXTURE_2D, textures[t]);
+                }
+            }
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        (void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                        batch.commandCount, 0);
+            renderStats().addDraw(batch.triangles);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // Builds the Hi-Z pyramid from this frame's depth texture (width x
+    // height as passed to resize()) for next frame's occlusion test
+    void buildDepthPyramid(unsigned int depthTexture) {
+        m_DownsampleShader.use();
+        m_DownsampleShader.setInt("source", PYRAMID_UNIT);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+        for (int level = 0; level < m_PyramidLevels; ++level) {
+            glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : m_Pyramid);
+            m_DownsampleShader.setInt("sourceLevel", level == 0 ? 0 : level - 1);
+            glBindImageTexture(0, m_Pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            int w = std::max(1, m_PyramidWidth >> level);
+            int h = std::max(1, m_PyramidHeight >> level);
+            glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        m_PyramidViewProjection = m_ViewProjection;
+        m_HasPyramid = true;
+    }
+
+private:
+    // std430 layout shared with gpu_cull.comp and pbr_indirect.vs
+    struct GpuObject {
+        glm::mat4 model;
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        GLint material[4]; // texture array layer, 3 unused
+    };
+
+    // One material, or every material in one pool
+    struct Batch {
+        int pool;
+        Material material;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+        size_t triangles;
+    };
+
+    Shader m_CullShader;
+    Shader m_DownsampleShader;
+    GeometryBuffer m_Geometry;
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+    std::vector<Batch> m_Batches;
+    size_t m_ObjectCount;
+    bool m_Invalid;
+    bool m_MaterialsInvalid;
+    bool m_Pooling;
+    MaterialPools m_Pools;
+    std::vector<MaterialPools::Slot> m_Slots; // per object
+    size_t m_UploadedRanges;
+    size_t m_UploadedDraws;
+    unsigned int m_ObjectBuffer, m_CommandBuffer;
+
+    bool m_OcclusionCulling;
+    bool m_HasPyramid;
+    glm::mat4 m_ViewProjection;
+    glm::mat4 m_PyramidViewProjection;
+    int m_Width, m_Height;
+    int m_PyramidWidth, m_PyramidHeight, m_PyramidLevels;
+    unsigned int m_Pyramid;
+
+    GpuObject toGpu(const SceneObject &object, size_t index) const {
+        GpuObject gpu;
+        gpu.model = object.getModelMatrix();
+        gpu.boundsMin = glm::vec4(object.worldBounds.min, 1.0f);
+        gpu.boundsMax = glm::vec4(object.worldBounds.max, 1.0f);
+        gpu.material[0] = m_Slots[index].layer;
+        gpu.material[1] = gpu.material[2] = gpu.material[3] = 0;
+        return gpu;
+    }
+
+    void build(const Scene &scene) {
+        m_ObjectCount = scene.objects.size();
+        m_Invalid = false;
+        m_MaterialsInvalid = false;
+        m_HasPyramid = false;
+
+        m_Slots.assign(m_ObjectCount, MaterialPools::Slot{-1, -1});
+        if (m_Pooling) {
+            std::vector<Material> materials;
+            for (const SceneObject &object : scene.objects)
+                materials.push_back(object.material);
+            m_Pools.update(materials);
+            for (size_t i = 0; i < m_ObjectCount; ++i)
+                m_Slots[i] = m_Pools.find(scene.objects[i].material);
+        }
+
+        // Objects sorted by pool, the unpooled ones by material, so each
+        // pool or material is one command range
+        std::vector<int> order(m_ObjectCount);
+        for (size_t i = 0; i < m_ObjectCount; ++i)
+            order[i] = (int)i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            if (m_Slots[a].pool != m_Slots[b].pool)
+                return m_Slots[a].pool < m_Slots[b].pool;
+            if (m_Slots[a].pool >= 0)
+                return false;
+            const Material &ma = scene.objects[a].material;
+            const Material &mb = scene.objects[b].material;
+            if (ma.albedo != mb.albedo)
+                return ma.albedo < mb.albedo;
+            if (ma.normal != mb.normal)
+                return ma.normal < mb.normal;
+            if (ma.metallic != mb.metallic)
+                return ma.metallic < mb.metallic;
+            if (ma.roughness != mb.roughness)
+                return ma.roughness < mb.roughness;
+            return ma.ao < mb.ao;
+        });
+
+        m_Commands.clear();
+        m_Batches.clear();
+        for (int i : order) {
+            const SceneObject &object = scene.objects[i];
+            int pool = m_Slots[i].pool;
+            if (m_Batches.empty() || m_Batches.back().pool != pool ||
+                (pool < 0 && !MaterialPools::sameMaterial(m_Batches.back().material, object.material)))
+                m_Batches.push_back(Batch{pool, object.material, (unsigned int)m_Commands.size(), 0, 0});
+            size_t firstRange = m_Geometry.add(object.model);
+            for (size_t m = 0; m < object.model->meshes.size(); ++m) {
+                const MeshRange &range = m_Geometry.getRange(firstRange + m);
+                DrawElementsIndirectCommand command;
+                command.count = range.indexCount;
+                command.instanceCount = 1;
+                command.firstIndex = range.firstIndex;
+                command.baseVertex = range.baseVertex;
+                command.baseInstance = (GLuint)i;
+                m_Commands.push_back(command);
+                m_Batches.back().commandCount++;
+                m_Batches.back().triangles += range.indexCount / 3;
+            }
+        }
+        // Models already added keep their ranges, only new geometry or
+        // more draw ids need an upload
+        size_t draws = std::max<size_t>(m_ObjectCount, 1);
+        if (m_Geometry.getRangeCount() != m_UploadedRanges || draws != m_UploadedDraws || !m_Geometry.VAO) {
+            m_Geometry.upload((unsigned int)draws);
+            m_UploadedRanges = m_Geometry.getRangeCount();
+            m_UploadedDraws = draws;
+        }
+
+        std::vector<GpuObject> objects(m_ObjectCount);
+        for (size_t i = 0; i < m_ObjectCount; ++i)
+            objects[i] = toGpu(scene.objects[i], i);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ObjectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(GpuObject), objects.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand),
+                     m_Commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GL context without a window or display, through EGL. Prefers Mesa's
+// surfaceless platform (works on llvmpipe and render nodes), then the
+// first EGL device, then the default display. Frames go to an offscreen
+// framebuffer that stands in for the window and can be written to disk.
+class HeadlessContext {
+public:
+    unsigned int framebuffer;
+    unsigned int colorTexture;
+
+    HeadlessContext()
+        : framebuffer(0), colorTexture(0), m_DepthBuffer(0), m_Display(EGL_NO_DISPLAY), m_Context(EGL_NO_CONTEXT),
+          m_Surface(EGL_NO_SURFACE), m_Width(0), m_Height(0) {}
+
+    ~HeadlessContext() {
+        if (framebuffer) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &colorTexture);
+            glDeleteRenderbuffers(1, &m_DepthBuffer);
+        }
+        if (m_Display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_Context != EGL_NO_CONTEXT)
+            eglDestroyContext(m_Display, m_Context);
+        if (m_Surface != EGL_NO_SURFACE)
+            eglDestroySurface(m_Display, m_Surface);
+        eglTerminate(m_Display);
+    }
+
+    // Same versions the window asks for: 4.3 core, else 3.3 core
+    bool create(int width, int height) {
+        m_Width = width;
+        m_Height = height;
+        if (!openDisplay()) {
+            std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        EGLConfig config = nullptr;
+        bool noConfig = hasExtension(m_Display, "EGL_KHR_no_config_context");
+        if (!noConfig) {
+            EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                      EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_NONE};
+            EGLint count = 0;
+            if (!eglChooseConfig(m_Display, configAttribs, &config, 1, &count) || count == 0) {
+                std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+                return false;
+            }
+        }
+
+        const EGLint versions[2][2] = {{4, 3}, {3, 3}};
+        for (const EGLint *version : versions) {
+            EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, version[0], EGL_CONTEXT_MINOR_VERSION, version[1],
+                                       EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                       EGL_NONE};
+            m_Context = eglCreateContext(m_Display, noConfig ? EGL_NO_CONFIG_KHR : config, EGL_NO_CONTEXT,
+                                         contextAttribs);
+            if (m_Context != EGL_NO_CONTEXT)
+                break;
+        }
+        if (m_Context == EGL_NO_CONTEXT) {
+            std::cout << "ERROR::HEADLESS::NO_GL_3_3_CONTEXT" << std::endl;
+            return false;
+        }
+
+        // Without surfaceless contexts a tiny pbuffer keeps eglMakeCurrent
+        // happy, rendering still goes to our framebuffer
+        if (!hasExtension(m_Display, "EGL_KHR_surfaceless_context") && config) {
+            EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            m_Surface = eglCreatePbufferSurface(m_Display, config, pbufferAttribs);
+        }
+        if (!eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context)) {
+            std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static void *getProcAddress(const char *name) { return (void *)eglGetProcAddress(name); }
+
+    // Call after glad is loaded. Colour + depth/stencil like the window's
+    // default framebuffer.
+    void createFramebuffer() {
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &m_DepthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_DepthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Binary PPM, top row first. Needs no image library and compares
+    // byte for byte in regression tests.
+    bool writeFrame(const std::string &path) const {
+        std::vector<unsigned char> pixels((size_t)m_Width * m_Height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, m_Width, m_Height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        std::ofstream out(path.c_str(), std::ios::binary);
+        if (!out) {
+            std::cout << "ERROR::HEADLESS::FRAME_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        out << "P6\n" << m_Width << " " << m_Height << "\n255\n";
+        size_t rowSize = (size_t)m_Width * 3;
+        for (int y = m_Height - 1; y >= 0; --y)
+            out.write((const char *)&pixels[y * rowSize], rowSize);
+        return true;
+    }
+
+    int getWidth() const { return m_Width; }
+    int getHeight() const { return m_Height; }
+
+private:
+    unsigned int m_DepthBuffer;
+    EGLDisplay m_Display;
+    EGLContext m_Context;
+    EGLSurface m_Surface;
+    int m_Width, m_Height;
+
+    static bool hasExtension(EGLDisplay display, const char *name) {
+        const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!extensions)
+            return false;
+        size_t length = std::strlen(name);
+        for (const char *p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+                return true;
+        return false;
+    }
+
+    bool openDisplay() {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        EGLint major, minor;
+        if (getPlatformDisplay && hasExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+            m_Display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, &major, &minor))
+                return true;
+        }
+        PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        if (getPlatformDisplay && queryDevices && hasExtension(EGL_NO_DISPLAY, "EGL_EXT_platform_device")) {
+            EGLDeviceEXT device;
+            EGLint count = 0;
+            if (queryDevices(1, &device, &count) && count > 0) {
+                m_Display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+                if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, &major, &minor))
+                    return true;
+            }
+        }
+        m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, &major, &minor))
+            return true;
+        m_Display = EGL_NO_DISPLAY;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small DOM JSON reader, enough for asset manifests like the glTF JSON
+// chunk. Missing keys and out of range indices read as a null value, so
+// lookups can be chained without checks.
+class JsonValue {
+public:
+    enum Type {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    JsonValue() : m_Type(JSON_NULL), m_Bool(false), m_Number(0.0) {}
+
+    Type type() const { return m_Type; }
+    bool isNull() const { return m_Type == JSON_NULL; }
+    bool isNumber() const { return m_Type == JSON_NUMBER; }
+    bool isArray() const { return m_Type == JSON_ARRAY; }
+    bool isObject() const { return m_Type == JSON_OBJECT; }
+
+    bool asBool(bool fallback = false) const { return m_Type == JSON_BOOL ? m_Bool : fallback; }
+    double asNumber(double fallback = 0.0) const { return m_Type == JSON_NUMBER ? m_Number : fallback; }
+    int asInt(int fallback = 0) const { return m_Type == JSON_NUMBER ? (int)m_Number : fallback; }
+    const std::string &asString() const { return m_String; }
+
+    // Elements of an array, members of an object
+    size_t size() const { return m_Type == JSON_ARRAY ? m_Array.size() : m_Members.size(); }
+
+    const JsonValue &operator[](size_t index) const {
+        return m_Type == JSON_ARRAY && index < m_Array.size() ? m_Array[index] : null();
+    }
+
+    const JsonValue &operator[](const char *key) const {
+        if (m_Type == JSON_OBJECT)
+            for (const std::pair<std::string, JsonValue> &member : m_Members)
+                if (member.first == key)
+                    return member.second;
+        return null();
+    }
+
+    bool has(const char *key) const { return !(*this)[key].isNull(); }
+
+    const std::vector<std::pair<std::string, JsonValue>> &members() const { return m_Members; }
+
+    // Whole document; on failure error says what and where
+    static bool parse(const char *begin, const char *end, JsonValue &out, std::string &error) {
+        Parser parser{begin, begin, end, std::string()};
+        parser.skipSpace();
+        if (!parser.value(out, 0)) {
+            error = parser.error;
+            return false;
+        }
+        parser.skipSpace();
+        if (parser.at != end) {
+            parser.fail("trailing characters");
+            error = parser.error;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Type m_Type;
+    bool m_Bool;
+    double m_Number;
+    std::string m_String;
+    std::vector<JsonValue> m_Array;
+    std::vector<std::pair<std::string, JsonValue>> m_Members;
+
+    static const JsonValue &null() {
+        static const JsonValue value;
+        return value;
+    }
+
+    struct Parser {
+        const char *begin, *at, *end;
+        std::string error;
+
+        static const int MAX_DEPTH = 256;
+
+        bool fail(const char *what) {
+            if (error.empty())
+                error = std::string(what) + " at byte " + std::to_string(at - begin);
+            return false;
+        }
+
+        void skipSpace() {
+            while (at < end && (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r'))
+                ++at;
+        }
+
+        bool literal(const char *text) {
+            size_t length = std::strlen(text);
+            if ((size_t)(end - at) < length || std::strncmp(at, text, length) != 0)
+                return fail("invalid literal");
+            at += length;
+            return true;
+        }
+
+        bool value(JsonValue &out, int depth) {
+            if (depth > MAX_DEPTH)
+                return fail("nesting too deep");
+            if (at >= end)
+                return fail("unexpected end");
+            switch (*at) {
+            case '{': return object(out, depth);
+            case '[': return array(out, depth);
+            case '"':
+                out.m_Type = JSON_STRING;
+                return string(out.m_String);
+            case 't':
+                out.m_Type = JSON_BOOL;
+                out.m_Bool = true;
+                return literal("true");
+            case 'f':
+                out.m_Type = JSON_BOOL;
+                out.m_Bool = false;
+                return literal("false");
+            case 'n':
+                out.m_Type = JSON_NULL;
+                return literal("null");
+            default: return number(out);
+            }
+        }
+
+        bool number(JsonValue &out) {
+            // strtod needs a terminator, numbers are short
+            char buffer[64];
+            size_t length = 0;
+            while (at + length < end && length < sizeof(buffer) - 1 && std::strchr("+-0123456789.eE", at[length]))
+                ++length;
+            if (length == 0)
+                return fail("unexpected character");
+            std::memcpy(buffer, at, length);
+            buffer[length] = '\0';
+            char *parsedEnd = nullptr;
+            out.m_Type = JSON_NUMBER;
+            out.m_Number = std::strtod(buffer, &parsedEnd);
+            if (parsedEnd != buffer + length)
+                return fail("invalid number");
+            at += length;
+            return true;
+        }
+
+        static void appendUtf8(std::string &out, unsigned int code) {
+            if (code < 0x80) {
+                out += (char)code;
+            } else if (code < 0x800) {
+                out += (char)(0xC0 | (code >> 6));
+                out += (char)(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                out += (char)(0xE0 | (code >> 12));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            } else {
+                out += (char)(0xF0 | (code >> 18));
+                out += (char)(0x80 | ((code >> 12) & 0x3F));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool hex4(unsigned int &code) {
+            if (end - at < 4)
+                return fail("truncated escape");
+            code = 0;
+            for (int i = 0; i < 4; ++i, ++at) {
+                char c = *at;
+                code <<= 4;
+                if (c >= '0' && c <= '9')
+                    code |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    code |= c - 'A' + 10;
+                else
+                    return fail("invalid escape");
+            }
+            return true;
+        }
+
+        bool string(std::string &out) {
+            ++at; // opening quote
+            out.clear();
+            while (at < end && *at != '"') {
+                if (*at != '\\') {
+                    out += *at++;
+                    continue;
+                }
+                if (++at >= end)
+                    break;
+                char c = *at++;
+                switch (c) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned int code = 0;
+                    if (!hex4(code))
+                        return false;
+                    // Surrogate pair, the high half must be followed by a low one
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        if (end - at < 6 || at[0] != '\\' || at[1] != 'u')
+                            return fail("unpaired surrogate");
+                        at += 2;
+                        unsigned int low = 0;
+                        if (!hex4(low))
+                            return false;
+                        if (low < 0xDC00 || low > 0xDFFF)
+                            return fail("unpaired surrogate");
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: return fail("invalid escape");
+                }
+            }
+            if (at >= end)
+                return fail("unterminated string");
+            ++at; // closing quote
+            return true;
+        }
+
+        bool array(JsonValue &out, int depth) {
+            out.m_Type = JSON_ARRAY;
+            ++at;
+            skipSpace();
+            if (at < end && *at == ']') {
+                ++at;
+                return true;
+            }
+            while (true) {
+                out.m_Array.push_back(JsonValue());
+                skipSpace();
+                if (!value(out.m_Array.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (at < end && *at == ',') {
+                    ++at;
+                    continue;
+                }
+                if (at < end && *at == ']') {
+                    ++at;
+                    return true;
+                }
+                return fail("expected , or ]");
+            }
+        }
+
+        bool object(JsonValue &out, int depth) {
+            out.m_Type = JSON_OBJECT;
+            ++at;
+            skipSpace();
+            if (at < end && *at == '}') {
+                ++at;
+                return true;
+            }
+            while (true) {
+                skipSpace();
+                if (at >= end || *at != '"')
+                    return fail("expected key");
+                out.m_Members.push_back(std::make_pair(std::string(), JsonValue()));
+                if (!string(out.m_Members.back().first))
+                    return false;
+                skipSpace();
+                if (at >= end || *at != ':')
+                    return fail("expected :");
+                ++at;
+                skipSpace();
+                if (!value(out.m_Members.back().second, depth + 1))
+                    return false;
+                skipSpace();
+                if (at < end && *at == ',') {
+                    ++at;
+                    continue;
+                }
+                if (at < end && *at == '}') {
+                    ++at;
+                    return true;
+                }
+                return fail("expected , or }");
+            }
+        }
+    };
+};
+
+#endif
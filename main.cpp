@@ -1,24 +1,64 @@
+#include "asset_pack.h"
+#include "asset_streamer.h"
+#include "benchmark.h"
 #include "camera.h"
+#include "camera_path.h"
+#include "cascaded_shadows.h"
+#include "clustered_lighting.h"
+#include "cooked_asset.h"
+#include "dynamic_resolution.h"
+#include "frame_uniforms.h"
+#include "gbuffer.h"
+#include "gl_ext.h"
+#include "gltf_loader.h"
+#include "gpu_driven.h"
 #include "model.h"
+#include "occlusion_culler.h"
+#include "overdraw_counter.h"
+#include "profiler.h"
+#include "render_graph.h"
+#include "render_stats.h"
 #include "scene_manager.h"
+#include "scene_objects.h"
 #include "shader.h"
+#include "software_renderer.h"
+#include "stream_buffer.h"
 #include "test_callback.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#ifndef NO_GLFW
 #include <GLFW/glfw3.h>
+#endif
+#ifdef HEADLESS_EGL
+#include "headless_context.h"
+#endif
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
 // #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#define GL_EXT_IMPLEMENTATION
+#include "gl_ext.h"
 
+#ifndef NO_GLFW
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(const char *path);
+#endif
 
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
@@ -27,42 +67,358 @@ Camera camera(glm::vec3(0.0f, 2.0f, 10.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool pickRequested = false;
+
+// Depth pre-pass, toggled with P
+bool depthPrepass = false;
+bool prepassKeyDown = false;
+
+// Field of small demo lights for the clustered path, toggled with L
+const int DEMO_LIGHT_COUNT = 256;
+bool demoLights = false;
+bool demoLightsKeyDown = false;
+
+// Deferred shading instead of forward PBR, toggled with G
+bool deferredShading = false;
+bool deferredKeyDown = false;
+
+// CPU occlusion culling against the big occluders, toggled with O
+bool occlusionCulling = true;
+bool occlusionKeyDown = false;
+
+// GPU culling + multi-draw indirect (GL 4.3 only), toggled with I
+bool gpuDrivenSubmission = false;
+bool gpuDrivenKeyDown = false;
+bool gpuDrivenSupported = false;
+
+// Main pass resolution follows the GPU frame time (R toggles, U switches
+// bilinear / edge-aware upscale, H prints the controller history)
+const float DYNRES_TARGET_MS = 16.0f;
+const float DYNRES_MIN_SCALE = 0.5f;
+const float DYNRES_MAX_SCALE = 1.0f;
+bool dynamicResolution = true;
+bool dynamicResolutionKeyDown = false;
+bool edgeAwareUpscale = true;
+bool upscaleKeyDown = false;
+bool historyRequested = false;
+bool historyKeyDown = false;
+
+// T records the next frames as a Chrome trace
+const int TRACE_FRAMES = 120;
+const char *TRACE_PATH = "profile_trace.json";
+bool traceKeyDown = false;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// Shadow map dimensions
-const unsigned int shadow_dim{1024};
-const unsigned int SHADOW_WIDTH = shadow_dim, SHADOW_HEIGHT = shadow_dim;
-unsigned int depthMapFBO;
-unsigned int depthMap;
+// --headless renders a fixed number of frames offscreen (no window or
+// display needed), stepping time by FIXED_FRAME_TIME so runs are
+// reproducible, and --output writes each one as <prefix>NNNN.ppm
+const float FIXED_FRAME_TIME = 1.0f / 60.0f;
+bool headless = false;
+int headlessFrames = 60;
+std::string headlessOutput;
+
+// --benchmark flies the camera along a scripted path (--path file, else
+// CameraPath::demo()) at FIXED_FRAME_TIME steps and reports frame time
+// statistics after --warmup + --frames frames
+bool benchmarkMode = false;
+Benchmark::Settings benchmarkSettings = {60, 600, "benchmark.csv",
+                                         "benchmark.json"};
+std::string benchmarkPathFile;
+
+// --software renders the same frames on the CPU (SoftwareRenderer), no
+// GL context at all
+bool softwareRendering = false;
+
+// --glb adds the parts of a glTF binary next to the table (GL path only)
+std::string glbFile;
+
+// --cooked <dir> loads meshes and textures written by pbr_cook from dir
+// when there is a cooked file for them. Stale files are not detected
+// here, rerun pbr_cook (it only redoes what changed).
+std::string cookedDir;
+
+// --pack <file> maps a pbr_pack archive. Shaders, models and textures it
+// holds (cooked ones too) are read from it, anything else from disk.
+std::string packFile;
+
+// Assets stream in behind placeholders (1x1 textures, bounding box
+// proxies) so the first frame doesn't wait for the whole scene; each
+// frame spends up to STREAM_BUDGET_MS swapping loaded ones in. On by
+// default in the window. Headless and benchmark runs load everything
+// before the first frame so their output doesn't depend on load timing,
+// --stream makes them stream too.
+const float STREAM_BUDGET_MS = 4.0f;
+bool forceStreaming = false;
+// While streaming, cooked material maps start at their small mips and
+// load finer ones as the camera gets close (TextureStreamer).
+// --texture-budget <MB> caps the estimated VRAM they take.
+size_t textureBudgetMB = 512;
+// --animate bobs the cup over the table (GL path only). It is marked
+// dynamic, so its shadow is drawn over the cached static layers each
+// frame instead of invalidating them.
+bool animateScene = false;
+const int ANIMATED_ASSET = 1;
+const std::chrono::steady_clock::time_point startTime =
+    std::chrono::steady_clock::now();
+
+float msSinceStart() {
+  return std::chrono::duration<float, std::milli>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
+
+// The demo scene, shared by the GL and software paths. Each texture
+// directory holds albedo/normal/metallic/roughness/ao.png.
+struct SceneAsset {
+  const char *name;
+  const char *model;
+  const char *textures;
+  glm::vec3 position;
+  glm::vec3 scale;
+  bool occluder; // hides much of what is behind it
+};
+const SceneAsset SCENE_ASSETS[] = {
+    {"ground", "models/plane/simple_plane.obj", "models/plane",
+     glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.8f), false},
+    {"cup", "models/cup/cup.obj", "models/cup", glm::vec3(1.0f, 2.05f, 0.0f),
+     glm::vec3(0.5f), false},
+    {"table", "models/table/table.obj", "models/table",
+     glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(0.02f), true},
+    {"building", "models/building/build_asset12.obj", "models/building",
+     glm::vec3(12.0f, 0.0f, 0.0f), glm::vec3(1.0f), true},
+};
+const int SCENE_ASSET_COUNT = sizeof(SCENE_ASSETS) / sizeof(SCENE_ASSETS[0]);
+const char *MATERIAL_MAPS[5] = {"albedo", "normal", "metallic", "roughness",
+                                "ao"};
+// What each map shows until it is loaded: mid grey, flat, dielectric,
+// half rough, unoccluded
+const glm::vec3 MATERIAL_PLACEHOLDERS[5] = {
+    glm::vec3(0.5f), glm::vec3(0.5f, 0.5f, 1.0f), glm::vec3(0.0f),
+    glm::vec3(0.5f), glm::vec3(1.0f)};
+
+// Map index % 5 of scene asset index / 5
+std::string materialMapPath(int index) {
+  return std::string(SCENE_ASSETS[index / 5].textures) + "/" +
+         MATERIAL_MAPS[index % 5] + ".png";
+}
+
+// Light setup ("sun" casts the shadows, the rest are clustered point
+// lights with a finite influence radius)
+glm::vec3 lightPos(-2.0f, 4.0f, -1.0f);
+glm::vec3 sunColor(300.0f, 300.0f, 300.0f);
+
+std::vector<PointLight> createSceneLights() {
+  std::vector<PointLight> lights;
+  lights.push_back(PointLight(glm::vec3(10.0f, -10.0f, 10.0f),
+                              glm::vec3(100.0f),
+                              PointLight::radiusForIntensity(glm::vec3(100.0f))));
+  lights.push_back(PointLight(glm::vec3(-10.0f, 10.0f, 10.0f),
+                              glm::vec3(100.0f),
+                              PointLight::radiusForIntensity(glm::vec3(100.0f))));
+  return lights;
+}
+
+// Shadow map dimensions (per cascade)
+const unsigned int shadow_dim{2048};
+const int SHADOW_CASCADES = 4;
 
 // Helper function to render scene
 SceneUtils sceneRender = SceneUtils();
 
-unsigned int loadEquirectangularMap(const char* path) {
-    unsigned int textureID;
+// Worker threads for BVH builds and other CPU jobs
+ThreadPool workers;
+
+// Parsing and tangent generation are split over pool. Streamed loads
+// pass the streamer's own threads, the render thread helps with queued
+// work on workers whenever it waits on them.
+bool loadModelData(const char *path, ModelData &data, ThreadPool *pool) {
+  AssetData asset;
+  if (!cookedDir.empty()) {
+    std::string cooked = CookedAsset::meshPath(cookedDir, path);
+    if (assetPack().load(cooked, asset) &&
+        CookedAsset::readModel(asset.data(), asset.size(), data, cooked)) {
+      data.directory = std::string(path).substr(0, std::string(path).find_last_of('/'));
+      return true;
+    }
+    data = ModelData();
+  }
+  // Loose files keep the path overload, it releases parsed pages
+  if (assetPack().contains(path) && assetPack().load(path, asset))
+    return Model::loadData(asset.data(), asset.size(), path, data, pool);
+  return Model::loadData(path, data, pool);
+}
+
+// Stand-in until the model is loaded: a box over the cooked mesh's
+// bounds when there is one (only its header is read), else nothing at
+// the object's origin
+Model *createProxyModel(const SceneAsset &asset) {
+  AssetData cooked;
+  AABB box;
+  std::vector<Mesh> meshes;
+  if (cookedDir.empty() ||
+      !assetPack().load(CookedAsset::meshPath(cookedDir, asset.model), cooked) ||
+      !CookedAsset::readBounds(cooked.data(), cooked.size(), box))
+    return new Model(asset.name, std::move(meshes),
+                     AABB(glm::vec3(0.0f), glm::vec3(0.0f)));
+
+  glm::vec3 center = box.center(), extents = box.max - center;
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  for (int face = 0; face < 6; ++face) {
+    glm::vec3 normal(0.0f);
+    normal[face / 2] = face % 2 ? -1.0f : 1.0f;
+    glm::vec3 tangent = face / 2 == 1 ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                      : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    unsigned int first = (unsigned int)vertices.size();
+    const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    for (const float *corner : corners) {
+      Vertex vertex;
+      vertex.Position = center + (normal + corner[0] * tangent +
+                                  corner[1] * bitangent) * extents;
+      vertex.Normal = normal;
+      vertex.TexCoords = glm::vec2(corner[0], corner[1]) * 0.5f + 0.5f;
+      vertex.Tangent = glm::vec4(tangent, 1.0f);
+      vertices.push_back(vertex);
+    }
+    const unsigned int quad[6] = {0, 1, 2, 0, 2, 3};
+    for (unsigned int index : quad)
+      indices.push_back(first + index);
+  }
+  meshes.push_back(Mesh(vertices, indices, std::vector<Texture>()));
+  return new Model(asset.name, std::move(meshes), box);
+}
+
+// 1x1 texture shown until the real one is uploaded into the same
+// texture object. Respecifies textureID unless it is 0.
+unsigned int createPlaceholderTexture(const glm::vec3 &color, bool hdr,
+                                      unsigned int textureID = 0) {
+  if (textureID == 0)
     glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
-    stbi_set_flip_vertically_on_load(true);
-    float *data = stbi_loadf(path, &width, &height, &nrComponents, 0);
-    
-    if (data) {
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        
-        stbi_image_free(data);
-    } else {
-        std::cout << "Failed to load HDR image: " << path << std::endl;
-        stbi_image_free(data);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  if (hdr) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 1, 1, 0, GL_RGB, GL_FLOAT,
+                 &color[0]);
+  } else {
+    unsigned char texel[4] = {(unsigned char)(color.x * 255.0f + 0.5f),
+                              (unsigned char)(color.y * 255.0f + 0.5f),
+                              (unsigned char)(color.z * 255.0f + 0.5f), 255};
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, texel);
+  }
+  GLint wrap = hdr ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  return textureID;
+}
+
+// A texture ready for upload: the mapped cooked file when there is one,
+// else the decoded image. Filled on a loader thread.
+struct TextureData {
+  std::string path;
+  std::shared_ptr<AssetData> cooked;
+  std::string cookedPath;
+  bool isCooked;
+  bool hdr;
+  void *pixels;
+  int width, height, channels;
+
+  TextureData()
+      : isCooked(false), hdr(false), pixels(nullptr), width(0), height(0),
+        channels(0) {}
+  ~TextureData() { stbi_image_free(pixels); }
+};
+
+// mipStreamed: the cooked levels are left to TextureStreamer
+bool decodeTexture(const std::string &path, bool hdr, bool mipStreamed,
+                   TextureData &texture) {
+  PROFILE_SCOPE("decode texture");
+  texture.path = path;
+  texture.hdr = hdr;
+  if (!cookedDir.empty()) {
+    texture.cookedPath = CookedAsset::texturePath(cookedDir, path);
+    texture.cooked.reset(new AssetData);
+    if (assetPack().load(texture.cookedPath, *texture.cooked)) {
+      // Fault the pages in here, not in the upload on the render thread
+      char sum = 0;
+      for (size_t i = 0; !mipStreamed && i < texture.cooked->size(); i += 4096)
+        sum ^= texture.cooked->data()[i];
+      volatile char touched = sum;
+      (void)touched;
+      texture.isCooked = true;
+      return true;
     }
-    return textureID;
+  }
+  // OBJ texture coordinates start at the bottom-left (glTF images are
+  // decoded unflipped, see GltfLoader). The flag is per thread once set.
+  stbi_set_flip_vertically_on_load_thread(true);
+  AssetData file;
+  if (assetPack().load(path, file)) {
+    const stbi_uc *bytes = (const stbi_uc *)file.data();
+    if (hdr)
+      texture.pixels = stbi_loadf_from_memory(bytes, (int)file.size(), &texture.width,
+                                              &texture.height, &texture.channels, 0);
+    else
+      texture.pixels = stbi_load_from_memory(bytes, (int)file.size(), &texture.width,
+                                             &texture.height, &texture.channels, 0);
+  }
+  if (!texture.pixels) {
+    std::cout << (hdr ? "Failed to load HDR image: "
+                      : "Texture failed to load at path: ")
+              << path << std::endl;
+    return false;
+  }
+  assetPack().release(path);
+  return true;
+}
+
+// Render thread half: respecifies textureID (a placeholder, or 0 for a
+// new texture) with the loaded data. Cooked textures go to mips when
+// given, which uploads just their small levels.
+void uploadTexture(unsigned int &textureID, const TextureData &texture,
+                   TextureStreamer *mips = nullptr) {
+  PROFILE_SCOPE("upload texture");
+  if (texture.isCooked && mips) {
+    if (textureID == 0)
+      glGenTextures(1, &textureID);
+    mips->add(textureID, texture.cooked, texture.cookedPath);
+    return;
+  }
+  if (texture.isCooked) {
+    if (CookedAsset::uploadTexture(texture.cooked->data(), texture.cooked->size(),
+                                   textureID, texture.cookedPath))
+      assetPack().release(texture.cookedPath);
+    return;
+  }
+  if (!texture.pixels)
+    return;
+  if (textureID == 0)
+    glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  if (texture.hdr) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, texture.width, texture.height,
+                 0, GL_RGB, GL_FLOAT, texture.pixels);
+  } else {
+    GLenum format = GL_RGBA;
+    if (texture.channels == 1)
+      format = GL_RED;
+    else if (texture.channels == 2)
+      format = GL_RG;
+    else if (texture.channels == 3)
+      format = GL_RGB;
+    glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0,
+                 format, GL_UNSIGNED_BYTE, texture.pixels);
+  }
+  glGenerateMipmap(GL_TEXTURE_2D);
+  GLint wrap = texture.hdr ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 // Helper to render a skybox
@@ -104,35 +460,208 @@ void renderSkybox(Shader &skyboxShader, unsigned int envMap) {
     glBindTexture(GL_TEXTURE_2D, envMap);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
+    renderStats().addDraw(12);
     glDepthFunc(GL_LESS);
 }
 
-int main() {
+// --software frame loop: same scene, camera and frame stepping as
+// --headless / --benchmark, rendered by SoftwareRenderer on the workers
+int runSoftwareRenderer(const CameraPath &benchmarkPath, Benchmark &benchmark) {
+  std::vector<ModelData> models(SCENE_ASSET_COUNT);
+  for (int i = 0; i < SCENE_ASSET_COUNT; ++i) {
+    if (!loadModelData(SCENE_ASSETS[i].model, models[i], &workers)) {
+      std::cout << "ERROR::SOFTWARE::MODEL_NOT_LOADED " << SCENE_ASSETS[i].model
+                << std::endl;
+      return -1;
+    }
+  }
+
+  // OBJ textures are flipped, as in decodeTexture
+  stbi_set_flip_vertically_on_load(true);
+  SoftwareTexture envMap;
+  envMap.loadHdr("models/env_map.hdr");
+  std::vector<SoftwareMaterial> materials(SCENE_ASSET_COUNT);
+  workers.parallelFor(0, SCENE_ASSET_COUNT * 5, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      SoftwareMaterial &material = materials[i / 5];
+      SoftwareTexture *maps[5] = {&material.albedo, &material.normal,
+                                  &material.metallic, &material.roughness,
+                                  &material.ao};
+      maps[i % 5]->load(materialMapPath((int)i));
+    }
+  });
+
+  std::vector<SoftwareDrawItem> items;
+  for (int i = 0; i < SCENE_ASSET_COUNT; ++i) {
+    glm::mat4 transform =
+        glm::translate(glm::mat4(1.0f), SCENE_ASSETS[i].position);
+    transform = glm::scale(transform, SCENE_ASSETS[i].scale);
+    items.push_back(SoftwareDrawItem{&models[i], &materials[i], transform});
+  }
+
+  SoftwareFrame frame;
+  frame.sunPosition = lightPos;
+  frame.sunColor = sunColor;
+  frame.lights = createSceneLights();
+  frame.envMap = &envMap;
+  frame.envMapIntensity = 1.0f;
+  SoftwareFramebuffer framebuffer(SCR_WIDTH, SCR_HEIGHT);
+  SoftwareRenderer renderer;
+
+  for (int frameIndex = 0;; ++frameIndex) {
+    if (benchmarkMode ? benchmark.isDone() : frameIndex >= headlessFrames)
+      break;
+    float currentFrame = frameIndex * FIXED_FRAME_TIME;
+    renderStats().reset();
+    if (benchmarkMode) {
+      benchmark.beginFrame(frameIndex);
+      glm::vec3 position, target;
+      benchmarkPath.sample(std::fmod(currentFrame, benchmarkPath.getDuration()),
+                           position, target);
+      camera.LookAt(position, target);
+    }
+
+    frame.view = camera.GetViewMatrix();
+    frame.projection = glm::perspective(glm::radians(camera.Zoom),
+                                        (float)SCR_WIDTH / (float)SCR_HEIGHT,
+                                        0.1f, 100.0f);
+    frame.camPos = camera.Position;
+    renderer.render(items, frame, framebuffer, &workers);
+
+    if (benchmarkMode)
+      benchmark.endFrame(renderStats().drawCalls, renderStats().triangles);
+    if (!headlessOutput.empty()) {
+      char frameName[16];
+      std::snprintf(frameName, sizeof(frameName), "%04d.ppm", frameIndex);
+      framebuffer.writePPM(headlessOutput + frameName);
+    }
+  }
+
+  if (benchmarkMode)
+    benchmark.writeResults("software rasterizer, " +
+                           std::to_string(workers.size() + 1) + " threads");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--headless") == 0)
+      headless = true;
+    else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      headlessFrames = benchmarkSettings.measuredFrames = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+      headlessOutput = argv[++i];
+    else if (std::strcmp(argv[i], "--benchmark") == 0)
+      benchmarkMode = true;
+    else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+      benchmarkSettings.warmupFrames = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+      benchmarkSettings.csvPath = argv[++i];
+    else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+      benchmarkSettings.jsonPath = argv[++i];
+    else if (std::strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+      benchmarkPathFile = argv[++i];
+    else if (std::strcmp(argv[i], "--software") == 0)
+      softwareRendering = true;
+    else if (std::strcmp(argv[i], "--glb") == 0 && i + 1 < argc)
+      glbFile = argv[++i];
+    else if (std::strcmp(argv[i], "--cooked") == 0 && i + 1 < argc)
+      cookedDir = argv[++i];
+    else if (std::strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+      packFile = argv[++i];
+    else if (std::strcmp(argv[i], "--stream") == 0)
+      forceStreaming = true;
+    else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+      textureBudgetMB = (size_t)std::max(1, std::atoi(argv[++i]));
+    else if (std::strcmp(argv[i], "--animate") == 0)
+      animateScene = true;
+    else
+      std::cout << "Unknown argument " << argv[i] << std::endl;
+  }
+#ifdef NO_GLFW
+  headless = true;
+#endif
+  // Offscreen frames and benchmark runs should only depend on the frame
+  // index
+  if (headless || benchmarkMode)
+    dynamicResolution = false;
+  if (!packFile.empty() && !assetPack().open(packFile))
+    return -1;
+  CameraPath benchmarkPath = CameraPath::demo();
+  if (!benchmarkPathFile.empty() && !benchmarkPath.load(benchmarkPathFile))
+    return -1;
+  Benchmark benchmark(benchmarkSettings);
+  if (softwareRendering)
+    return runSoftwareRenderer(benchmarkPath, benchmark);
+
   TestCallback test1 = TestCallback();
   test1.PrintTest();
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  GLFWwindow *window =
-      glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "RETINAL ENGINE", NULL, NULL);
-  if (window == NULL) {
-    std::cout << "Failed to create GLFW window" << std::endl;
-    glfwTerminate();
+  Profiler::get().setThreadName("main");
+
+  GLADloadproc loader = nullptr;
+#ifndef NO_GLFW
+  GLFWwindow *window = NULL;
+#endif
+#ifdef HEADLESS_EGL
+  HeadlessContext headlessContext;
+#endif
+  if (headless) {
+#ifdef HEADLESS_EGL
+    if (!headlessContext.create(SCR_WIDTH, SCR_HEIGHT)) {
+      std::cout << "Failed to create headless context" << std::endl;
+      return -1;
+    }
+    loader = (GLADloadproc)HeadlessContext::getProcAddress;
+#else
+    std::cout << "Built without a headless backend (HEADLESS_EGL)" << std::endl;
     return -1;
+#endif
+  } else {
+#ifndef NO_GLFW
+    glfwInit();
+    // 4.3 enables the GPU-driven path, anything else falls back to 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_DEPTH_BITS, 24);
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
+
+    window =
+        glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "RETINAL ENGINE", NULL, NULL);
+    if (window == NULL) {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+      window =
+          glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "RETINAL ENGINE", NULL, NULL);
+    }
+    if (window == NULL) {
+      std::cout << "Failed to create GLFW window" << std::endl;
+      glfwTerminate();
+      return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // Measure rendering, not vsync
+    if (benchmarkMode)
+      glfwSwapInterval(0);
+    loader = (GLADloadproc)glfwGetProcAddress;
+#endif
   }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-  glfwSetCursorPosCallback(window, mouse_callback);
-  glfwSetScrollCallback(window, scroll_callback);
-
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+  if (!gladLoadGLLoader(loader)) {
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
+  gpuDrivenSupported = loadGLExtensions(loader);
+#ifdef HEADLESS_EGL
+  if (headless)
+    headlessContext.createFramebuffer();
+#endif
 
   glEnable(GL_DEPTH_TEST);
   // glEnable(GL_CULL_FACE);
@@ -141,76 +670,165 @@ int main() {
   Shader pbrShader("shaders/pbr.vs", "shaders/pbr.fs");
   Shader simpleDepthShader("shaders/shadow_depth.vs",
                            "shaders/shadow_depth.fs");
-
-  // Load multiple models (can be same file or different)
-  Model model1("ground", "models/plane/simple_plane.obj");
-  Model model2("cup", "models/cup/cup.obj");
-  Model model3("table", "models/table/table.obj");
-  Model model4("building", "models/building/build_asset12.obj");
+  Shader depthPrepassShader("shaders/depth_prepass.vs",
+                            "shaders/shadow_depth.fs");
+  Shader gBufferShader("shaders/pbr.vs", "shaders/gbuffer.fs");
+  Shader deferredLightingShader("shaders/deferred_lighting.vs",
+                                "shaders/deferred_lighting.fs");
+
+  // Camera, sun and per-draw matrices are streamed through one uniform
+  // ring instead of glUniform calls
+  StreamBuffer uniformStream(GL_UNIFORM_BUFFER, 256 * 1024);
+  sceneRender.setDrawStream(&uniformStream);
+  Shader *streamedShaders[5] = {&pbrShader, &simpleDepthShader,
+                                &depthPrepassShader, &gBufferShader,
+                                &deferredLightingShader};
+  for (Shader *shader : streamedShaders)
+    bindFrameUniformBlocks(*shader);
+  std::cout << "Uniform stream: "
+            << (uniformStream.isPersistent() ? "persistently mapped"
+                                             : "glBufferSubData fallback")
+            << std::endl;
 
   /////////env map///////
   Shader skyboxShader("shaders/skybox.vs", "shaders/skybox.fs");
   initSkybox();
 
+  // Every asset starts as a placeholder, loads on a streamer thread and
+  // is swapped in by streamer.update() (see STREAM_BUDGET_MS). The
+  // streamer is declared after everything its swaps touch.
+  std::vector<std::unique_ptr<Model>> models(SCENE_ASSET_COUNT);
+  std::vector<std::unique_ptr<OccluderMesh>> occluders(SCENE_ASSET_COUNT);
+  std::unique_ptr<GpuDrivenRenderer> gpuDriven;
+  Scene scene;
+  std::atomic<int> failedModels(0);
+  std::unique_ptr<TextureStreamer> textureStreamer;
+  AssetStreamer streamer;
+  bool streaming = forceStreaming || !(headless || benchmarkMode);
+  if (streaming && !cookedDir.empty())
+    textureStreamer.reset(new TextureStreamer(streamer, textureBudgetMB << 20));
+
+  // Material maps go to the texture streamer, the env map is always
+  // fully resident
+  auto requestTexture = [&](unsigned int textureID, const std::string &path,
+                            bool hdr) {
+    TextureStreamer *mips = hdr ? nullptr : textureStreamer.get();
+    streamer.request([textureID, path, hdr, mips,
+                      &gpuDriven]() -> AssetStreamer::Finish {
+      std::shared_ptr<TextureData> texture(new TextureData);
+      // A map that doesn't load reads as black, like the incomplete
+      // texture it used to be
+      if (!decodeTexture(path, hdr, mips != nullptr, *texture))
+        return [textureID, hdr, &gpuDriven] {
+          createPlaceholderTexture(glm::vec3(0.0f), hdr, textureID);
+          if (gpuDriven)
+            gpuDriven->textureChanged(textureID);
+        };
+      return [textureID, texture, mips, &gpuDriven] {
+        unsigned int id = textureID;
+        uploadTexture(id, *texture, mips);
+        if (gpuDriven)
+          gpuDriven->textureChanged(id);
+      };
+    });
+  };
+
   // Load environment map (download any free HDRi from hdrihaven.com/polyhaven.com)
   // Or use a JPG/PNG - it works too, just less dynamic range
-  unsigned int envMap = loadEquirectangularMap("models/env_map.hdr"); // or .jpg
-
-  // vector<Model*> models {&model1, &model2, &model3};
-
-  // Load textures
-  unsigned int albedo = loadTexture("models/plane/albedo.png");
-  unsigned int normal = loadTexture("models/plane/normal.png");
-  unsigned int metallic = loadTexture("models/plane/metallic.png");
-  unsigned int roughness = loadTexture("models/plane/roughness.png");
-  unsigned int ao = loadTexture("models/plane/ao.png");
-
-  unsigned int cup_albedo = loadTexture("models/cup/albedo.png");
-  unsigned int cup_normal = loadTexture("models/cup/normal.png");
-  unsigned int cup_metallic = loadTexture("models/cup/metallic.png");
-  unsigned int cup_roughness = loadTexture("models/cup/roughness.png");
-  unsigned int cup_ao = loadTexture("models/cup/ao.png");
-
-  unsigned int table_albedo = loadTexture("models/table/albedo.png");
-  unsigned int table_normal = loadTexture("models/table/normal.png");
-  unsigned int table_metallic = loadTexture("models/table/metallic.png");
-  unsigned int table_roughness = loadTexture("models/table/roughness.png");
-  unsigned int table_ao = loadTexture("models/table/ao.png");
-
-  unsigned int building_albedo = loadTexture("models/building/albedo.png");
-  unsigned int building_normal = loadTexture("models/building/normal.png");
-  unsigned int building_metallic = loadTexture("models/building/metallic.png");
-  unsigned int building_roughness = loadTexture("models/building/roughness.png");
-  unsigned int building_ao = loadTexture("models/building/ao.png");
-
-  // Configure depth map FBO
-  glGenFramebuffers(1, &depthMapFBO);
-  glGenTextures(1, &depthMap);
-  glBindTexture(GL_TEXTURE_2D, depthMap);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH,
-               SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-  float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-  glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
-                         depthMap, 0);
-  glDrawBuffer(GL_NONE);
-  glReadBuffer(GL_NONE);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  // Light setup (use first light as "sun" for shadows)
-  glm::vec3 lightPos(-2.0f, 4.0f, -1.0f);
-  glm::vec3 lightColors[] = {glm::vec3(300.0f, 300.0f, 300.0f),
-                             glm::vec3(100.0f, 100.0f, 100.0f),
-                             glm::vec3(100.0f, 100.0f, 100.0f)};
-  glm::vec3 lightPositions[] = {lightPos, glm::vec3(10.0f, -10.0f, 10.0f),
-                                glm::vec3(-10.0f, 10.0f, 10.0f)};
+  unsigned int envMap = createPlaceholderTexture(glm::vec3(0.5f), true);
+  requestTexture(envMap, "models/env_map.hdr", true); // or .jpg
+
+  for (int i = 0; i < SCENE_ASSET_COUNT; ++i) {
+    const SceneAsset &asset = SCENE_ASSETS[i];
+    models[i].reset(createProxyModel(asset));
+    unsigned int maps[5];
+    for (int m = 0; m < 5; ++m)
+      maps[m] = createPlaceholderTexture(MATERIAL_PLACEHOLDERS[m], false);
+    scene.add(SceneObject(asset.name, models[i].get(),
+                          {maps[0], maps[1], maps[2], maps[3], maps[4]},
+                          asset.position, asset.scale));
+
+    streamer.request([&, i]() -> AssetStreamer::Finish {
+      std::shared_ptr<ModelData> data(new ModelData);
+      if (!loadModelData(SCENE_ASSETS[i].model, *data,
+                         streaming ? streamer.getLoaderPool() : &workers)) {
+        std::cout << "ERROR::MODEL::NOT_LOADED " << SCENE_ASSETS[i].model
+                  << std::endl;
+        ++failedModels;
+        return [] {};
+      }
+      return [&, i, data] {
+        PROFILE_SCOPE("upload model");
+        models[i].reset(new Model(SCENE_ASSETS[i].name, *data));
+        SceneObject &object = scene.objects[i];
+        object.model = models[i].get();
+        // New bounds: the BVH refits and cached shadows are redrawn
+        object.transformDirty = true;
+        if (SCENE_ASSETS[i].occluder) {
+          occluders[i].reset(new OccluderMesh(*models[i]));
+          object.occluder = occluders[i].get();
+        }
+        if (gpuDriven)
+          gpuDriven->invalidate();
+      };
+    });
+    for (int m = 0; m < 5; ++m)
+      requestTexture(maps[m], materialMapPath(i * 5 + m), false);
+  }
+  // glTF parts load up front, they are only there with --glb
+  std::vector<GltfPart> gltfParts;
+  if (!glbFile.empty()) {
+    GltfLoader gltf(&workers);
+    gltf.load(glbFile, gltfParts);
+    for (GltfPart &part : gltfParts)
+      scene.add(SceneObject(part.name, part.model.get(), part.material,
+                            glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(1.0f)));
+  }
+  // A flat ground plane only receives shadows
+  scene.objects[0].castsShadow = false;
+  scene.objects[ANIMATED_ASSET].isStatic = !animateScene;
+  OcclusionCuller occlusion;
+
+  if (!streaming) {
+    streamer.finishAll();
+    if (failedModels > 0)
+      return -1;
+  }
+  if (gpuDrivenSupported)
+    gpuDriven.reset(new GpuDrivenRenderer(scene, SCR_WIDTH, SCR_HEIGHT));
+  scene.buildBVH(&workers);
+  std::vector<int> visibleObjects;
+  std::vector<int> shadowCasters;
+  OverdrawCounter overdraw;
+  float lastOverdrawPrint = 0.0f;
+  int framesSincePrint = 0;
+  GBuffer gBuffer;
+  RenderGraph frameGraph;
+
+  Shader upscaleShader("shaders/deferred_lighting.vs", "shaders/upscale.fs");
+  unsigned int fullscreenVAO;
+  glGenVertexArrays(1, &fullscreenVAO);
+  GpuTimer frameTimer;
+  DynamicResolution dynres({DYNRES_TARGET_MS, DYNRES_MIN_SCALE,
+                            DYNRES_MAX_SCALE, 0.1f, 0.05f});
+
+  // Cascaded shadow maps for the sun
+  CascadedShadowMap sunShadows(shadow_dim, SHADOW_CASCADES);
+
+  std::vector<PointLight> sceneLights = createSceneLights();
+
+  std::vector<PointLight> demoLightField;
+  for (int i = 0; i < DEMO_LIGHT_COUNT; ++i) {
+    float x = -16.0f + 2.0f * (i % 16);
+    float z = -16.0f + 2.0f * (i / 16);
+    glm::vec3 color(0.5f + 0.5f * sin(i * 1.7f), 0.5f + 0.5f * sin(i * 2.3f + 2.0f),
+                    0.5f + 0.5f * sin(i * 3.1f + 4.0f));
+    demoLightField.push_back(PointLight(glm::vec3(x, 0.3f, z), color * 2.0f, 2.5f));
+  }
+  std::vector<PointLight> activeLights;
+  std::vector<bool> drawnObjects;
+  std::vector<int> lightReach;
+  ClusteredLighting clusters;
 
   
   // Configure PBR shader
@@ -224,130 +842,457 @@ int main() {
   pbrShader.setInt("envMap", 6);      // Texture unit 5
   pbrShader.setFloat("envMapIntensity", 1.0f);
 
+  gBufferShader.use();
+  gBufferShader.setInt("albedoMap", 0);
+  gBufferShader.setInt("normalMap", 1);
+  gBufferShader.setInt("metallicMap", 2);
+  gBufferShader.setInt("roughnessMap", 3);
+  gBufferShader.setInt("aoMap", 4);
+
+  if (gpuDriven) {
+    Shader *indirectShaders[2] = {&gpuDriven->forwardShader,
+                                  &gpuDriven->gBufferShader};
+    bindFrameUniformBlocks(gpuDriven->prepassShader);
+    for (Shader *shader : indirectShaders) {
+      bindFrameUniformBlocks(*shader);
+      shader->use();
+      shader->setInt("albedoMap", 0);
+      shader->setInt("normalMap", 1);
+      shader->setInt("metallicMap", 2);
+      shader->setInt("roughnessMap", 3);
+      shader->setInt("aoMap", 4);
+      for (int m = 0; m < 5; ++m)
+        shader->setInt(std::string(MATERIAL_MAPS[m]) + "Array",
+                       MaterialPools::FIRST_UNIT + m);
+      shader->setInt("shadowMap", 5);
+      shader->setInt("envMap", 6);
+      shader->setFloat("envMapIntensity", 1.0f);
+    }
+    // Mip-streamed textures change levels in place, they keep their own
+    // binding
+    TextureStreamer *mips = textureStreamer.get();
+    gpuDriven->setPoolFilter([mips](unsigned int id) {
+      return !mips || !mips->contains(id);
+    });
+  }
+
+  deferredLightingShader.use();
+  deferredLightingShader.setInt("shadowMap", 5);
+  deferredLightingShader.setInt("envMap", 6);
+  deferredLightingShader.setFloat("envMapIntensity", 1.0f);
+
   skyboxShader.use();
   skyboxShader.setInt("envMap", 0);
 
-  while (!glfwWindowShouldClose(window)) {
-    float currentFrame = glfwGetTime();
+  bool allResident = false;
+  for (int frameIndex = 0;; ++frameIndex) {
+    if (benchmarkMode ? benchmark.isDone()
+                      : headless && frameIndex >= headlessFrames)
+      break;
+    float currentFrame = frameIndex * FIXED_FRAME_TIME;
+#ifndef NO_GLFW
+    if (!headless) {
+      if (glfwWindowShouldClose(window))
+        break;
+      if (!benchmarkMode)
+        currentFrame = glfwGetTime();
+    }
+#endif
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
+    Profiler::get().beginFrame();
+    PROFILE_SCOPE("frame");
+    renderStats().reset();
+    if (benchmarkMode) {
+      benchmark.beginFrame(frameIndex);
+      glm::vec3 position, target;
+      benchmarkPath.sample(std::fmod(currentFrame, benchmarkPath.getDuration()),
+                           position, target);
+      camera.LookAt(position, target);
+    }
 
-        processInput(window);
-
-    // Shadow setup
-    //  Render depth of scene to texture (from light's perspective)
-    glm::mat4 lightProjection =
-        glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 7.5f);
-    glm::mat4 lightView =
-        glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-    glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-
-    simpleDepthShader.use();
-    simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glCullFace(GL_FRONT); // Prevent peter-panning
-    // renderScene(simpleDepthShader, model1, model2, model3); //hard coded 3
-    // models, to fix this <-
-    // sceneRender.renderScene(simpleDepthShader, models); //hard coded 3
-    // models, to fix this <-
-
-    //---------------------------3D OBJECTS
-    //XFORMS------------------------------------------------ ground
-    const glm::vec3 model1_position{0.0f, 0.0f, 0.0f};
-    const glm::vec3 model1_scale{0.8f};
-    // cup
-    const glm::vec3 model2_position{1.0f, 2.05f, 0.0f};
-    const glm::vec3 model2_scale{0.5f};
-    // table
-    const glm::vec3 model3_position{1.0f, 1.0f, 0.0f};
-    const glm::vec3 model3_scale{0.02f};
-    // rock
-    const glm::vec3 model4_position{12.0f, 0.0f, 0.0f};
-    const glm::vec3 model4_scale{1.0f};
-
-    //---------------------------RENDER SHADOW DEPTH
-    //PIPELINE--------------------------------------
-
-    sceneRender.renderModel(simpleDepthShader, &model1, model1_position,
-                            model1_scale);
-    sceneRender.renderModel(simpleDepthShader, &model2, model2_position,
-                            model2_scale);
-    sceneRender.renderModel(simpleDepthShader, &model3, model3_position,
-                            model3_scale);
-    sceneRender.renderModel(simpleDepthShader, &model4, model4_position,
-                            model4_scale);
+#ifndef NO_GLFW
+    if (!headless && !benchmarkMode)
+      processInput(window);
+#endif
 
-        glCullFace(GL_BACK);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (animateScene) {
+      const SceneAsset &asset = SCENE_ASSETS[ANIMATED_ASSET];
+      glm::vec3 bob(0.0f, 0.15f * (1.0f + std::sin(currentFrame * 2.0f)), 0.0f);
+      scene.objects[ANIMATED_ASSET].setTransform(asset.position + bob,
+                                                 asset.scale);
+    }
 
-    // Render scene as normal with shadow mapping
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Swap in assets that finished loading, then refit the BVH for
+    // anything that moved (or changed model) since last frame
+    streamer.update(STREAM_BUDGET_MS);
+    {
+      PROFILE_SCOPE("scene update");
+      scene.update(&workers);
+    }
+    bool gpuSubmit = gpuDriven && gpuDrivenSubmission;
+    if (gpuDriven) {
+      gpuDriven->setMaterialPooling(gpuSubmit);
+      gpuDriven->update(scene);
+    }
 
-    //////env map///update
     glm::mat4 view = camera.GetViewMatrix();
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH/(float)SCR_HEIGHT, 0.1f, 100.0f);
+    if (textureStreamer)
+      textureStreamer->update(
+          scene, Frustum(projection * view), camera.Position,
+          SCR_HEIGHT / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f)));
+
+    // Everything written to the ring from here on belongs to this frame
+    uniformStream.beginFrame();
+    FrameData frameData;
+    frameData.projection = projection;
+    frameData.view = view;
+    frameData.camPos = glm::vec4(camera.Position, 1.0f);
+    frameData.sunPosition = glm::vec4(lightPos, 1.0f);
+    frameData.sunColor = glm::vec4(sunColor, 0.0f);
+    // First write of the frame, it only fails if the ring is smaller than
+    // one FrameData and then nothing can be drawn
+    if (!uniformStream.writeAndBind(FRAME_DATA_BINDING, frameData)) {
+      std::cout << "ERROR::FRAME::NO_FRAME_DATA" << std::endl;
+      break;
+    }
 
-    // Remove translation from view matrix for skybox (infinite distance)
-    glm::mat4 skyView = glm::mat4(glm::mat3(view));
-
-    skyboxShader.use();
-    skyboxShader.setMat4("projection", projection);
-    skyboxShader.setMat4("view", skyView);
-    renderSkybox(skyboxShader, envMap);
-
-    pbrShader.use();
-    // pbrShader_cup.use();
-    // pbrShader_table.use();
-
-    // glm::mat4 projection =
-    //     glm::perspective(glm::radians(camera.Zoom),
-    //                      (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    // glm::mat4 view = camera.GetViewMatrix();
-    pbrShader.setMat4("projection", projection);
-    pbrShader.setMat4("view", view);
-    pbrShader.setVec3("camPos", camera.Position);
-    pbrShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-    // Set lights
-    for (unsigned int i = 0; i < 3; ++i) {
-      pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]",
-                        lightPositions[i]);
-      pbrShader.setVec3("lightColors[" + std::to_string(i) + "]",
-                        lightColors[i]);
+    // Shadow setup
+    //  Fit the cascades to the camera frustum, sun shines from lightPos
+    //  towards the origin
+    sunShadows.update(view, glm::radians(camera.Zoom),
+                      (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f,
+                      -lightPos, scene.getBounds());
+
+    // Static objects that moved drop the cached static layers they touch
+    for (const AABB &changed : scene.getStaticChanges())
+      sunShadows.invalidate(changed);
+
+    // CPU-side culling and light binning, the graph passes below only draw
+    if (gpuSubmit) {
+      gpuDriven->setOcclusionCulling(occlusionCulling);
+    } else {
+      PROFILE_SCOPE("cull");
+      scene.cull(Frustum(projection * view), visibleObjects);
+      if (occlusionCulling)
+        occlusion.cull(scene, projection * view, visibleObjects, &workers);
+    }
+    activeLights = sceneLights;
+    if (demoLights)
+      activeLights.insert(activeLights.end(), demoLightField.begin(),
+                          demoLightField.end());
+    {
+      PROFILE_SCOPE("light binning");
+      // A light whose sphere reaches nothing drawn this frame can't light
+      // a pixel, so it stays out of the clusters
+      drawnObjects.assign(scene.objects.size(), gpuSubmit);
+      if (!gpuSubmit)
+        for (int i : visibleObjects)
+          drawnObjects[i] = true;
+      auto lightsNothing = [&](const PointLight &light) {
+        scene.queryLightInfluence(light.position, light.radius, lightReach);
+        for (int i : lightReach)
+          if (drawnObjects[i])
+            return false;
+        return true;
+      };
+      activeLights.erase(std::remove_if(activeLights.begin(),
+                                        activeLights.end(), lightsNothing),
+                         activeLights.end());
+      clusters.build(activeLights, view, projection, 0.1f, 100.0f, &workers);
     }
 
-    //---------------------------RENDER SHADER GEOM
-    //PIPELINE--------------------------------------
-    // Bind textures
+    // Everything up to the upscale renders at this size
+    int renderWidth = dynamicResolution ? dynres.scaledSize(SCR_WIDTH) : SCR_WIDTH;
+    int renderHeight =
+        dynamicResolution ? dynres.scaledSize(SCR_HEIGHT) : SCR_HEIGHT;
+    if (gpuDriven)
+      gpuDriven->resize(renderWidth, renderHeight);
+
+    Shader &forwardShader = gpuSubmit ? gpuDriven->forwardShader : pbrShader;
+    Shader &geometryShader = gpuSubmit ? gpuDriven->gBufferShader : gBufferShader;
+
+    // Lights, shadows and env map, the same for the forward and deferred
+    // lighting programs
+    auto bindLighting = [&](Shader &shader) {
+      shader.use();
+      sunShadows.setUniforms(shader);
+      clusters.bind(shader, (float)renderWidth, (float)renderHeight);
+      glActiveTexture(GL_TEXTURE5);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, sunShadows.depthArray);
+      glActiveTexture(GL_TEXTURE6);
+      glBindTexture(GL_TEXTURE_2D, envMap);
+    };
+
+    auto drawOpaques = [&](Shader &shader) {
+      if (depthPrepass) {
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+      }
+      overdraw.beginShading();
+      if (gpuSubmit)
+        gpuDriven->draw(shader);
+      else
+        for (int i : visibleObjects)
+          sceneRender.processShaderPipeline(shader, scene.objects[i]);
+      overdraw.endShading();
+      if (depthPrepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+      }
+    };
+
+    //---------------------------FRAME GRAPH-----------------------------------
+    // Passes are declared with their inputs and outputs; the graph orders
+    // them, drops unused ones and hands out (aliased) render targets
+    frameGraph.reset();
+    RenderResource windowTarget =
+        frameGraph.import("window", 0, SCR_WIDTH, SCR_HEIGHT);
+#ifdef HEADLESS_EGL
+    if (headless)
+      windowTarget = frameGraph.importFramebuffer(
+          "window", headlessContext.framebuffer, SCR_WIDTH, SCR_HEIGHT);
+#endif
+    RenderResource shadowMap =
+        frameGraph.import("shadowMap", sunShadows.depthArray);
+    RenderResource drawCommands = frameGraph.import("drawCommands", 0);
+    RenderResource depthPyramid = frameGraph.import("depthPyramid", 0);
+    RenderResource sceneColor = frameGraph.createTarget(
+        "sceneColor",
+        {renderWidth, renderHeight, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE});
+    RenderResource sceneDepth = frameGraph.createTarget(
+        "sceneDepth", {renderWidth, renderHeight, GL_DEPTH24_STENCIL8,
+                       GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8});
+    GBuffer::Targets gTargets;
 
-    sceneRender.processShaderPipeline(envMap,albedo, normal, metallic, roughness, ao,
-                                      depthMap, pbrShader, &model1,
-                                      model1_position, model1_scale);
+    //---------------------------RENDER SHADOW DEPTH
+    //PIPELINE--------------------------------------
+    frameGraph.addPass("shadows", [&]() {
+      simpleDepthShader.use();
+      glCullFace(GL_FRONT); // Prevent peter-panning
+      for (int c = 0; c < sunShadows.getCascadeCount(); ++c) {
+        simpleDepthShader.setMat4("lightSpaceMatrix",
+                                  sunShadows.getLightSpaceMatrix(c));
+
+        // Static layer, only when the light/cascade or a static object changed
+        if (sunShadows.needsStaticUpdate(c)) {
+          scene.cullShadowCasters(sunShadows.getStaticCasterCuller(c),
+                                  shadowCasters, CASTERS_STATIC);
+          sunShadows.beginStaticUpdate(c);
+          for (int i : shadowCasters)
+            sceneRender.renderObjectDepth(simpleDepthShader, scene.objects[i]);
+        }
+
+        // Only objects whose shadow can land inside this cascade's slice
+        scene.cullShadowCasters(sunShadows.getCasterCuller(c), shadowCasters,
+                                sunShadows.isCaching() ? CASTERS_DYNAMIC
+                                                       : CASTERS_ALL);
+        if (sunShadows.beginDynamicUpdate(c, !shadowCasters.empty())) {
+          for (int i : shadowCasters)
+            sceneRender.renderObjectDepth(simpleDepthShader, scene.objects[i]);
+        }
+      }
+      glCullFace(GL_BACK);
+    }).write(shadowMap);
+
+    // GPU-driven: culling runs in a compute shader instead
+    if (gpuSubmit)
+      frameGraph.addPass("gpu cull", [&]() {
+        gpuDriven->cull(projection * view);
+      }).write(drawCommands);
+
+    // Optional depth-only pre-pass so pbr.fs runs once per visible pixel
+    if (depthPrepass)
+      frameGraph.addPass("depth prepass", [&]() {
+        overdraw.beginPrepass();
+        Shader &prepassShader =
+            gpuSubmit ? gpuDriven->prepassShader : depthPrepassShader;
+        prepassShader.use();
+        if (gpuSubmit)
+          gpuDriven->draw(prepassShader, false);
+        else
+          for (int i : visibleObjects)
+            sceneRender.renderObjectDepth(prepassShader, scene.objects[i]);
+        overdraw.endPrepass();
+      }).read(drawCommands).writeDepth(sceneDepth).clear(GL_DEPTH_BUFFER_BIT);
+
+    GLbitfield depthClear = depthPrepass ? 0 : GL_DEPTH_BUFFER_BIT;
+    if (deferredShading) {
+      // Deferred: the geometry pass fills the G-buffer, lighting then runs
+      // once per pixel in a fullscreen pass
+      gTargets = GBuffer::createTargets(frameGraph, renderWidth, renderHeight,
+                                        sceneDepth);
+      frameGraph.addPass("gbuffer", [&]() {
+        geometryShader.use();
+        drawOpaques(geometryShader);
+      }).read(drawCommands)
+        .write(gTargets.albedo).write(gTargets.normal).write(gTargets.orm)
+        .writeDepth(sceneDepth).clear(GL_COLOR_BUFFER_BIT | depthClear);
+
+      frameGraph.addPass("deferred lighting", [&]() {
+        bindLighting(deferredLightingShader);
+        gBuffer.drawLightingPass(deferredLightingShader,
+                                 glm::inverse(projection * view), frameGraph,
+                                 gTargets);
+      }).read(gTargets.albedo).read(gTargets.normal).read(gTargets.orm)
+        .read(sceneDepth).read(shadowMap).write(sceneColor);
+    } else {
+      frameGraph.addPass("forward", [&]() {
+        bindLighting(forwardShader);
+        drawOpaques(forwardShader);
+      }).read(drawCommands).read(shadowMap)
+        .write(sceneColor).writeDepth(sceneDepth)
+        .clear(GL_COLOR_BUFFER_BIT | depthClear);
+    }
 
-    sceneRender.processShaderPipeline(envMap,
-        cup_albedo, cup_normal, cup_metallic, cup_roughness, cup_ao, depthMap,
-        pbrShader, &model2, model2_position, model2_scale);
+    //////env map///update
+    // After the opaques, so the depth test leaves only uncovered pixels
+    frameGraph.addPass("skybox", [&]() {
+      // Remove translation from view matrix for skybox (infinite distance)
+      glm::mat4 skyView = glm::mat4(glm::mat3(view));
+      skyboxShader.use();
+      skyboxShader.setMat4("projection", projection);
+      skyboxShader.setMat4("view", skyView);
+      renderSkybox(skyboxShader, envMap);
+    }).write(sceneColor).writeDepth(sceneDepth);
+
+    // Next frame's GPU occlusion test uses this frame's depth
+    if (gpuSubmit)
+      frameGraph.addPass("hi-z", [&]() {
+        gpuDriven->buildDepthPyramid(frameGraph.getTexture(sceneDepth));
+      }).read(sceneDepth).write(depthPyramid);
+
+    // Scene colour to the window, upscaled when rendered smaller
+    frameGraph.addPass("upscale", [&]() {
+      bool scaled = renderWidth != (int)SCR_WIDTH ||
+                    renderHeight != (int)SCR_HEIGHT;
+      if (scaled && edgeAwareUpscale) {
+        upscaleShader.use();
+        upscaleShader.setBool("edgeAware", true);
+        upscaleShader.setInt("source", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, frameGraph.getTexture(sceneColor));
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        renderStats().addDraw(1);
+        glEnable(GL_DEPTH_TEST);
+        return;
+      }
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, frameGraph.getFramebuffer(sceneColor));
+      glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, SCR_WIDTH,
+                        SCR_HEIGHT, GL_COLOR_BUFFER_BIT,
+                        scaled ? GL_LINEAR : GL_NEAREST);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }).read(sceneColor).write(windowTarget);
+
+    frameGraph.compile();
+    frameTimer.begin((float)(renderWidth * renderHeight) /
+                     (float)(SCR_WIDTH * SCR_HEIGHT));
+    frameGraph.execute();
+    frameTimer.end();
+    if (frameTimer.endFrame()) {
+      if (dynamicResolution)
+        dynres.update(frameTimer.getLastMs(), frameTimer.getLastTag());
+      if (benchmarkMode)
+        benchmark.addGpuTime(frameTimer.getLastFrame(), frameTimer.getLastMs());
+    }
+    if (historyRequested) {
+      dynres.printHistory();
+      historyRequested = false;
+    }
+    overdraw.endFrame();
+    framesSincePrint++;
+    if (currentFrame - lastOverdrawPrint > 2.0f) {
+      // Average frame time, for comparing forward and deferred
+      std::cout << (deferredShading ? "Deferred: " : "Forward: ")
+                << 1000.0f * (currentFrame - lastOverdrawPrint) / framesSincePrint
+                << " ms/frame, " << activeLights.size() << " lights" << std::endl;
+      overdraw.print(renderWidth * renderHeight);
+      std::cout << "Resolution: " << renderWidth << "x" << renderHeight
+                << " (scale " << (dynamicResolution ? dynres.getScale() : 1.0f)
+                << "), GPU " << frameTimer.getLastMs() << " ms, target "
+                << dynres.getSettings().targetMs << " ms" << std::endl;
+      frameGraph.printSchedule();
+      Profiler::get().printStats();
+      if (textureStreamer)
+        textureStreamer->print();
+      if (gpuSubmit)
+        std::cout << "GPU-driven: " << gpuDriven->getCommandCount()
+                  << " indirect draws in " << gpuDriven->getBatchCount()
+                  << " multi-draw calls, " << gpuDriven->getPoolCount()
+                  << " texture array pools" << std::endl;
+      else if (occlusionCulling)
+        std::cout << "Occlusion culled " << occlusion.getCulledCount() << " of "
+                  << occlusion.getTestedCount() << " objects ("
+                  << occlusion.getTriangleCount() << " occluder triangles)"
+                  << std::endl;
+      lastOverdrawPrint = currentFrame;
+      framesSincePrint = 0;
+    }
 
-    sceneRender.processShaderPipeline(envMap,
-        table_albedo, table_normal, table_metallic, table_roughness, table_ao,
-        depthMap, pbrShader, &model3, model3_position, model3_scale);
+    if (pickRequested) {
+      // Cursor is captured, so pick through the centre of the screen
+      Ray ray = camera.GetPickRay(SCR_WIDTH * 0.5f, SCR_HEIGHT * 0.5f,
+                                  (float)SCR_WIDTH, (float)SCR_HEIGHT);
+      float t;
+      int hit = scene.pick(ray, 1000.0f, t);
+      if (hit >= 0)
+        std::cout << "Picked " << scene.objects[hit].name << " at distance "
+                  << t << std::endl;
+      pickRequested = false;
+    }
 
-    sceneRender.processShaderPipeline(envMap,
-        building_albedo, building_normal, building_metallic, building_roughness, building_ao,
-        depthMap, pbrShader, &model4, model4_position, model4_scale);
+    uniformStream.endFrame();
+    Profiler::get().endFrame();
+    if (benchmarkMode)
+      benchmark.endFrame(renderStats().drawCalls, renderStats().triangles);
+    if (headless) {
+#ifdef HEADLESS_EGL
+      if (!headlessOutput.empty()) {
+        char frameName[16];
+        std::snprintf(frameName, sizeof(frameName), "%04d.ppm", frameIndex);
+        headlessContext.writeFrame(headlessOutput + frameName);
+      }
+#endif
+    } else {
+#ifndef NO_GLFW
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+#endif
+    }
+    if (frameIndex == 0) {
+      glFinish();
+      std::cout << "Time to first frame: " << msSinceStart() << " ms ("
+                << streamer.pending() << " assets still loading)" << std::endl;
+    }
+    if (!allResident && streamer.idle()) {
+      allResident = true;
+      std::cout << "All assets resident after " << msSinceStart() << " ms"
+                << std::endl;
+    }
+  }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+  if (benchmarkMode) {
+    std::string description = std::string((const char *)glGetString(GL_RENDERER)) +
+                              ", GL " + (const char *)glGetString(GL_VERSION) +
+                              (deferredShading ? ", deferred" : ", forward") +
+                              (gpuDrivenSubmission ? ", GPU-driven" : "") +
+                              (depthPrepass ? ", depth prepass" : "") +
+                              (occlusionCulling ? ", occlusion culling" : "");
+    benchmark.writeResults(description);
   }
 
-  glfwTerminate();
+#ifndef NO_GLFW
+  if (!headless)
+    glfwTerminate();
+#endif
   return 0;
 }
 
+#ifndef NO_GLFW
 void processInput(GLFWwindow *window) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
@@ -360,6 +1305,74 @@ void processInput(GLFWwindow *window) {
     camera.ProcessKeyboard(LEFT, deltaTime);
   if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
     camera.ProcessKeyboard(RIGHT, deltaTime);
+
+  bool prepassKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+  if (prepassKey && !prepassKeyDown) {
+    depthPrepass = !depthPrepass;
+    std::cout << "Depth pre-pass " << (depthPrepass ? "on" : "off") << std::endl;
+  }
+  prepassKeyDown = prepassKey;
+
+  bool demoLightsKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+  if (demoLightsKey && !demoLightsKeyDown) {
+    demoLights = !demoLights;
+    std::cout << "Demo lights " << (demoLights ? "on" : "off") << std::endl;
+  }
+  demoLightsKeyDown = demoLightsKey;
+
+  bool deferredKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+  if (deferredKey && !deferredKeyDown) {
+    deferredShading = !deferredShading;
+    std::cout << (deferredShading ? "Deferred" : "Forward") << " shading"
+              << std::endl;
+  }
+  deferredKeyDown = deferredKey;
+
+  bool occlusionKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+  if (occlusionKey && !occlusionKeyDown) {
+    occlusionCulling = !occlusionCulling;
+    std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off")
+              << std::endl;
+  }
+  occlusionKeyDown = occlusionKey;
+
+  bool gpuDrivenKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+  if (gpuDrivenKey && !gpuDrivenKeyDown) {
+    if (gpuDrivenSupported) {
+      gpuDrivenSubmission = !gpuDrivenSubmission;
+      std::cout << "GPU-driven submission "
+                << (gpuDrivenSubmission ? "on" : "off") << std::endl;
+    } else {
+      std::cout << "GPU-driven submission needs OpenGL 4.3" << std::endl;
+    }
+  }
+  gpuDrivenKeyDown = gpuDrivenKey;
+
+  bool dynamicResolutionKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+  if (dynamicResolutionKey && !dynamicResolutionKeyDown) {
+    dynamicResolution = !dynamicResolution;
+    std::cout << "Dynamic resolution " << (dynamicResolution ? "on" : "off")
+              << std::endl;
+  }
+  dynamicResolutionKeyDown = dynamicResolutionKey;
+
+  bool upscaleKey = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+  if (upscaleKey && !upscaleKeyDown) {
+    edgeAwareUpscale = !edgeAwareUpscale;
+    std::cout << (edgeAwareUpscale ? "Edge-aware" : "Bilinear") << " upscale"
+              << std::endl;
+  }
+  upscaleKeyDown = upscaleKey;
+
+  bool historyKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+  if (historyKey && !historyKeyDown)
+    historyRequested = true;
+  historyKeyDown = historyKey;
+
+  bool traceKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+  if (traceKey && !traceKeyDown)
+    Profiler::get().capture(TRACE_FRAMES, TRACE_PATH);
+  traceKeyDown = traceKey;
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
@@ -386,37 +1399,11 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
   camera.ProcessMouseScroll(yoffset);
 }
 
-unsigned int loadTexture(const char *path) {
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-
-  int width, height, nrComponents;
-  unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-  if (data) {
-    GLenum format;
-    if (nrComponents == 1)
-      format = GL_RED;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  } else {
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
-  }
-
-  return textureID;
+void mouse_button_callback(GLFWwindow *window, int button, int action,
+                           int mods) {
+  (void)window;
+  (void)mods;
+  if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    pickRequested = true;
 }
+#endif
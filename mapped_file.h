@@ -0,0 +1,153 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages come in from the OS
+// cache as they are touched, so handing data() to glBufferData or a
+// decoder skips the read-into-a-buffer copy.
+class MappedFile {
+public:
+    // Readahead on a miss. Sequential reads far ahead and suits parsers
+    // walking the file; archives read by entry want the OS default, with
+    // prefetch() saying what comes next.
+    enum Access {
+        ACCESS_SEQUENTIAL,
+        ACCESS_NORMAL
+    };
+
+    MappedFile() : m_Data(nullptr), m_Size(0) {
+#ifdef _WIN32
+        m_File = INVALID_HANDLE_VALUE;
+        m_Mapping = nullptr;
+#endif
+    }
+
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path, Access access = ACCESS_SEQUENTIAL) {
+        close();
+#ifdef _WIN32
+        DWORD flags = access == ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+        m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | flags, nullptr);
+        LARGE_INTEGER size;
+        if (m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_File, &size)) {
+            std::cout << "ERROR::MAPPED_FILE::FILE_NOT_OPENED " << path << std::endl;
+            close();
+            return false;
+        }
+        m_Size = (size_t)size.QuadPart;
+        if (m_Size == 0)
+            return true;
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_Data = m_Mapping ? (const char *)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            std::cout << "ERROR::MAPPED_FILE::FILE_NOT_OPENED " << path << std::endl;
+            if (fd >= 0)
+                ::close(fd);
+            return false;
+        }
+        m_Size = (size_t)info.st_size;
+        if (m_Size == 0) {
+            ::close(fd);
+            return true;
+        }
+        void *data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        m_Data = data == MAP_FAILED ? nullptr : (const char *)data;
+        if (m_Data && access == ACCESS_SEQUENTIAL)
+            madvise(data, m_Size, MADV_SEQUENTIAL);
+#endif
+        if (!m_Data) {
+            std::cout << "ERROR::MAPPED_FILE::FILE_NOT_MAPPED " << path << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE)
+            CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+        m_Mapping = nullptr;
+#else
+        if (m_Data)
+            munmap((void *)m_Data, m_Size);
+#endif
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+    // Drops pages a streaming reader is done with from the working set.
+    // They are clean, so they are simply read again if touched; without
+    // this a multi-gigabyte file ends up fully resident. Only whole pages
+    // inside the range are dropped.
+    void release(size_t offset, size_t length) {
+#ifndef _WIN32
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = (offset + page - 1) / page * page;
+        size_t end = std::min(offset + length, m_Size) / page * page;
+        if (m_Data && end > begin)
+            madvise((void *)(m_Data + begin), end - begin, MADV_DONTNEED);
+#else
+        (void)offset;
+        (void)length;
+#endif
+    }
+
+    // Readahead hint: starts reading the range in the background so a
+    // later touch doesn't stall on the disk. Returns immediately.
+    void prefetch(size_t offset, size_t length) const {
+#ifndef _WIN32
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = offset / page * page;
+        size_t end = std::min(offset + length, m_Size);
+        if (m_Data && end > begin)
+            madvise((void *)(m_Data + begin), end - begin, MADV_WILLNEED);
+#else
+        (void)offset;
+        (void)length;
+#endif
+    }
+
+    const char *data() const { return m_Data; }
+    size_t size() const { return m_Size; }
+
+private:
+    const char *m_Data;
+    size_t m_Size;
+#ifdef _WIN32
+    HANDLE m_File;
+    HANDLE m_Mapping;
+#endif
+};
+
+#endif
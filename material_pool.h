@@ -0,0 +1,363 @@
+#ifndef MATERIAL_POOL_H
+#define MATERIAL_POOL_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "gl_ext.h"
+#include "scene_objects.h"
+
+// Texture arrays for the GPU-driven path. Materials whose five maps have
+// the same size, format and mip count share a pool: one
+// GL_TEXTURE_2D_ARRAY per map, a layer per material, so every object in
+// the pool is drawn by the same multi-draw and picks its layer from the
+// object buffer. Maps are copied in with glCopyImageSubData (GL 4.3), the
+// original textures stay as they are for the per-object path.
+//
+// Pools double when full (the old layers are copied over on the GPU)
+// and are repacked once three quarters of them are free, so streaming
+// materials in and out doesn't leave them growing forever.
+class MaterialPools {
+public:
+    // Units of the five arrays, after GpuDrivenRenderer::PYRAMID_UNIT
+    static const int FIRST_UNIT = 11;
+    static const int MIN_LAYERS = 4;
+
+    // pool -1: the material can't be pooled, draw it with its own maps
+    struct Slot {
+        int pool;
+        int layer;
+    };
+
+    MaterialPools() {}
+    ~MaterialPools() { clear(); }
+
+    MaterialPools(const MaterialPools &) = delete;
+    MaterialPools &operator=(const MaterialPools &) = delete;
+
+    // Textures the filter rejects are never pooled (ones whose levels
+    // change behind our back, like the texture streamer's)
+    void setFilter(const std::function<bool(unsigned int)> &filter) { m_Filter = filter; }
+
+    // textureID was respecified or its pixels changed, the next update()
+    // copies it again
+    void textureChanged(unsigned int textureID) { m_Changed.push_back(textureID); }
+
+    // Places every material used this frame, copying in the new ones and
+    // the changed ones. Materials no longer used give their layers back.
+    void update(const std::vector<Material> &materials) {
+        for (Entry &entry : m_Entries)
+            entry.used = false;
+        for (const Material &material : materials) {
+            Entry *entry = findEntry(material);
+            if (!entry) {
+                m_Entries.push_back(Entry{material, Slot{-1, -1}, false});
+                entry = &m_Entries.back();
+            }
+            if (entry->used)
+                continue;
+            entry->used = true;
+            Layout layouts[5];
+            bool poolable = true;
+            for (int m = 0; m < 5; ++m)
+                poolable = poolable && readLayout(mapOf(material, m), layouts[m]);
+            int pool = entry->slot.pool;
+            if (poolable && pool >= 0 && sameLayouts(m_Pools[pool].layouts, layouts)) {
+                if (changed(material))
+                    copyIn(*entry);
+                continue;
+            }
+            release(*entry);
+            if (poolable) {
+                entry->slot = allocate(layouts);
+                copyIn(*entry);
+            }
+        }
+        for (size_t e = 0; e < m_Entries.size();) {
+            if (m_Entries[e].used) {
+                ++e;
+                continue;
+            }
+            release(m_Entries[e]);
+            m_Entries.erase(m_Entries.begin() + e);
+        }
+        m_Changed.clear();
+
+        for (int p = (int)m_Pools.size() - 1; p >= 0; --p) {
+            Pool &pool = m_Pools[p];
+            if (pool.used == 0)
+                destroy(p);
+            else if (pool.capacity > MIN_LAYERS && pool.used <= pool.capacity / 4)
+                reallocate(p, std::max(MIN_LAYERS, pool.used * 2), true);
+        }
+    }
+
+    Slot find(const Material &material) const {
+        for (const Entry &entry : m_Entries)
+            if (sameMaterial(entry.material, material))
+                return entry.slot;
+        return Slot{-1, -1};
+    }
+
+    // Binds a pool's arrays to FIRST_UNIT..FIRST_UNIT+4
+    void bind(int pool) const {
+        for (int m = 0; m < 5; ++m) {
+            glActiveTexture(GL_TEXTURE0 + FIRST_UNIT + m);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_Pools[pool].arrays[m]);
+        }
+    }
+
+    // Frees every array
+    void clear() {
+        for (Pool &pool : m_Pools)
+            glDeleteTextures(5, pool.arrays);
+        m_Pools.clear();
+        m_Entries.clear();
+        m_Changed.clear();
+    }
+
+    int getPoolCount() const { return (int)m_Pools.size(); }
+
+    int getLayerCount() const {
+        int layers = 0;
+        for (const Pool &pool : m_Pools)
+            layers += pool.capacity;
+        return layers;
+    }
+
+    static bool sameMaterial(const Material &a, const Material &b) {
+        return a.albedo == b.albedo && a.normal == b.normal && a.metallic == b.metallic &&
+               a.roughness == b.roughness && a.ao == b.ao;
+    }
+
+private:
+    struct Layout {
+        GLint width;
+        GLint height;
+        GLint format; // internal
+        GLint levels;
+    };
+
+    struct Pool {
+        Layout layouts[5];
+        unsigned int arrays[5];
+        int capacity;
+        int used;
+        std::vector<int> freeLayers;
+    };
+
+    struct Entry {
+        Material material;
+        Slot slot;
+        bool used; // by the current update()
+    };
+
+    std::vector<Pool> m_Pools;
+    std::vector<Entry> m_Entries;
+    std::vector<unsigned int> m_Changed;
+    std::function<bool(unsigned int)> m_Filter;
+
+    static unsigned int mapOf(const Material &material, int map) {
+        const unsigned int maps[5] = {material.albedo, material.normal, material.metallic, material.roughness,
+                                      material.ao};
+        return maps[map];
+    }
+
+    // Uncompressed 8 bit formats only, the ones material maps are
+    // uploaded with
+    static GLenum pixelFormat(GLint internalFormat) {
+        switch (internalFormat) {
+        case GL_R8:
+        case GL_RED:
+            return GL_RED;
+        case GL_RG8:
+        case GL_RG:
+            return GL_RG;
+        case GL_RGB8:
+        case GL_RGB:
+            return GL_RGB;
+        case GL_RGBA8:
+        case GL_RGBA:
+            return GL_RGBA;
+        default:
+            return 0;
+        }
+    }
+
+    static bool sameLayouts(const Layout *a, const Layout *b) {
+        for (int m = 0; m < 5; ++m)
+            if (a[m].width != b[m].width || a[m].height != b[m].height || a[m].format != b[m].format ||
+                a[m].levels != b[m].levels)
+                return false;
+        return true;
+    }
+
+    // False for textures that can't go in an array as they are: filtered
+    // out, a base level above 0, an odd format, a swizzle or an
+    // incomplete chain
+    bool readLayout(unsigned int textureID, Layout &layout) const {
+        if (textureID == 0 || (m_Filter && !m_Filter(textureID)))
+            return false;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLint baseLevel = 0, maxLevel = 0;
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &layout.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &layout.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &layout.format);
+        if (baseLevel != 0 || layout.width <= 0 || layout.height <= 0 || !pixelFormat(layout.format))
+            return false;
+        // The copy takes raw texels, a swizzle (glTF metallic/roughness
+        // reading one channel of a shared map) would be lost
+        const GLenum swizzles[4] = {GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B,
+                                    GL_TEXTURE_SWIZZLE_A};
+        const GLint identity[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+        for (int c = 0; c < 4; ++c) {
+            GLint swizzle = identity[c];
+            glGetTexParameteriv(GL_TEXTURE_2D, swizzles[c], &swizzle);
+            if (swizzle != identity[c])
+                return false;
+        }
+        int chain = 1 + (int)std::floor(std::log2((float)std::max(layout.width, layout.height)));
+        layout.levels = 1;
+        while (layout.levels < chain && layout.levels <= maxLevel) {
+            GLint width = 0, height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, layout.levels, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, layout.levels, GL_TEXTURE_HEIGHT, &height);
+            if (width != std::max(1, layout.width >> layout.levels) ||
+                height != std::max(1, layout.height >> layout.levels))
+                break;
+            ++layout.levels;
+        }
+        // Sampling stops at the last level either way, or the texture is
+        // incomplete and there is nothing to copy
+        return layout.levels == chain || layout.levels == maxLevel + 1;
+    }
+
+    Entry *findEntry(const Material &material) {
+        for (Entry &entry : m_Entries)
+            if (sameMaterial(entry.material, material))
+                return &entry;
+        return nullptr;
+    }
+
+    bool changed(const Material &material) const {
+        for (unsigned int id : m_Changed)
+            for (int m = 0; m < 5; ++m)
+                if (mapOf(material, m) == id)
+                    return true;
+        return false;
+    }
+
+    static unsigned int createArray(const Layout &layout, int layers) {
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (int level = 0; level < layout.levels; ++level)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, layout.format, std::max(1, layout.width >> level),
+                         std::max(1, layout.height >> level), layers, 0, pixelFormat(layout.format),
+                         GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, layout.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return array;
+    }
+
+    // Layers srcLayer..srcLayer+count-1 of every level
+    static void copyLayers(const Layout &layout, unsigned int source, GLenum sourceTarget, int srcLayer,
+                           unsigned int dest, int destLayer, int count) {
+        for (int level = 0; level < layout.levels; ++level)
+            glCopyImageSubData(source, sourceTarget, level, 0, 0, srcLayer, dest, GL_TEXTURE_2D_ARRAY, level, 0, 0,
+                               destLayer, std::max(1, layout.width >> level), std::max(1, layout.height >> level),
+                               count);
+    }
+
+    void copyIn(const Entry &entry) {
+        const Pool &pool = m_Pools[entry.slot.pool];
+        for (int m = 0; m < 5; ++m)
+            copyLayers(pool.layouts[m], mapOf(entry.material, m), GL_TEXTURE_2D, 0, pool.arrays[m],
+                       entry.slot.layer, 1);
+    }
+
+    Slot allocate(const Layout *layouts) {
+        int p = 0;
+        while (p < (int)m_Pools.size() && !sameLayouts(m_Pools[p].layouts, layouts))
+            ++p;
+        if (p == (int)m_Pools.size()) {
+            Pool pool;
+            std::copy(layouts, layouts + 5, pool.layouts);
+            for (int m = 0; m < 5; ++m)
+                pool.arrays[m] = createArray(layouts[m], MIN_LAYERS);
+            pool.capacity = MIN_LAYERS;
+            pool.used = 0;
+            for (int layer = MIN_LAYERS - 1; layer >= 0; --layer)
+                pool.freeLayers.push_back(layer);
+            m_Pools.push_back(pool);
+        } else if (m_Pools[p].freeLayers.empty()) {
+            reallocate(p, m_Pools[p].capacity * 2, false);
+        }
+        Pool &pool = m_Pools[p];
+        int layer = pool.freeLayers.back();
+        pool.freeLayers.pop_back();
+        ++pool.used;
+        return Slot{p, layer};
+    }
+
+    void release(Entry &entry) {
+        if (entry.slot.pool >= 0) {
+            Pool &pool = m_Pools[entry.slot.pool];
+            pool.freeLayers.push_back(entry.slot.layer);
+            --pool.used;
+        }
+        entry.slot = Slot{-1, -1};
+    }
+
+    // New arrays of the given capacity. Growing copies every old layer
+    // across in place; packing moves the pool's materials to the first
+    // layers, in entry order.
+    void reallocate(int p, int capacity, bool pack) {
+        Pool &pool = m_Pools[p];
+        unsigned int arrays[5];
+        for (int m = 0; m < 5; ++m)
+            arrays[m] = createArray(pool.layouts[m], capacity);
+        pool.freeLayers.clear();
+        if (pack) {
+            int next = 0;
+            for (Entry &entry : m_Entries) {
+                if (entry.slot.pool != p)
+                    continue;
+                for (int m = 0; m < 5; ++m)
+                    copyLayers(pool.layouts[m], pool.arrays[m], GL_TEXTURE_2D_ARRAY, entry.slot.layer, arrays[m],
+                               next, 1);
+                entry.slot.layer = next++;
+            }
+            for (int layer = capacity - 1; layer >= next; --layer)
+                pool.freeLayers.push_back(layer);
+        } else {
+            for (int m = 0; m < 5; ++m)
+                copyLayers(pool.layouts[m], pool.arrays[m], GL_TEXTURE_2D_ARRAY, 0, arrays[m], 0, pool.capacity);
+            for (int layer = capacity - 1; layer >= pool.capacity; --layer)
+                pool.freeLayers.push_back(layer);
+        }
+        glDeleteTextures(5, pool.arrays);
+        std::copy(arrays, arrays + 5, pool.arrays);
+        pool.capacity = capacity;
+    }
+
+    // Only for pools nothing uses
+    void destroy(int p) {
+        glDeleteTextures(5, m_Pools[p].arrays);
+        m_Pools.erase(m_Pools.begin() + p);
+        for (Entry &entry : m_Entries)
+            if (entry.slot.pool > p)
+                --entry.slot.pool;
+    }
+};
+
+#endif
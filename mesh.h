@@ -4,8 +4,13 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
+#include "render_stats.h"
 #include "shader.h"
 
 using namespace std;
@@ -14,8 +19,7 @@ struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
     glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
+    glm::vec4 Tangent; // w: handedness, bitangent = cross(Normal, Tangent) * w
 };
 
 struct Texture {
@@ -24,21 +28,154 @@ struct Texture {
     string path;
 };
 
+// One mesh before it reaches the GPU
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+};
+
+// One attribute inside an existing GL buffer, described like a glTF
+// accessor. size 0 means the mesh has no such attribute.
+struct VertexStream {
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei stride; // 0 = tightly packed
+    size_t offset;
+};
+
+// GL buffer name shared by the meshes drawing from it, deleted with the
+// last of them
+typedef std::shared_ptr<const unsigned int> SharedBuffer;
+
+inline SharedBuffer makeSharedBuffer(unsigned int buffer) {
+    return SharedBuffer(new unsigned int(buffer), [](const unsigned int *b) {
+        glDeleteBuffers(1, b);
+        delete b;
+    });
+}
+
+// Geometry that is already in a GL buffer (a .glb binary chunk), drawn
+// in place instead of going through Vertex
+struct MeshStreams {
+    SharedBuffer buffer;
+    VertexStream position, normal, texCoords, tangent;
+    unsigned int vertexCount;
+    GLenum indexType;
+    size_t indexOffset;
+    unsigned int indexCount;
+};
+
 class Mesh {
 public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
     unsigned int VAO;
+    // Position-only stream for depth-only passes (pre-pass, shadows)
+    unsigned int depthVAO;
 
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        m_Streamed = false;
+        m_IndexCount = (unsigned int)this->indices.size();
+        m_IndexType = GL_UNSIGNED_INT;
+        m_IndexOffset = 0;
 
         setupMesh();
     }
 
+    // Draws from streams.buffer as is. vertices/indices stay empty, see
+    // getGeometry for a CPU copy.
+    explicit Mesh(const MeshStreams &streams) : m_Streamed(true), m_Streams(streams) {
+        m_IndexCount = streams.indexCount;
+        m_IndexType = streams.indexType;
+        m_IndexOffset = streams.indexOffset;
+        VBO = EBO = positionVBO = 0;
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, *streams.buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *streams.buffer);
+        bindStream(0, streams.position);
+        bindStream(1, streams.normal);
+        bindStream(2, streams.texCoords);
+        bindStream(3, streams.tangent);
+
+        glGenVertexArrays(1, &depthVAO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *streams.buffer);
+        bindStream(0, streams.position);
+        glBindVertexArray(0);
+    }
+
+    // Owns its GL objects, so it moves but doesn't copy. A streamed
+    // mesh only holds a reference to the buffer it draws from.
+    ~Mesh() { release(); }
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    Mesh(Mesh &&other) noexcept : VAO(0), depthVAO(0), VBO(0), EBO(0), positionVBO(0) { *this = std::move(other); }
+
+    Mesh &operator=(Mesh &&other) noexcept {
+        if (this == &other)
+            return *this;
+        release();
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        VAO = other.VAO;
+        depthVAO = other.depthVAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        positionVBO = other.positionVBO;
+        m_Streamed = other.m_Streamed;
+        m_Streams = std::move(other.m_Streams);
+        m_IndexCount = other.m_IndexCount;
+        m_IndexType = other.m_IndexType;
+        m_IndexOffset = other.m_IndexOffset;
+        other.VAO = other.depthVAO = other.VBO = other.EBO = other.positionVBO = 0;
+        return *this;
+    }
+
+    unsigned int getIndexCount() const { return m_IndexCount; }
+
+    // Vertices and indices on the CPU, read back from GL for streamed
+    // meshes (load time users like occluders and the merged geometry
+    // buffer). Streams must be float, the glTF loader only streams float
+    // accessors in place and converts the rest.
+    void getGeometry(vector<Vertex> &outVertices, vector<unsigned int> &outIndices) const {
+        if (!m_Streamed) {
+            outVertices = vertices;
+            outIndices = indices;
+            return;
+        }
+        outVertices.assign(m_Streams.vertexCount, Vertex());
+        glBindBuffer(GL_COPY_READ_BUFFER, *m_Streams.buffer);
+        readStream(m_Streams.position, outVertices, offsetof(Vertex, Position));
+        readStream(m_Streams.normal, outVertices, offsetof(Vertex, Normal));
+        readStream(m_Streams.texCoords, outVertices, offsetof(Vertex, TexCoords));
+        readStream(m_Streams.tangent, outVertices, offsetof(Vertex, Tangent));
+
+        size_t indexSize = m_IndexType == GL_UNSIGNED_BYTE ? 1 : m_IndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+        vector<unsigned char> bytes(m_IndexCount * indexSize);
+        if (!bytes.empty())
+            glGetBufferSubData(GL_COPY_READ_BUFFER, m_IndexOffset, bytes.size(), bytes.data());
+        outIndices.resize(m_IndexCount);
+        for (size_t i = 0; i < m_IndexCount; i++) {
+            if (indexSize == 1)
+                outIndices[i] = bytes[i];
+            else if (indexSize == 2)
+                outIndices[i] = ((const unsigned short *)bytes.data())[i];
+            else
+                outIndices[i] = ((const unsigned int *)bytes.data())[i];
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
     void Draw(Shader &shader) {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
@@ -63,14 +200,58 @@ public:
         }
         
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, m_IndexCount, m_IndexType, (void*)m_IndexOffset);
         glBindVertexArray(0);
+        renderStats().addDraw(m_IndexCount / 3);
 
         glActiveTexture(GL_TEXTURE0);
     }
 
+    void DrawDepth() {
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, m_IndexCount, m_IndexType, (void*)m_IndexOffset);
+        glBindVertexArray(0);
+        renderStats().addDraw(m_IndexCount / 3);
+    }
+
 private:
-    unsigned int VBO, EBO;
+    unsigned int VBO, EBO, positionVBO;
+    bool m_Streamed;
+    MeshStreams m_Streams;
+    unsigned int m_IndexCount;
+    GLenum m_IndexType;
+    size_t m_IndexOffset;
+
+    void release() {
+        unsigned int arrays[2] = {VAO, depthVAO};
+        unsigned int buffers[3] = {VBO, EBO, positionVBO};
+        if (VAO || depthVAO)
+            glDeleteVertexArrays(2, arrays);
+        if (VBO || EBO || positionVBO)
+            glDeleteBuffers(3, buffers);
+        VAO = depthVAO = VBO = EBO = positionVBO = 0;
+    }
+
+    static void bindStream(GLuint location, const VertexStream &stream) {
+        if (stream.size == 0) {
+            glDisableVertexAttribArray(location);
+            return;
+        }
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, stream.size, stream.type, stream.normalized, stream.stride,
+                              (void*)stream.offset);
+    }
+
+    void readStream(const VertexStream &stream, vector<Vertex> &out, size_t member) const {
+        if (stream.size == 0 || out.empty())
+            return;
+        size_t element = stream.size * sizeof(float);
+        size_t stride = stream.stride ? stream.stride : element;
+        vector<unsigned char> bytes(stride * (out.size() - 1) + element);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, stream.offset, bytes.size(), bytes.data());
+        for (size_t i = 0; i < out.size(); i++)
+            memcpy((char*)&out[i] + member, &bytes[i * stride], element);
+    }
 
     void setupMesh() {
         glGenVertexArrays(1, &VAO);
@@ -91,9 +272,22 @@ private:
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+        // Tightly packed positions so depth-only passes fetch 12 bytes per
+        // vertex instead of the full 48 byte vertex, sharing the same EBO
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
 
         glBindVertexArray(0);
     }
@@ -8,20 +8,47 @@
 #include "tiny_obj_loader.h"
 #include "stb_image.h"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
+#include "bounds.h"
 #include "mesh.h"
+#include "obj_stream.h"
+#include "profiler.h"
 #include "shader.h"
+#include "thread_pool.h"
 
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// Everything the OBJ loader produces before the GL upload. Building it
+// needs no GL context, so it can happen on a worker thread or in a tool.
+struct ModelData {
+    vector<MeshData> meshes;
+    AABB bounds;
+    string directory;
+    float uvDensity; // see Model::uvDensity
+
+    ModelData() : uvDensity(0.0f) {}
+};
+
+struct ObjData {
+    tinyobj::attrib_t attrib;
+    vector<tinyobj::shape_t> shapes;
+    vector<tinyobj::material_t> materials;
+};
+
 class Model {
 private:
     string m_Name;
@@ -30,106 +57,441 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    AABB bounds;
+    // Texture coordinate units per model space unit, averaged over the
+    // surface. Texture streaming turns it into texels per pixel; 0 when
+    // unknown (proxies, glTF parts).
+    float uvDensity;
 
     Model(string const &name, string const &path, bool gamma = false) : m_Name(name), gammaCorrection(gamma) {
-        loadModel(path);
+        PROFILE_SCOPE("load model");
+        ModelData data;
+        if (!loadData(path, data))
+            exit(1);
+        upload(data);
+    }
+
+    // GL upload of data loaded elsewhere
+    Model(string const &name, const ModelData &data, bool gamma = false) : m_Name(name), gammaCorrection(gamma) {
+        upload(data);
+    }
+
+    // Meshes that already live on the GPU (see gltf_loader.h)
+    Model(string const &name, vector<Mesh> gpuMeshes, const AABB &meshBounds) : m_Name(name), gammaCorrection(false) {
+        meshes.swap(gpuMeshes);
+        bounds = meshBounds;
+        uvDensity = 0.0f;
     }
 
+    const string &getName() const { return m_Name; }
+
     void Draw(Shader &shader) {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
-private:
-    void loadModel(string const &path) {
-        tinyobj::attrib_t attrib;
-        vector<tinyobj::shape_t> shapes;
-        vector<tinyobj::material_t> materials;
-        string warn, err;
+    void DrawDepth() {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth();
+    }
 
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
-        
+    // The loader stages, usable on their own (see tools/loader_bench.cpp).
+    // With a pool the per-vertex stages are split across its workers.
+
+    static bool parseObj(string const &path, ObjData &obj) {
+        string warn, err;
+        bool ret = tinyobj::LoadObj(&obj.attrib, &obj.shapes, &obj.materials, &warn, &err, path.c_str());
         if(!warn.empty()) cout << warn << endl;
         if(!err.empty()) cerr << err << endl;
-        if(!ret) exit(1);
-
-        directory = path.substr(0, path.find_last_of('/'));
-
-        for (size_t s = 0; s < shapes.size(); s++) {
-            vector<Vertex> vertices;
-            vector<unsigned int> indices;
-            
-            size_t index_offset = 0;
-            for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-                int fv = shapes[s].mesh.num_face_vertices[f];
-                
-                for (size_t v = 0; v < fv; v++) {
-                    tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                    
-                    Vertex vertex;
-                    
-                    vertex.Position = glm::vec3(
-                        attrib.vertices[3*idx.vertex_index+0],
-                        attrib.vertices[3*idx.vertex_index+1],
-                        attrib.vertices[3*idx.vertex_index+2]
+        return ret;
+    }
+
+    // One vertex per face corner, indices 0..n-1
+    static void expandVertices(const ObjData &obj, const tinyobj::shape_t &shape, MeshData &mesh,
+                               ThreadPool *pool = nullptr) {
+        const tinyobj::attrib_t &attrib = obj.attrib;
+        size_t faceCount = shape.mesh.num_face_vertices.size();
+        vector<size_t> faceStart(faceCount + 1, 0);
+        for (size_t f = 0; f < faceCount; f++)
+            faceStart[f + 1] = faceStart[f] + shape.mesh.num_face_vertices[f];
+
+        mesh.vertices.resize(faceStart[faceCount]);
+        auto expand = [&](size_t begin, size_t end) {
+            for (size_t i = faceStart[begin]; i < faceStart[end]; i++) {
+                tinyobj::index_t idx = shape.mesh.indices[i];
+                Vertex &vertex = mesh.vertices[i];
+
+                vertex.Position = glm::vec3(
+                    attrib.vertices[3*idx.vertex_index+0],
+                    attrib.vertices[3*idx.vertex_index+1],
+                    attrib.vertices[3*idx.vertex_index+2]
+                );
+
+                if(idx.normal_index >= 0)
+                    vertex.Normal = glm::vec3(
+                        attrib.normals[3*idx.normal_index+0],
+                        attrib.normals[3*idx.normal_index+1],
+                        attrib.normals[3*idx.normal_index+2]
                     );
-                    
-                    if(idx.normal_index >= 0)
-                        vertex.Normal = glm::vec3(
-                            attrib.normals[3*idx.normal_index+0],
-                            attrib.normals[3*idx.normal_index+1],
-                            attrib.normals[3*idx.normal_index+2]
-                        );
-                    
-                    if(idx.texcoord_index >= 0)
-                        vertex.TexCoords = glm::vec2(
-                            attrib.texcoords[2*idx.texcoord_index+0],
-                            attrib.texcoords[2*idx.texcoord_index+1]
-                        );
-                    else
-                        vertex.TexCoords = glm::vec2(0, 0);
-                    
-                    vertices.push_back(vertex);
+                else
+                    vertex.Normal = glm::vec3(0.0f);
+
+                if(idx.texcoord_index >= 0)
+                    vertex.TexCoords = glm::vec2(
+                        attrib.texcoords[2*idx.texcoord_index+0],
+                        attrib.texcoords[2*idx.texcoord_index+1]
+                    );
+                else
+                    vertex.TexCoords = glm::vec2(0, 0);
+                vertex.Tangent = glm::vec4(0.0f);
+            }
+        };
+        if (pool)
+            pool->parallelFor(0, faceCount, 16384, expand);
+        else
+            expand(0, faceCount);
+
+        mesh.indices.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+            mesh.indices[i] = (unsigned int)i;
+    }
+
+    // Smooth tangent frames in the MikkTSpace style. Every triangle corner
+    // contributes its face tangent, projected onto the vertex normal and
+    // weighted by the corner angle. The sum is taken over all corners with
+    // the same position, normal and UV whose UVs wind the same way, so
+    // mirrored UV islands keep separate frames. Tangent.w is the
+    // handedness: bitangent = cross(normal, tangent) * w. A vertex used by
+    // both windings is split, which can append vertices and rewrite indices.
+    static void computeTangents(MeshData &mesh, ThreadPool *pool = nullptr) {
+        vector<Vertex> &vertices = mesh.vertices;
+        vector<unsigned int> &indices = mesh.indices;
+        size_t cornerCount = indices.size() / 3 * 3;
+
+        // Weighted tangent/bitangent of each corner, in parallel over triangles
+        vector<glm::vec3> cornerTangent(cornerCount), cornerBitangent(cornerCount);
+        vector<unsigned char> cornerMirrored(cornerCount);
+        auto faces = [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                const Vertex *v[3] = {&vertices[indices[t*3]], &vertices[indices[t*3+1]], &vertices[indices[t*3+2]]};
+                glm::vec3 deltaPos1 = v[1]->Position - v[0]->Position;
+                glm::vec3 deltaPos2 = v[2]->Position - v[0]->Position;
+                glm::vec2 deltaUV1 = v[1]->TexCoords - v[0]->TexCoords;
+                glm::vec2 deltaUV2 = v[2]->TexCoords - v[0]->TexCoords;
+
+                // A zero UV area gives no direction, those corners only
+                // take the tangent of their neighbours
+                float det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+                glm::vec3 tangent(0.0f), bitangent(0.0f);
+                if (std::fabs(det) > std::numeric_limits<float>::min()) {
+                    tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) / det;
+                    bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) / det;
+                }
+
+                for (int k = 0; k < 3; k++) {
+                    glm::vec3 e1 = v[(k+1)%3]->Position - v[k]->Position;
+                    glm::vec3 e2 = v[(k+2)%3]->Position - v[k]->Position;
+                    float lengths = glm::length(e1) * glm::length(e2);
+                    float angle = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(e1, e2) / lengths, -1.0f, 1.0f)) : 0.0f;
+                    const glm::vec3 &n = v[k]->Normal;
+                    size_t c = t*3 + k;
+                    cornerTangent[c] = safeNormalize(tangent - n * glm::dot(n, tangent)) * angle;
+                    cornerBitangent[c] = safeNormalize(bitangent - n * glm::dot(n, bitangent)) * angle;
+                    cornerMirrored[c] = det < 0.0f;
                 }
-                index_offset += fv;
             }
-            
-            for(unsigned int i = 0; i < vertices.size(); i+=3) {
-                if(i+2 >= vertices.size()) break;
-                
-                glm::vec3 v0 = vertices[i].Position;
-                glm::vec3 v1 = vertices[i+1].Position;
-                glm::vec3 v2 = vertices[i+2].Position;
-                
-                glm::vec2 uv0 = vertices[i].TexCoords;
-                glm::vec2 uv1 = vertices[i+1].TexCoords;
-                glm::vec2 uv2 = vertices[i+2].TexCoords;
-                
-                glm::vec3 deltaPos1 = v1-v0;
-                glm::vec3 deltaPos2 = v2-v0;
-                
-                glm::vec2 deltaUV1 = uv1-uv0;
-                glm::vec2 deltaUV2 = uv2-uv0;
-                
-                float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-                glm::vec3 tangent = (deltaPos1 * deltaUV2.y   - deltaPos2 * deltaUV1.y)*r;
-                glm::vec3 bitangent = (deltaPos2 * deltaUV1.x   - deltaPos1 * deltaUV2.x)*r;
-                
-                vertices[i].Tangent = tangent;
-                vertices[i].Bitangent = bitangent;
-                vertices[i+1].Tangent = tangent;
-                vertices[i+1].Bitangent = bitangent;
-                vertices[i+2].Tangent = tangent;
-                vertices[i+2].Bitangent = bitangent;
+        };
+        if (pool)
+            pool->parallelFor(0, cornerCount / 3, 16384, faces);
+        else
+            faces(0, cornerCount / 3);
+
+        // Corners that share a frame end up next to each other
+        vector<unsigned int> order(cornerCount);
+        for (size_t c = 0; c < cornerCount; c++)
+            order[c] = (unsigned int)c;
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            if (cornerMirrored[a] != cornerMirrored[b])
+                return cornerMirrored[a] < cornerMirrored[b];
+            const Vertex &va = vertices[indices[a]], &vb = vertices[indices[b]];
+            int cmp = std::memcmp(&va.Position, &vb.Position, sizeof(glm::vec3));
+            if (cmp == 0)
+                cmp = std::memcmp(&va.Normal, &vb.Normal, sizeof(glm::vec3));
+            if (cmp == 0)
+                cmp = std::memcmp(&va.TexCoords, &vb.TexCoords, sizeof(glm::vec2));
+            return cmp != 0 ? cmp < 0 : a < b;
+        });
+        vector<size_t> groupStart;
+        for (size_t i = 0; i < cornerCount; i++) {
+            if (i == 0 || cornerMirrored[order[i]] != cornerMirrored[order[i-1]] ||
+                !sameSurfacePoint(vertices[indices[order[i]]], vertices[indices[order[i-1]]]))
+                groupStart.push_back(i);
+        }
+        groupStart.push_back(cornerCount);
+        size_t groupCount = groupStart.size() - 1;
+
+        // A vertex keeps the frame of the first group that reaches it, later
+        // groups get a copy of it
+        vector<unsigned char> claimed(vertices.size(), 0);
+        vector<std::pair<unsigned int, unsigned int>> remap; // vertex -> vertex used by this group
+        for (size_t g = 0; g < groupCount; g++) {
+            remap.clear();
+            for (size_t i = groupStart[g]; i < groupStart[g+1]; i++) {
+                unsigned int &index = indices[order[i]];
+                size_t r = 0;
+                while (r < remap.size() && remap[r].first != index)
+                    r++;
+                if (r < remap.size()) {
+                    index = remap[r].second;
+                } else if (!claimed[index]) {
+                    claimed[index] = 1;
+                    remap.push_back(std::make_pair(index, index));
+                } else {
+                    unsigned int split = (unsigned int)vertices.size();
+                    vertices.push_back(vertices[index]);
+                    remap.push_back(std::make_pair(index, split));
+                    index = split;
+                }
             }
-            
-            for(unsigned int i = 0; i < vertices.size(); i++) {
-                indices.push_back(i);
+        }
+
+        auto groups = [&](size_t begin, size_t end) {
+            for (size_t g = begin; g < end; g++) {
+                glm::vec3 tangent(0.0f), bitangent(0.0f);
+                for (size_t i = groupStart[g]; i < groupStart[g+1]; i++) {
+                    tangent += cornerTangent[order[i]];
+                    bitangent += cornerBitangent[order[i]];
+                }
+                const glm::vec3 &n = vertices[indices[order[groupStart[g]]]].Normal;
+                glm::vec3 t = safeNormalize(tangent - n * glm::dot(n, tangent));
+                if (t == glm::vec3(0.0f))
+                    t = anyPerpendicular(n);
+                float w = glm::dot(glm::cross(n, t), bitangent) < 0.0f ? -1.0f : 1.0f;
+                for (size_t i = groupStart[g]; i < groupStart[g+1]; i++)
+                    vertices[indices[order[i]]].Tangent = glm::vec4(t, w);
             }
-            
-            Mesh mesh(vertices, indices, textures_loaded);
-            meshes.push_back(mesh);
+        };
+        if (pool)
+            pool->parallelFor(0, groupCount, 16384, groups);
+        else
+            groups(0, groupCount);
+    }
+
+    // Merges bit-identical vertices. Vertices are renumbered in order of
+    // first use so the index stream walks the vertex buffer forwards.
+    static void weldVertices(MeshData &mesh) {
+        struct VertexHash {
+            size_t operator()(const Vertex &v) const {
+                const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+                size_t hash = 14695981039346656037ull;
+                for (size_t i = 0; i < sizeof(Vertex); i++)
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+                return hash;
+            }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+        };
+        unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+        unique.reserve(mesh.vertices.size());
+        vector<Vertex> welded;
+        welded.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices) {
+            std::pair<unordered_map<Vertex, unsigned int, VertexHash, VertexEqual>::iterator, bool> inserted =
+                unique.insert(std::make_pair(mesh.vertices[index], (unsigned int)welded.size()));
+            if (inserted.second)
+                welded.push_back(mesh.vertices[index]);
+            index = inserted.first->second;
+        }
+        mesh.vertices.swap(welded);
+    }
+
+    // Reorders triangles for the post-transform vertex cache (Forsyth's
+    // linear-speed algorithm): each step emits the best scored triangle
+    // among those touching the simulated cache, favouring recently used
+    // vertices and vertices with few triangles left. Offline step, see
+    // tools/pbr_cook.cpp.
+    static void optimizeVertexCache(MeshData &mesh) {
+        const int CACHE_SIZE = 32;
+        size_t vertexCount = mesh.vertices.size();
+        size_t triangleCount = mesh.indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // Triangles of each vertex
+        vector<unsigned int> remaining(vertexCount, 0), adjacencyStart(vertexCount + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            remaining[mesh.indices[i]]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+        vector<unsigned int> adjacency(adjacencyStart[vertexCount]), filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int c = 0; c < 3; c++)
+                adjacency[filled[mesh.indices[3 * t + c]]++] = (unsigned int)t;
+
+        auto vertexScore = [&](int cachePosition, unsigned int valence) {
+            if (valence == 0)
+                return -1.0f;
+            float score = 0.0f;
+            if (cachePosition >= 0)
+                score = cachePosition < 3 ? 0.75f
+                                          : std::pow(1.0f - (cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+            return score + 2.0f / std::sqrt((float)valence);
+        };
+
+        vector<int> cachePosition(vertexCount, -1);
+        vector<float> score(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            score[v] = vertexScore(-1, remaining[v]);
+        vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = score[mesh.indices[3 * t]] + score[mesh.indices[3 * t + 1]] + score[mesh.indices[3 * t + 2]];
+        vector<unsigned char> emitted(triangleCount, 0);
+
+        vector<unsigned int> cache, nextCache, output;
+        output.reserve(triangleCount * 3);
+        size_t scanCursor = 0;
+        long best = -1;
+        for (size_t step = 0; step < triangleCount; step++) {
+            // Nothing in the cache scores: take the next unemitted triangle
+            if (best < 0) {
+                while (emitted[scanCursor])
+                    scanCursor++;
+                best = (long)scanCursor;
+            }
+            emitted[best] = 1;
+            const unsigned int *triangle = &mesh.indices[3 * best];
+            output.insert(output.end(), triangle, triangle + 3);
+
+            // Emitted vertices go to the front of the cache
+            nextCache.clear();
+            for (int c = 0; c < 3; c++)
+                if (std::find(nextCache.begin(), nextCache.end(), triangle[c]) == nextCache.end())
+                    nextCache.push_back(triangle[c]);
+            for (unsigned int v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    nextCache.push_back(v);
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = triangle[c];
+                unsigned int *begin = &adjacency[adjacencyStart[v]];
+                unsigned int *end = begin + remaining[v];
+                *std::find(begin, end, (unsigned int)best) = *(end - 1);
+                remaining[v]--;
+            }
+            for (size_t i = 0; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+
+            // Rescore the cached vertices and their triangles, pick the best
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : nextCache) {
+                float newScore = vertexScore(cachePosition[v], remaining[v]);
+                float delta = newScore - score[v];
+                score[v] = newScore;
+                for (unsigned int a = adjacencyStart[v]; a < adjacencyStart[v] + remaining[v]; a++) {
+                    unsigned int t = adjacency[a];
+                    triangleScore[t] += delta;
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            if (nextCache.size() > (size_t)CACHE_SIZE)
+                nextCache.resize(CACHE_SIZE);
+            cache.swap(nextCache);
         }
+        mesh.indices.swap(output);
+    }
+
+    // Renumbers vertices in order of first use by the index stream, so
+    // vertex fetch walks the buffer forwards (run after reordering triangles)
+    static void optimizeVertexFetch(MeshData &mesh) {
+        vector<unsigned int> remap(mesh.vertices.size(), UINT_MAX);
+        vector<Vertex> ordered;
+        ordered.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices) {
+            if (remap[index] == UINT_MAX) {
+                remap[index] = (unsigned int)ordered.size();
+                ordered.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices.swap(ordered);
+    }
+
+    // All CPU stages: streamed parse (welded as it goes), tangents,
+    // bounds. parseObj/expandVertices/weldVertices are the tinyobj way
+    // of getting the same meshes, kept for comparison.
+    static bool loadData(string const &path, ModelData &data, ThreadPool *pool = nullptr) {
+        ObjStreamReader reader(pool);
+        if (!reader.load(path, data.meshes))
+            return false;
+        finishData(path, data, pool);
+        return true;
+    }
+
+    // Same from OBJ text in memory, path only sets the directory
+    static bool loadData(const char *bytes, size_t size, string const &path, ModelData &data,
+                         ThreadPool *pool = nullptr) {
+        ObjStreamReader reader(pool);
+        if (!reader.load(bytes, size, data.meshes))
+            return false;
+        finishData(path, data, pool);
+        return true;
+    }
+
+    // sqrt(UV area / surface area) over all triangles
+    static float computeUvDensity(const vector<MeshData> &meshes) {
+        double surface = 0.0, uvArea = 0.0;
+        for (const MeshData &mesh : meshes) {
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                const Vertex &a = mesh.vertices[mesh.indices[i]];
+                const Vertex &b = mesh.vertices[mesh.indices[i + 1]];
+                const Vertex &c = mesh.vertices[mesh.indices[i + 2]];
+                surface += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+                glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+                uvArea += std::fabs(u.x * v.y - u.y * v.x);
+            }
+        }
+        return surface > 0.0 ? (float)std::sqrt(uvArea / surface) : 0.0f;
+    }
+
+private:
+    static void finishData(string const &path, ModelData &data, ThreadPool *pool) {
+        data.directory = path.substr(0, path.find_last_of('/'));
+        for (MeshData &mesh : data.meshes) {
+            computeTangents(mesh, pool);
+            for (const Vertex &vertex : mesh.vertices)
+                data.bounds.expand(vertex.Position);
+        }
+        data.uvDensity = computeUvDensity(data.meshes);
+    }
+
+    static glm::vec3 safeNormalize(const glm::vec3 &v) {
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : glm::vec3(0.0f);
+    }
+
+    static glm::vec3 anyPerpendicular(const glm::vec3 &n) {
+        glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 t = safeNormalize(glm::cross(n, axis));
+        return t == glm::vec3(0.0f) ? axis : t;
+    }
+
+    static bool sameSurfacePoint(const Vertex &a, const Vertex &b) {
+        return std::memcmp(&a.Position, &b.Position, sizeof(glm::vec3)) == 0 &&
+               std::memcmp(&a.Normal, &b.Normal, sizeof(glm::vec3)) == 0 &&
+               std::memcmp(&a.TexCoords, &b.TexCoords, sizeof(glm::vec2)) == 0;
+    }
+
+    void upload(const ModelData &data) {
+        directory = data.directory;
+        bounds = data.bounds;
+        uvDensity = data.uvDensity;
+        meshes.reserve(data.meshes.size());
+        for (const MeshData &mesh : data.meshes)
+            meshes.push_back(Mesh(mesh.vertices, mesh.indices, textures_loaded));
     }
 };
 
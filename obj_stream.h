@@ -0,0 +1,432 @@
+#ifndef OBJ_STREAM_H
+#define OBJ_STREAM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+// OBJ reader for files too big to go through tinyobj. The file is memory
+// mapped and cut into CHUNK_BYTES pieces at line breaks; workers parse
+// the pieces (numbers, face corners) while the calling thread merges
+// finished ones in file order, welding every v/vt/vn triplet straight
+// into an indexed mesh. Only a window of chunks is in flight and merged
+// pages of the mapping are released, so besides the v/vt/vn arrays and
+// the output the memory used does not grow with the file. Like
+// Model::loadData with tinyobj, every o/g group with faces becomes one
+// MeshData; materials and other statements are skipped and Tangent is
+// left zero.
+class ObjStreamReader {
+public:
+    static const size_t CHUNK_BYTES = 4 << 20;
+
+    explicit ObjStreamReader(ThreadPool *pool = nullptr) : m_Pool(pool), m_NewMesh(true), m_Lines(0) {}
+
+    bool load(const std::string &path, std::vector<MeshData> &meshes) {
+        if (!m_File.open(path))
+            return false;
+        return load(m_File.data(), m_File.size(), meshes);
+    }
+
+    // OBJ text already in memory (an asset pack entry). Pages are only
+    // released for the file mapping load(path) made.
+    bool load(const char *data, size_t size, std::vector<MeshData> &meshes) {
+        PROFILE_SCOPE("stream obj");
+        const char *at = data;
+        const char *end = at + size;
+        size_t window = m_Pool ? 2 * (m_Pool->size() + 1) : 1;
+
+        std::deque<std::pair<std::unique_ptr<Chunk>, std::future<void>>> pending;
+        bool ok = true;
+        while (ok && (at < end || !pending.empty())) {
+            while (at < end && pending.size() < window) {
+                std::unique_ptr<Chunk> chunk(new Chunk());
+                chunk->begin = at;
+                at = end - at > (ptrdiff_t)CHUNK_BYTES ? at + CHUNK_BYTES : end;
+                const char *newline = (const char *)std::memchr(at, '\n', end - at);
+                at = newline ? newline + 1 : end;
+                chunk->end = at;
+                Chunk *raw = chunk.get();
+                std::future<void> done;
+                if (m_Pool) {
+                    done = m_Pool->enqueue([raw] { parseChunk(*raw); });
+                } else {
+                    parseChunk(*raw);
+                }
+                pending.push_back(std::make_pair(std::move(chunk), std::move(done)));
+            }
+            if (m_Pool)
+                m_Pool->wait(pending.front().second);
+            Chunk &chunk = *pending.front().first;
+            ok = merge(chunk, meshes);
+            if (data == m_File.data())
+                m_File.release(chunk.begin - data, chunk.end - chunk.begin);
+            pending.pop_front();
+        }
+        // Workers may still hold chunks that point into the mapping
+        for (std::pair<std::unique_ptr<Chunk>, std::future<void>> &chunk : pending)
+            if (m_Pool)
+                m_Pool->wait(chunk.second);
+        return ok && buildVertices(meshes);
+    }
+
+private:
+    // Corner indices are stored 0-based. Negative OBJ indices count back
+    // from the attributes seen so far, which a worker only knows within
+    // its own chunk: those are kept chunk relative, biased by RELATIVE,
+    // and rebased during the merge.
+    static const int64_t MISSING = INT64_MIN;
+    static const int64_t RELATIVE = (int64_t)1 << 40;
+
+    struct Chunk {
+        const char *begin, *end;
+        std::vector<float> positions, texCoords, normals;
+        std::vector<int64_t> corners; // v, vt, vn per corner
+        std::vector<uint32_t> faceSizes;
+        std::vector<size_t> groupStarts; // faces before an o/g line
+        size_t lines = 0;
+        size_t errorLine = 0; // 1-based within the chunk, 0 if none
+    };
+
+    // Unique v/vt/vn triplet, UINT32_MAX when vt or vn is missing
+    struct Key {
+        uint32_t v, vt, vn;
+    };
+
+    ThreadPool *m_Pool;
+    MappedFile m_File;
+    std::vector<float> m_Positions, m_TexCoords, m_Normals;
+    std::vector<std::vector<Key>> m_MeshKeys;
+    std::vector<uint32_t> m_Slots; // open addressing, key index + 1
+    std::vector<uint32_t> m_Face;
+    bool m_NewMesh;
+    size_t m_Lines;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    static void skipSpace(const char *&p, const char *end) {
+        while (p < end && isSpace(*p))
+            ++p;
+    }
+
+    // Decimal float without locale or strtod; the first 19 significant
+    // digits are kept, which is more than a float holds
+    static bool parseFloat(const char *&p, const char *end, float &out) {
+        static const double POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        skipSpace(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; p < end && isDigit(*p); ++p, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            } else {
+                ++exponent;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && isDigit(*p); ++p, any = true) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+            }
+        }
+        if (!any)
+            return false;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negativeExponent = *p++ == '-';
+            if (p >= end || !isDigit(*p))
+                return false;
+            int e = 0;
+            for (; p < end && isDigit(*p); ++p)
+                e = std::min(e * 10 + (*p - '0'), 10000);
+            exponent += negativeExponent ? -e : e;
+        }
+        double value = (double)mantissa;
+        if (exponent >= -22 && exponent <= 22)
+            value = exponent < 0 ? value / POWERS[-exponent] : value * POWERS[exponent];
+        else
+            value *= std::pow(10.0, exponent);
+        out = (float)(negative ? -value : value);
+        return true;
+    }
+
+    static bool parseIndex(const char *&p, const char *end, int64_t &out) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p >= end || !isDigit(*p))
+            return false;
+        int64_t value = 0;
+        for (; p < end && isDigit(*p); ++p)
+            value = std::min<int64_t>(value * 10 + (*p - '0'), UINT32_MAX);
+        out = negative ? -value : value;
+        return true;
+    }
+
+    // false on a malformed line
+    static bool parseLine(Chunk &chunk, const char *p, const char *end) {
+        skipSpace(p, end);
+        const char *keyword = p;
+        while (p < end && !isSpace(*p))
+            ++p;
+        size_t length = p - keyword;
+        if (length == 0)
+            return true;
+        if (length == 1 && (keyword[0] == 'o' || keyword[0] == 'g')) {
+            chunk.groupStarts.push_back(chunk.faceSizes.size());
+            return true;
+        }
+        if (keyword[0] == 'v' && (length == 1 || (length == 2 && (keyword[1] == 't' || keyword[1] == 'n')))) {
+            std::vector<float> &target = length == 1 ? chunk.positions
+                                         : keyword[1] == 't' ? chunk.texCoords : chunk.normals;
+            int count = length == 2 && keyword[1] == 't' ? 2 : 3;
+            float value[3] = {0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < count; ++i) {
+                // vt may have a single coordinate
+                skipSpace(p, end);
+                if (i == 1 && count == 2 && p == end)
+                    break;
+                if (!parseFloat(p, end, value[i]))
+                    return false;
+            }
+            target.insert(target.end(), value, value + count);
+            return true;
+        }
+        if (length != 1 || keyword[0] != 'f')
+            return true;
+
+        int64_t counts[3] = {(int64_t)chunk.positions.size() / 3, (int64_t)chunk.texCoords.size() / 2,
+                             (int64_t)chunk.normals.size() / 3};
+        size_t first = chunk.corners.size();
+        for (;;) {
+            skipSpace(p, end);
+            if (p >= end)
+                break;
+            int64_t raw[3] = {0, 0, 0};
+            if (!parseIndex(p, end, raw[0]))
+                return false;
+            if (p < end && *p == '/') {
+                ++p;
+                if (p < end && *p != '/' && !parseIndex(p, end, raw[1]))
+                    return false;
+                if (p < end && *p == '/') {
+                    ++p;
+                    if (!parseIndex(p, end, raw[2]))
+                        return false;
+                }
+            }
+            if (raw[0] == 0 || (p < end && !isSpace(*p)))
+                return false;
+            for (int k = 0; k < 3; ++k) {
+                if (raw[k] > 0)
+                    chunk.corners.push_back(raw[k] - 1);
+                else if (raw[k] < 0)
+                    chunk.corners.push_back(counts[k] + raw[k] - RELATIVE);
+                else
+                    chunk.corners.push_back(int64_t(MISSING));
+            }
+        }
+        size_t size = (chunk.corners.size() - first) / 3;
+        // Points and edges are not drawn
+        if (size < 3)
+            chunk.corners.resize(first);
+        else
+            chunk.faceSizes.push_back((uint32_t)size);
+        return true;
+    }
+
+    static void parseChunk(Chunk &chunk) {
+        const char *p = chunk.begin;
+        while (p < chunk.end) {
+            const char *lineEnd = (const char *)std::memchr(p, '\n', chunk.end - p);
+            if (!lineEnd)
+                lineEnd = chunk.end;
+            ++chunk.lines;
+            // Comments can hold anything
+            const char *hash = (const char *)std::memchr(p, '#', lineEnd - p);
+            if (!parseLine(chunk, p, hash ? hash : lineEnd) && chunk.errorLine == 0)
+                chunk.errorLine = chunk.lines;
+            p = lineEnd + 1;
+        }
+    }
+
+    static uint32_t hashKey(const Key &key) {
+        uint32_t h = key.v * 0x9E3779B1u ^ key.vt * 0x85EBCA77u ^ key.vn * 0xC2B2AE3Du;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        return h ^ (h >> 12);
+    }
+
+    static bool sameKey(const Key &a, const Key &b) { return a.v == b.v && a.vt == b.vt && a.vn == b.vn; }
+
+    // Index of the key in the current mesh, adding it if new
+    uint32_t weld(const Key &key) {
+        std::vector<Key> &keys = m_MeshKeys.back();
+        if ((keys.size() + 1) * 2 > m_Slots.size()) {
+            m_Slots.assign(std::max<size_t>(m_Slots.size() * 2, 1024), 0);
+            size_t mask = m_Slots.size() - 1;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                size_t slot = hashKey(keys[i]) & mask;
+                while (m_Slots[slot])
+                    slot = (slot + 1) & mask;
+                m_Slots[slot] = (uint32_t)i + 1;
+            }
+        }
+        size_t mask = m_Slots.size() - 1;
+        size_t slot = hashKey(key) & mask;
+        while (m_Slots[slot]) {
+            if (sameKey(keys[m_Slots[slot] - 1], key))
+                return m_Slots[slot] - 1;
+            slot = (slot + 1) & mask;
+        }
+        keys.push_back(key);
+        m_Slots[slot] = (uint32_t)keys.size();
+        return (uint32_t)keys.size() - 1;
+    }
+
+    bool resolve(int64_t value, int64_t base, uint32_t &out) const {
+        if (value == MISSING) {
+            out = UINT32_MAX;
+            return true;
+        }
+        if (value < 0)
+            value += RELATIVE + base;
+        out = (uint32_t)value;
+        return value >= 0 && value < UINT32_MAX;
+    }
+
+    float diagonal(uint32_t a, uint32_t b) const {
+        const std::vector<Key> &keys = m_MeshKeys.back();
+        glm::vec3 d(0.0f);
+        for (int c = 0; c < 3; ++c)
+            d[c] = m_Positions[3 * keys[a].v + c] - m_Positions[3 * keys[b].v + c];
+        return glm::dot(d, d);
+    }
+
+    bool merge(Chunk &chunk, std::vector<MeshData> &meshes) {
+        if (chunk.errorLine) {
+            std::cout << "ERROR::OBJ_STREAM::PARSE_FAILED line " << m_Lines + chunk.errorLine << std::endl;
+            return false;
+        }
+        m_Lines += chunk.lines;
+        int64_t base[3] = {(int64_t)m_Positions.size() / 3, (int64_t)m_TexCoords.size() / 2,
+                           (int64_t)m_Normals.size() / 3};
+        m_Positions.insert(m_Positions.end(), chunk.positions.begin(), chunk.positions.end());
+        m_TexCoords.insert(m_TexCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        m_Normals.insert(m_Normals.end(), chunk.normals.begin(), chunk.normals.end());
+        size_t positionCount = m_Positions.size() / 3;
+
+        const int64_t *corner = chunk.corners.data();
+        size_t nextGroup = 0;
+        for (size_t f = 0; f < chunk.faceSizes.size(); ++f) {
+            for (; nextGroup < chunk.groupStarts.size() && chunk.groupStarts[nextGroup] <= f; ++nextGroup)
+                m_NewMesh = true;
+            if (m_NewMesh) {
+                meshes.push_back(MeshData());
+                m_MeshKeys.push_back(std::vector<Key>());
+                m_Slots.clear();
+                m_NewMesh = false;
+            }
+            m_Face.clear();
+            bool known = true;
+            for (uint32_t c = 0; c < chunk.faceSizes[f]; ++c, corner += 3) {
+                Key key;
+                if (!resolve(corner[0], base[0], key.v) || !resolve(corner[1], base[1], key.vt) ||
+                    !resolve(corner[2], base[2], key.vn)) {
+                    std::cout << "ERROR::OBJ_STREAM::INDEX_OUT_OF_RANGE" << std::endl;
+                    return false;
+                }
+                known = known && key.v < positionCount;
+                m_Face.push_back(weld(key));
+            }
+            std::vector<unsigned int> &indices = meshes.back().indices;
+            // Quads split along the shorter diagonal when their positions
+            // are already known (1-3 on a tie, as tinyobj does),
+            // everything else as a fan
+            if (m_Face.size() == 4 && known && !(diagonal(m_Face[0], m_Face[2]) < diagonal(m_Face[1], m_Face[3]))) {
+                const uint32_t quad[6] = {m_Face[0], m_Face[1], m_Face[3], m_Face[1], m_Face[2], m_Face[3]};
+                indices.insert(indices.end(), quad, quad + 6);
+                continue;
+            }
+            for (size_t c = 2; c < m_Face.size(); ++c) {
+                indices.push_back(m_Face[0]);
+                indices.push_back(m_Face[c - 1]);
+                indices.push_back(m_Face[c]);
+            }
+        }
+        for (; nextGroup < chunk.groupStarts.size(); ++nextGroup)
+            m_NewMesh = true;
+        return true;
+    }
+
+    // Attributes can be referenced before they are defined, so vertices
+    // are only filled in once the whole file is read
+    bool buildVertices(std::vector<MeshData> &meshes) {
+        size_t positionCount = m_Positions.size() / 3;
+        size_t texCoordCount = m_TexCoords.size() / 2;
+        size_t normalCount = m_Normals.size() / 3;
+        std::atomic<bool> ok(true);
+        for (size_t m = 0; m < meshes.size(); ++m) {
+            const std::vector<Key> &keys = m_MeshKeys[m];
+            std::vector<Vertex> &vertices = meshes[m].vertices;
+            vertices.resize(keys.size());
+            auto fill = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const Key &key = keys[i];
+                    Vertex &vertex = vertices[i];
+                    if (key.v >= positionCount || (key.vt != UINT32_MAX && key.vt >= texCoordCount) ||
+                        (key.vn != UINT32_MAX && key.vn >= normalCount)) {
+                        ok = false;
+                        continue;
+                    }
+                    vertex.Position = glm::vec3(m_Positions[3 * key.v], m_Positions[3 * key.v + 1],
+                                                m_Positions[3 * key.v + 2]);
+                    vertex.Normal = key.vn == UINT32_MAX ? glm::vec3(0.0f)
+                                                         : glm::vec3(m_Normals[3 * key.vn], m_Normals[3 * key.vn + 1],
+                                                                     m_Normals[3 * key.vn + 2]);
+                    vertex.TexCoords = key.vt == UINT32_MAX
+                                           ? glm::vec2(0.0f)
+                                           : glm::vec2(m_TexCoords[2 * key.vt], m_TexCoords[2 * key.vt + 1]);
+                    vertex.Tangent = glm::vec4(0.0f);
+                }
+            };
+            if (m_Pool)
+                m_Pool->parallelFor(0, keys.size(), 16384, fill);
+            else
+                fill(0, keys.size());
+            std::vector<Key>().swap(m_MeshKeys[m]);
+        }
+        if (!ok)
+            std::cout << "ERROR::OBJ_STREAM::INDEX_OUT_OF_RANGE" << std::endl;
+        return ok;
+    }
+};
+
+#endif
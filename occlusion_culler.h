@@ -0,0 +1,395 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_SIMD 1
+#endif
+
+#include "bounds.h"
+#include "model.h"
+#include "scene_objects.h"
+#include "thread_pool.h"
+
+// Cut-down copy of a model for the occlusion rasterizer: its largest
+// triangles only, as a flat position list. Any subset of the real
+// triangles hides less than the model does, so culling stays conservative.
+struct OccluderMesh {
+    std::vector<glm::vec3> triangles;
+
+    OccluderMesh() {}
+
+    explicit OccluderMesh(const Model &model, size_t maxTriangles = 2048) {
+        struct Candidate {
+            float area;
+            glm::vec3 v[3];
+        };
+        std::vector<Candidate> candidates;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (const Mesh &mesh : model.meshes) {
+            mesh.getGeometry(vertices, indices);
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                Candidate c;
+                for (int k = 0; k < 3; ++k)
+                    c.v[k] = vertices[indices[i + k]].Position;
+                c.area = glm::length(glm::cross(c.v[1] - c.v[0], c.v[2] - c.v[0]));
+                if (c.area > 0.0f)
+                    candidates.push_back(c);
+            }
+        }
+        if (candidates.size() > maxTriangles) {
+            std::nth_element(candidates.begin(), candidates.begin() + maxTriangles, candidates.end(),
+                             [](const Candidate &a, const Candidate &b) { return a.area > b.area; });
+            candidates.resize(maxTriangles);
+        }
+        for (const Candidate &c : candidates)
+            triangles.insert(triangles.end(), c.v, c.v + 3);
+    }
+
+    size_t triangleCount() const { return triangles.size() / 3; }
+};
+
+// Software occlusion culling on the CPU. Occluder meshes are rasterized
+// into a small depth buffer, then every visible object's bounds are tested
+// against a hierarchical (8x8 block) version of it before it is drawn.
+//
+// Depth is stored as 1/w, which is affine in screen space and needs no
+// clear value tricks: 0 is infinitely far, larger is nearer. Rasterizing
+// runs in two parallel phases: setup jobs transform, clip and bin the
+// triangles into 32x32 tiles, then each tile is rasterized by one task
+// (four pixels at a time with SSE) with no sharing between tasks.
+class OcclusionCuller {
+public:
+    static const int WIDTH = 320;
+    static const int HEIGHT = 192;
+    static const int TILE_SIZE = 32;
+    static const int TILES_X = WIDTH / TILE_SIZE;
+    static const int TILES_Y = HEIGHT / TILE_SIZE;
+    static const int TILE_COUNT = TILES_X * TILES_Y;
+    static const int BLOCK_SIZE = 8;
+    static const int BLOCKS_X = WIDTH / BLOCK_SIZE;
+    static const int BLOCKS_Y = HEIGHT / BLOCK_SIZE;
+    static const int SETUP_JOBS = 8;
+    static_assert(TILE_SIZE % BLOCK_SIZE == 0 && BLOCK_SIZE % 4 == 0, "tiles hold whole blocks of 4-wide spans");
+
+    OcclusionCuller() : m_TriangleCount(0), m_Depth(WIDTH * HEIGHT, 0.0f), m_HiZ(BLOCKS_X * BLOCKS_Y, 0.0f),
+                        m_Tested(0), m_Culled(0) {}
+
+    // Rasterizes the occluders among the visible objects, then removes the
+    // objects they hide from visible
+    void cull(const Scene &scene, const glm::mat4 &viewProjection, std::vector<int> &visible,
+              ThreadPool *pool = nullptr) {
+        beginFrame(viewProjection);
+        for (int i : visible) {
+            const SceneObject &object = scene.objects[i];
+            if (object.occluder)
+                addOccluder(*object.occluder, object.getModelMatrix());
+        }
+        rasterize(pool);
+
+        m_Tested = (unsigned int)visible.size();
+        visible.erase(std::remove_if(visible.begin(), visible.end(),
+                                     [&](int i) { return !isVisible(scene.objects[i].worldBounds); }),
+                      visible.end());
+        m_Culled = m_Tested - (unsigned int)visible.size();
+    }
+
+    void beginFrame(const glm::mat4 &viewProjection) {
+        m_ViewProjection = viewProjection;
+        m_Occluders.clear();
+    }
+
+    void addOccluder(const OccluderMesh &mesh, const glm::mat4 &model) {
+        if (!mesh.triangles.empty())
+            m_Occluders.push_back(Occluder{&mesh, m_ViewProjection * model});
+    }
+
+    void rasterize(ThreadPool *pool = nullptr) {
+        // Triangle ranges per occluder, so setup jobs can split evenly
+        m_FirstTriangle.resize(m_Occluders.size() + 1);
+        m_FirstTriangle[0] = 0;
+        for (size_t i = 0; i < m_Occluders.size(); ++i)
+            m_FirstTriangle[i + 1] = m_FirstTriangle[i] + m_Occluders[i].mesh->triangleCount();
+        m_TriangleCount = m_FirstTriangle.back();
+
+        auto setup = [this](size_t b, size_t e) {
+            for (size_t job = b; job < e; ++job)
+                setupTriangles((int)job);
+        };
+        auto raster = [this](size_t b, size_t e) {
+            for (size_t tile = b; tile < e; ++tile)
+                rasterizeTile((int)tile);
+        };
+        if (pool) {
+            pool->parallelFor(0, SETUP_JOBS, 1, setup);
+            pool->parallelFor(0, TILE_COUNT, 1, raster);
+        } else {
+            setup(0, SETUP_JOBS);
+            raster(0, TILE_COUNT);
+        }
+    }
+
+    // False only when the box is certainly behind the rasterized occluders
+    bool isVisible(const AABB &box) const {
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+        float nearest = 0.0f;
+        for (int i = 0; i < 8; ++i) {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                             (i & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+            // Touches the near plane, can't be behind anything
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+                return true;
+            float invW = 1.0f / clip.w;
+            float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+            float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::max(nearest, invW);
+        }
+
+        int bx0 = std::max(0, (int)std::floor(minX) / BLOCK_SIZE);
+        int by0 = std::max(0, (int)std::floor(minY) / BLOCK_SIZE);
+        int bx1 = std::min(BLOCKS_X - 1, (int)std::floor(maxX) / BLOCK_SIZE);
+        int by1 = std::min(BLOCKS_Y - 1, (int)std::floor(maxY) / BLOCK_SIZE);
+        if (maxX < 0.0f || maxY < 0.0f || bx0 > bx1 || by0 > by1)
+            return true; // Off screen, that's the frustum's call
+
+        // Visible as soon as one block has something farther than the box
+        for (int by = by0; by <= by1; ++by)
+            for (int bx = bx0; bx <= bx1; ++bx)
+                if (m_HiZ[by * BLOCKS_X + bx] <= nearest)
+                    return true;
+        return false;
+    }
+
+    unsigned int getTriangleCount() const { return (unsigned int)m_TriangleCount; }
+    unsigned int getTestedCount() const { return m_Tested; }
+    unsigned int getCulledCount() const { return m_Culled; }
+
+    // 1/w per pixel, row 0 at the bottom
+    const std::vector<float> &getDepthBuffer() const { return m_Depth; }
+
+private:
+    struct Occluder {
+        const OccluderMesh *mesh;
+        glm::mat4 mvp;
+    };
+
+    // Edge functions (inside when all >= 0) and depth plane in pixel space.
+    // crossSlope/crossOffset give the x where each edge crosses a row.
+    struct SetupTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float crossSlope[3], crossOffset[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    glm::mat4 m_ViewProjection;
+    std::vector<Occluder> m_Occluders;
+    std::vector<size_t> m_FirstTriangle;
+    size_t m_TriangleCount;
+
+    std::vector<SetupTriangle> m_Setup[SETUP_JOBS];
+    std::vector<uint32_t> m_Bins[SETUP_JOBS][TILE_COUNT];
+
+    std::vector<float> m_Depth;
+    std::vector<float> m_HiZ;
+    unsigned int m_Tested, m_Culled;
+
+    void setupTriangles(int job) {
+        std::vector<SetupTriangle> &setup = m_Setup[job];
+        setup.clear();
+        for (int t = 0; t < TILE_COUNT; ++t)
+            m_Bins[job][t].clear();
+
+        size_t begin = m_TriangleCount * job / SETUP_JOBS;
+        size_t end = m_TriangleCount * (job + 1) / SETUP_JOBS;
+        if (begin == end)
+            return;
+        size_t occluder = std::upper_bound(m_FirstTriangle.begin(), m_FirstTriangle.end(), begin) -
+                          m_FirstTriangle.begin() - 1;
+
+        for (size_t t = begin; t < end; ++t) {
+            while (t >= m_FirstTriangle[occluder + 1])
+                occluder++;
+            const Occluder &o = m_Occluders[occluder];
+            const glm::vec3 *v = &o.mesh->triangles[(t - m_FirstTriangle[occluder]) * 3];
+
+            glm::vec4 clip[3] = {o.mvp * glm::vec4(v[0], 1.0f), o.mvp * glm::vec4(v[1], 1.0f),
+                                 o.mvp * glm::vec4(v[2], 1.0f)};
+
+            // Clip against the near plane (z >= -w), leaves up to 4 vertices
+            glm::vec4 poly[4];
+            int count = 0;
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec4 &a = clip[i];
+                const glm::vec4 &b = clip[(i + 1) % 3];
+                float da = a.z + a.w;
+                float db = b.z + b.w;
+                if (da >= 0.0f)
+                    poly[count++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f))
+                    poly[count++] = a + (b - a) * (da / (da - db));
+            }
+            for (int i = 1; i + 1 < count; ++i)
+                addTriangle(job, poly[0], poly[i], poly[i + 1]);
+        }
+    }
+
+    void addTriangle(int job, const glm::vec4 &c0, const glm::vec4 &c1, const glm::vec4 &c2) {
+        glm::vec3 p[3];
+        const glm::vec4 *c[3] = {&c0, &c1, &c2};
+        for (int i = 0; i < 3; ++i) {
+            float invW = 1.0f / c[i]->w;
+            p[i] = glm::vec3((c[i]->x * invW * 0.5f + 0.5f) * WIDTH, (c[i]->y * invW * 0.5f + 0.5f) * HEIGHT, invW);
+        }
+
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if (std::abs(area) < 1e-6f)
+            return;
+        // Occluders are drawn two-sided, so just wind everything one way
+        if (area < 0.0f) {
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+
+        SetupTriangle tri;
+        float fMinX = std::min(p[0].x, std::min(p[1].x, p[2].x));
+        float fMaxX = std::max(p[0].x, std::max(p[1].x, p[2].x));
+        float fMinY = std::min(p[0].y, std::min(p[1].y, p[2].y));
+        float fMaxY = std::max(p[0].y, std::max(p[1].y, p[2].y));
+        if (fMaxX < 0.0f || fMaxY < 0.0f || fMinX >= WIDTH || fMinY >= HEIGHT)
+            return;
+        tri.minX = std::max(0, (int)fMinX);
+        tri.minY = std::max(0, (int)fMinY);
+        tri.maxX = std::min(WIDTH - 1, (int)fMaxX);
+        tri.maxY = std::min(HEIGHT - 1, (int)fMaxY);
+
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec3 &a = p[i];
+            const glm::vec3 &b = p[(i + 1) % 3];
+            tri.edgeA[i] = a.y - b.y;
+            tri.edgeB[i] = b.x - a.x;
+            tri.edgeC[i] = -(tri.edgeA[i] * a.x + tri.edgeB[i] * a.y);
+            if (tri.edgeA[i] != 0.0f) {
+                tri.crossSlope[i] = -tri.edgeB[i] / tri.edgeA[i];
+                tri.crossOffset[i] = -tri.edgeC[i] / tri.edgeA[i] - 0.5f;
+            }
+        }
+        tri.depthA = ((p[1].z - p[0].z) * (p[2].y - p[0].y) - (p[2].z - p[0].z) * (p[1].y - p[0].y)) / area;
+        tri.depthB = ((p[2].z - p[0].z) * (p[1].x - p[0].x) - (p[1].z - p[0].z) * (p[2].x - p[0].x)) / area;
+        tri.depthC = p[0].z - tri.depthA * p[0].x - tri.depthB * p[0].y;
+
+        uint32_t index = (uint32_t)m_Setup[job].size();
+        m_Setup[job].push_back(tri);
+        for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ++ty)
+            for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; ++tx)
+                m_Bins[job][ty * TILES_X + tx].push_back(index);
+    }
+
+    void rasterizeTile(int tile) {
+        int tileX = (tile % TILES_X) * TILE_SIZE;
+        int tileY = (tile / TILES_X) * TILE_SIZE;
+        for (int y = tileY; y < tileY + TILE_SIZE; ++y)
+            std::fill(&m_Depth[y * WIDTH + tileX], &m_Depth[y * WIDTH + tileX] + TILE_SIZE, 0.0f);
+
+        // Same order as setup, so results don't depend on thread timing
+        for (int job = 0; job < SETUP_JOBS; ++job)
+            for (uint32_t index : m_Bins[job][tile])
+                rasterizeTriangle(m_Setup[job][index], tileX, tileY);
+
+        // Hi-Z keeps the farthest depth of each block
+        for (int by = tileY / BLOCK_SIZE; by < (tileY + TILE_SIZE) / BLOCK_SIZE; ++by) {
+            for (int bx = tileX / BLOCK_SIZE; bx < (tileX + TILE_SIZE) / BLOCK_SIZE; ++bx) {
+                float farthest = FLT_MAX;
+                for (int y = by * BLOCK_SIZE; y < (by + 1) * BLOCK_SIZE; ++y) {
+                    const float *row = &m_Depth[y * WIDTH + bx * BLOCK_SIZE];
+                    for (int x = 0; x < BLOCK_SIZE; ++x)
+                        farthest = std::min(farthest, row[x]);
+                }
+                m_HiZ[by * BLOCKS_X + bx] = farthest;
+            }
+        }
+    }
+
+    void rasterizeTriangle(const SetupTriangle &tri, int tileX, int tileY) {
+        int minX = std::max(tri.minX, tileX);
+        int maxX = std::min(tri.maxX, tileX + TILE_SIZE - 1);
+        int y0 = std::max(tri.minY, tileY);
+        int y1 = std::min(tri.maxY, tileY + TILE_SIZE - 1);
+
+#ifdef OCCLUSION_SIMD
+        __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 a0 = _mm_set1_ps(tri.edgeA[0]), a1 = _mm_set1_ps(tri.edgeA[1]), a2 = _mm_set1_ps(tri.edgeA[2]);
+        __m128 za = _mm_set1_ps(tri.depthA);
+        __m128 zero = _mm_setzero_ps();
+#endif
+        for (int y = y0; y <= y1; ++y) {
+            float py = y + 0.5f;
+            // Pixels whose centres pass all three edges, from solving each
+            // edge equation for x on this row
+            float left = (float)minX;
+            float right = (float)maxX;
+            for (int i = 0; i < 3; ++i) {
+                float cross = tri.crossSlope[i] * py + tri.crossOffset[i];
+                if (tri.edgeA[i] > 0.0f)
+                    left = std::max(left, cross);
+                else if (tri.edgeA[i] < 0.0f)
+                    right = std::min(right, cross);
+                else if (tri.edgeB[i] * py + tri.edgeC[i] < 0.0f)
+                    right = -1.0f;
+            }
+            if (left > right)
+                continue;
+            // Both are >= 0 here, so truncation is floor
+            int spanLeft = (int)left;
+            spanLeft += spanLeft < left;
+            int spanRight = (int)right;
+            float *row = &m_Depth[y * WIDTH];
+
+#ifdef OCCLUSION_SIMD
+            // Spans start on a multiple of 4, so 4-wide steps never leave the
+            // tile; the edge test still masks the pixels outside the span
+            int x0 = spanLeft & ~3;
+            int x1 = spanRight;
+            __m128 b0 = _mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]);
+            __m128 b1 = _mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]);
+            __m128 b2 = _mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]);
+            __m128 zb = _mm_set1_ps(tri.depthB * py + tri.depthC);
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), b0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), b1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), b2);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                           _mm_cmpge_ps(e2, zero));
+                __m128 z = _mm_add_ps(_mm_mul_ps(za, px), zb);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_max_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = spanLeft; x <= spanRight; ++x) {
+                float px = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; ++i)
+                    inside = inside && tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i] >= 0.0f;
+                if (inside)
+                    row[x] = std::max(row[x], tri.depthA * px + tri.depthB * py + tri.depthC);
+            }
+#endif
+        }
+    }
+};
+
+#endif
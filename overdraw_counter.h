@@ -0,0 +1,100 @@
+#ifndef OVERDRAW_COUNTER_H
+#define OVERDRAW_COUNTER_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+// Counts fragments with GL_SAMPLES_PASSED occlusion queries around the
+// depth pre-pass and the PBR pass. Results are read a few frames late so
+// the CPU never waits on the GPU.
+//
+// With the pre-pass on, the pre-pass sample count is what the PBR pass
+// would have shaded without it (same draw order, same depth test), so
+// prepass / pbr is the overdraw the pre-pass removes. With it off, the
+// PBR count is the number of fragments actually shaded.
+class OverdrawCounter {
+public:
+    static const int FRAMES = 4;
+
+    OverdrawCounter() : m_Frame(0), m_PrepassSamples(0), m_ShadedSamples(0), m_HadPrepass(false) {
+        glGenQueries(FRAMES * 2, &m_Queries[0][0]);
+        for (int i = 0; i < FRAMES; ++i) {
+            m_Issued[i] = false;
+            m_Prepass[i] = false;
+        }
+    }
+
+    ~OverdrawCounter() { glDeleteQueries(FRAMES * 2, &m_Queries[0][0]); }
+
+    void beginPrepass() {
+        glBeginQuery(GL_SAMPLES_PASSED, m_Queries[slot()][0]);
+    }
+
+    void endPrepass() {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_Prepass[slot()] = true;
+    }
+
+    void beginShading() {
+        glBeginQuery(GL_SAMPLES_PASSED, m_Queries[slot()][1]);
+    }
+
+    void endShading() {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_Issued[slot()] = true;
+    }
+
+    // Call once per frame after the PBR pass
+    void endFrame() {
+        m_Frame++;
+        int oldest = slot();
+        if (!m_Issued[oldest])
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[oldest][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint shaded = 0;
+        glGetQueryObjectuiv(m_Queries[oldest][1], GL_QUERY_RESULT, &shaded);
+        m_ShadedSamples = shaded;
+        m_HadPrepass = m_Prepass[oldest];
+        if (m_HadPrepass) {
+            GLuint prepass = 0;
+            glGetQueryObjectuiv(m_Queries[oldest][0], GL_QUERY_RESULT, &prepass);
+            m_PrepassSamples = prepass;
+        }
+        m_Issued[oldest] = false;
+        m_Prepass[oldest] = false;
+    }
+
+    unsigned int getShadedSamples() const { return m_ShadedSamples; }
+
+    // Fragments that would reach the PBR shader without a pre-pass per
+    // fragment that reaches it with one. Only known while the pre-pass is on.
+    float getOverdraw() const {
+        if (!m_HadPrepass || m_ShadedSamples == 0)
+            return 0.0f;
+        return (float)m_PrepassSamples / (float)m_ShadedSamples;
+    }
+
+    void print(unsigned int screenPixels) const {
+        std::cout << "PBR fragments shaded: " << m_ShadedSamples << " ("
+                  << (float)m_ShadedSamples / screenPixels << " per pixel)";
+        if (m_HadPrepass)
+            std::cout << ", pre-pass removed overdraw x" << getOverdraw();
+        std::cout << std::endl;
+    }
+
+private:
+    unsigned int m_Queries[FRAMES][2];
+    bool m_Issued[FRAMES];
+    bool m_Prepass[FRAMES];
+    unsigned int m_Frame;
+    unsigned int m_PrepassSamples;
+    unsigned int m_ShadedSamples;
+    bool m_HadPrepass;
+
+    int slot() const { return m_Frame % FRAMES; }
+};
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU and GPU timing.
+//
+//   PROFILE_SCOPE("cull");       CPU time of the enclosing block, any thread
+//   PROFILE_GPU_SCOPE("shadows"); GPU time of the GL commands in the block
+//
+// GPU zones are pairs of GL_TIMESTAMP queries (they nest, unlike
+// GL_TIME_ELAPSED) and are read back FRAMES frames later, so nothing
+// waits on the GPU. Every zone keeps its last SAMPLES timings for
+// min/avg/p99. capture(n) records the next n frames and writes them as a
+// Chrome trace (chrome://tracing or ui.perfetto.dev) once the GPU results
+// are in. Define DISABLE_PROFILER to compile the macros out.
+class Profiler {
+public:
+    static const int FRAMES = 4;
+    static const int SAMPLES = 256;
+
+    struct ZoneStats {
+        std::string name;
+        bool gpu;
+        unsigned int count;
+        float minMs, avgMs, p99Ms;
+    };
+
+    static Profiler &get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // Names the calling thread in traces (others only by index)
+    void setThreadName(const std::string &name) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ThreadNames[threadIndex()] = name;
+    }
+
+    // GL thread, once per frame before any GPU zone. Reads back the
+    // oldest frame's queries and pairs this frame with a CPU/GPU clock
+    // offset for the trace.
+    void beginFrame() {
+        m_Frame++;
+        FrameQueries &frame = m_GpuFrames[m_Frame % FRAMES];
+        resolve(frame);
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        frame.clockOffsetUs = nowUs() - gpuNow / 1000.0;
+        frame.captured = m_CaptureFrames > 0;
+        if (m_CaptureFrames > 0)
+            m_CaptureFrames--;
+    }
+
+    // GL thread, once per frame after the last GPU zone
+    void endFrame() {
+        if (m_TracePending && m_CaptureFrames == 0 && !gpuCapturePending())
+            writeTrace();
+    }
+
+    // Records the next frameCount frames into path
+    void capture(int frameCount, const std::string &path) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_CaptureFrames = frameCount;
+        m_TracePath = path;
+        m_TraceEvents.clear();
+        m_TracePending = true;
+        m_CapturingCpu = true;
+        std::cout << "Profiler: capturing " << frameCount << " frames" << std::endl;
+    }
+
+    double nowUs() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Start).count();
+    }
+
+    void recordCpu(const char *name, double startUs, double endUs) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        int thread = threadIndex();
+        addSample(zoneIndex(name, false), (float)((endUs - startUs) / 1000.0));
+        if (m_CapturingCpu)
+            m_TraceEvents.push_back({name, thread, startUs, endUs - startUs, false});
+    }
+
+    void beginGpu(const char *name) {
+        FrameQueries &frame = m_GpuFrames[m_Frame % FRAMES];
+        GpuZone zone;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            zone.zone = zoneIndex(name, true);
+        }
+        zone.start = frame.acquire();
+        zone.end = frame.acquire();
+        glQueryCounter(zone.start, GL_TIMESTAMP);
+        m_OpenGpuZones.push_back((int)frame.zones.size());
+        frame.zones.push_back(zone);
+    }
+
+    void endGpu() {
+        FrameQueries &frame = m_GpuFrames[m_Frame % FRAMES];
+        if (m_OpenGpuZones.empty())
+            return;
+        glQueryCounter(frame.zones[m_OpenGpuZones.back()].end, GL_TIMESTAMP);
+        m_OpenGpuZones.pop_back();
+    }
+
+    std::vector<ZoneStats> getStats() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::vector<ZoneStats> stats;
+        for (const Zone &zone : m_Zones) {
+            if (zone.samples.empty())
+                continue;
+            std::vector<float> sorted = zone.samples;
+            std::sort(sorted.begin(), sorted.end());
+            float sum = 0.0f;
+            for (float ms : sorted)
+                sum += ms;
+            size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+            stats.push_back({zone.name, zone.gpu, zone.count, sorted.front(), sum / sorted.size(), sorted[p99]});
+        }
+        return stats;
+    }
+
+    void printStats() const {
+        std::cout << "Profiler (ms, last " << SAMPLES << " samples): min / avg / p99" << std::endl;
+        for (const ZoneStats &zone : getStats())
+            std::cout << "  " << (zone.gpu ? "GPU " : "CPU ") << zone.name << ": " << zone.minMs << " / "
+                      << zone.avgMs << " / " << zone.p99Ms << " (" << zone.count << " calls)" << std::endl;
+    }
+
+private:
+    struct Zone {
+        std::string name;
+        bool gpu;
+        unsigned int count;
+        std::vector<float> samples;
+        size_t next;
+    };
+
+    struct GpuZone {
+        int zone;
+        unsigned int start, end;
+    };
+
+    // Queries of one frame in flight; the pool only grows
+    struct FrameQueries {
+        std::vector<unsigned int> pool;
+        size_t used = 0;
+        std::vector<GpuZone> zones;
+        double clockOffsetUs = 0.0;
+        bool captured = false;
+
+        unsigned int acquire() {
+            if (used == pool.size()) {
+                unsigned int query;
+                glGenQueries(1, &query);
+                pool.push_back(query);
+            }
+            return pool[used++];
+        }
+    };
+
+    struct TraceEvent {
+        std::string name;
+        int thread;
+        double startUs, durationUs;
+        bool gpu;
+    };
+
+    std::chrono::steady_clock::time_point m_Start;
+    mutable std::mutex m_Mutex;
+    std::vector<Zone> m_Zones;
+    std::map<std::string, int> m_ZoneIndex[2];
+    std::map<int, std::string> m_ThreadNames;
+    std::atomic<int> m_ThreadCount;
+
+    FrameQueries m_GpuFrames[FRAMES];
+    std::vector<int> m_OpenGpuZones;
+    unsigned int m_Frame;
+
+    int m_CaptureFrames;
+    bool m_CapturingCpu;
+    bool m_TracePending;
+    std::string m_TracePath;
+    std::vector<TraceEvent> m_TraceEvents;
+
+    Profiler()
+        : m_Start(std::chrono::steady_clock::now()), m_ThreadCount(0), m_Frame(0), m_CaptureFrames(0),
+          m_CapturingCpu(false), m_TracePending(false) {}
+
+    int threadIndex() {
+        thread_local int index = m_ThreadCount++;
+        return index;
+    }
+
+    // Caller holds m_Mutex
+    int zoneIndex(const std::string &name, bool gpu) {
+        std::map<std::string, int>::iterator it = m_ZoneIndex[gpu].find(name);
+        if (it != m_ZoneIndex[gpu].end())
+            return it->second;
+        Zone zone;
+        zone.name = name;
+        zone.gpu = gpu;
+        zone.count = 0;
+        zone.next = 0;
+        m_Zones.push_back(zone);
+        m_ZoneIndex[gpu][name] = (int)m_Zones.size() - 1;
+        return (int)m_Zones.size() - 1;
+    }
+
+    // Caller holds m_Mutex
+    void addSample(int index, float ms) {
+        Zone &zone = m_Zones[index];
+        zone.count++;
+        if (zone.samples.size() < SAMPLES) {
+            zone.samples.push_back(ms);
+            return;
+        }
+        zone.samples[zone.next] = ms;
+        zone.next = (zone.next + 1) % SAMPLES;
+    }
+
+    bool gpuCapturePending() const {
+        for (const FrameQueries &frame : m_GpuFrames)
+            if (frame.captured && !frame.zones.empty())
+                return true;
+        return false;
+    }
+
+    // FRAMES frames late the queries are normally done, so the
+    // GL_QUERY_RESULT reads don't block
+    void resolve(FrameQueries &frame) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const GpuZone &zone : frame.zones) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(zone.start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+            double durationUs = (end - start) / 1000.0;
+            addSample(zone.zone, (float)(durationUs / 1000.0));
+            if (frame.captured)
+                m_TraceEvents.push_back(
+                    {m_Zones[zone.zone].name, -1, start / 1000.0 + frame.clockOffsetUs, durationUs, true});
+        }
+        frame.zones.clear();
+        frame.used = 0;
+        frame.captured = false;
+        if (m_CaptureFrames == 0)
+            m_CapturingCpu = false;
+    }
+
+    static std::string escape(const std::string &text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // Chrome trace event format: one complete ("X") event per zone, CPU
+    // threads and the GPU as separate tracks
+    void writeTrace() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_TracePending = false;
+        std::ofstream out(m_TracePath.c_str());
+        if (!out) {
+            std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << m_TracePath << std::endl;
+            return;
+        }
+        out << "{\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+        for (const std::pair<const int, std::string> &thread : m_ThreadNames)
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread.first
+                << ",\"args\":{\"name\":\"" << escape(thread.second) << "\"}}";
+        out.precision(15);
+        for (const TraceEvent &event : m_TraceEvents)
+            out << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+                << "\",\"ph\":\"X\",\"pid\":" << (event.gpu ? 1 : 0) << ",\"tid\":" << (event.gpu ? 0 : event.thread)
+                << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+        out << "\n]}\n";
+        std::cout << "Profiler: wrote " << m_TraceEvents.size() << " events to " << m_TracePath << std::endl;
+        m_TraceEvents.clear();
+    }
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name) : m_Name(name), m_StartUs(Profiler::get().nowUs()) {}
+    ~ProfileScope() { Profiler::get().recordCpu(m_Name, m_StartUs, Profiler::get().nowUs()); }
+
+private:
+    const char *m_Name;
+    double m_StartUs;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char *name) { Profiler::get().beginGpu(name); }
+    ~GpuProfileScope() { Profiler::get().endGpu(); }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef DISABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,516 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+// Size and format of a 2D render target
+struct RenderTargetDesc {
+    int width, height;
+    GLenum internalFormat, format, type;
+
+    bool operator==(const RenderTargetDesc &other) const {
+        return width == other.width && height == other.height && internalFormat == other.internalFormat &&
+               format == other.format && type == other.type;
+    }
+
+    bool isDepth() const { return format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL; }
+};
+
+typedef int RenderResource;
+
+// Frame graph rebuilt every frame. Passes declare what they read and
+// write; compile() then
+//   - orders passes so every read comes after the writes it depends on
+//     (passes writing the same target keep the order they were added in)
+//   - culls passes whose results nothing uses. Passes writing an
+//     imported resource (window, shadow map, ...) are always kept.
+//   - gives each transient target a texture from a pool kept across
+//     frames. Targets whose lifetimes don't overlap share a texture when
+//     their formats match.
+// execute() binds each pass's attachments as a framebuffer and runs it.
+//
+// Transients start with undefined contents (the texture may have just
+// held another target), so the first pass writing one must clear it or
+// cover every pixel.
+class RenderGraph {
+public:
+    class Pass {
+    public:
+        Pass &read(RenderResource resource) {
+            m_Reads.push_back(resource);
+            return *this;
+        }
+
+        // Colour attachments in draw buffer order; imported textures
+        // without storage (the window) are written with no attachments
+        Pass &write(RenderResource resource) {
+            m_Writes.push_back(resource);
+            return *this;
+        }
+
+        // Depth attachment. Written without clearing, so earlier depth
+        // writers still run first (depth-tested passes use this too).
+        Pass &writeDepth(RenderResource resource) {
+            m_Depth = resource;
+            return *this;
+        }
+
+        // Buffers cleared when the framebuffer is bound, a cleared target
+        // doesn't depend on earlier writers
+        Pass &clear(GLbitfield mask) {
+            m_Clear = mask;
+            return *this;
+        }
+
+    private:
+        friend class RenderGraph;
+
+        std::string m_Name;
+        std::function<void()> m_Execute;
+        std::vector<RenderResource> m_Reads;
+        std::vector<RenderResource> m_Writes;
+        RenderResource m_Depth;
+        GLbitfield m_Clear;
+        bool m_Culled;
+
+        Pass(const std::string &name, const std::function<void()> &execute)
+            : m_Name(name), m_Execute(execute), m_Depth(-1), m_Clear(0), m_Culled(false) {}
+
+        bool writes(RenderResource resource) const {
+            if (m_Depth == resource)
+                return true;
+            for (RenderResource r : m_Writes)
+                if (r == resource)
+                    return true;
+            return false;
+        }
+
+        bool reads(RenderResource resource) const {
+            for (RenderResource r : m_Reads)
+                if (r == resource)
+                    return true;
+            return false;
+        }
+
+        // Whether this pass sees what earlier passes wrote to resource
+        bool loads(RenderResource resource) const {
+            if (reads(resource))
+                return true;
+            if (resource == m_Depth)
+                return !(m_Clear & GL_DEPTH_BUFFER_BIT);
+            return writes(resource) && !(m_Clear & GL_COLOR_BUFFER_BIT);
+        }
+    };
+
+    RenderGraph() : m_Compiled(false), m_CulledCount(0), m_Frame(0) {}
+
+    ~RenderGraph() {
+        for (const PooledTarget &target : m_Pool)
+            glDeleteTextures(1, &target.texture);
+        for (const auto &entry : m_Framebuffers)
+            glDeleteFramebuffers(1, &entry.second);
+    }
+
+    // Drops last frame's passes and resources, the texture pool and
+    // framebuffers are kept
+    void reset() {
+        m_Passes.clear();
+        m_Resources.clear();
+        m_Order.clear();
+        m_Compiled = false;
+    }
+
+    RenderResource createTarget(const std::string &name, const RenderTargetDesc &desc) {
+        Resource resource(name);
+        resource.desc = desc;
+        resource.transient = true;
+        m_Resources.push_back(resource);
+        return (RenderResource)m_Resources.size() - 1;
+    }
+
+    // Something owned outside the graph. texture 0 with a size is the
+    // window's default framebuffer, texture 0 without one is an
+    // ordering-only token (e.g. a buffer written by compute).
+    RenderResource import(const std::string &name, unsigned int texture, int width = 0, int height = 0) {
+        Resource resource(name);
+        resource.texture = texture;
+        resource.desc.width = width;
+        resource.desc.height = height;
+        m_Resources.push_back(resource);
+        return (RenderResource)m_Resources.size() - 1;
+    }
+
+    // A framebuffer owned outside the graph that stands in for the window
+    // (e.g. the headless backend's offscreen target)
+    RenderResource importFramebuffer(const std::string &name, unsigned int framebuffer, int width, int height) {
+        RenderResource resource = import(name, 0, width, height);
+        m_Resources[resource].framebuffer = framebuffer;
+        return resource;
+    }
+
+    Pass &addPass(const std::string &name, const std::function<void()> &execute) {
+        m_Passes.push_back(Pass(name, execute));
+        m_Compiled = false;
+        return m_Passes.back();
+    }
+
+    void compile() {
+        size_t passCount = m_Passes.size();
+        std::vector<std::vector<int>> next(passCount);
+        std::vector<int> incoming(passCount, 0);
+        auto addEdge = [&](int from, int to) {
+            next[from].push_back(to);
+            incoming[to]++;
+        };
+
+        // Dependencies through each resource
+        for (size_t r = 0; r < m_Resources.size(); ++r) {
+            RenderResource resource = (RenderResource)r;
+            std::vector<int> writers;
+            for (size_t p = 0; p < passCount; ++p)
+                if (m_Passes[p].writes(resource))
+                    writers.push_back((int)p);
+            for (size_t w = 1; w < writers.size(); ++w)
+                addEdge(writers[w - 1], writers[w]);
+            for (size_t p = 0; p < passCount; ++p) {
+                if (!m_Passes[p].reads(resource) || m_Passes[p].writes(resource))
+                    continue;
+                // Reads see every write added before them; a pass added
+                // before all writers reads their final result
+                bool after = false;
+                for (int w : writers) {
+                    if (w < (int)p) {
+                        addEdge(w, (int)p);
+                        after = true;
+                    }
+                }
+                for (int w : writers) {
+                    if (!after)
+                        addEdge(w, (int)p);
+                    else if (w > (int)p)
+                        addEdge((int)p, w);
+                }
+            }
+        }
+
+        // Topological order, ties broken by the order passes were added
+        m_Order.clear();
+        std::vector<bool> done(passCount, false);
+        while (m_Order.size() < passCount) {
+            int pick = -1;
+            for (size_t p = 0; p < passCount && pick < 0; ++p)
+                if (!done[p] && incoming[p] == 0)
+                    pick = (int)p;
+            if (pick < 0) {
+                std::cout << "ERROR::RENDER_GRAPH::CYCLE, running passes in the order added" << std::endl;
+                m_Order.clear();
+                for (size_t p = 0; p < passCount; ++p)
+                    m_Order.push_back((int)p);
+                break;
+            }
+            done[pick] = true;
+            m_Order.push_back(pick);
+            for (int n : next[pick])
+                incoming[n]--;
+        }
+
+        cullPasses();
+        allocateTargets();
+        m_Compiled = true;
+    }
+
+    void execute() {
+        if (!m_Compiled)
+            compile();
+        for (int p : m_Order) {
+            Pass &pass = m_Passes[p];
+            if (pass.m_Culled)
+                continue;
+            PROFILE_SCOPE(pass.m_Name.c_str());
+            PROFILE_GPU_SCOPE(pass.m_Name.c_str());
+            bindAttachments(pass);
+            pass.m_Execute();
+        }
+    }
+
+    // Texture behind a resource, valid inside the passes that use it
+    unsigned int getTexture(RenderResource resource) const { return m_Resources[resource].texture; }
+    const RenderTargetDesc &getDesc(RenderResource resource) const { return m_Resources[resource].desc; }
+
+    // Framebuffer with just this target attached, for blits and reads
+    unsigned int getFramebuffer(RenderResource resource) {
+        const Resource &target = m_Resources[resource];
+        if (!target.transient && target.texture == 0)
+            return target.framebuffer;
+        std::vector<unsigned int> key;
+        if (!target.desc.isDepth())
+            key.push_back(target.texture);
+        key.push_back(0);
+        key.push_back(target.desc.isDepth() ? target.texture : 0);
+        return framebufferFor(key, target.desc);
+    }
+
+    // Stats for the last compile()
+    int getPassCount() const { return (int)m_Passes.size(); }
+    int getCulledCount() const { return m_CulledCount; }
+    int getTransientCount() const {
+        int count = 0;
+        for (const Resource &resource : m_Resources)
+            count += resource.transient && resource.used;
+        return count;
+    }
+    int getPooledTextureCount() const { return (int)m_Pool.size(); }
+
+    void printSchedule() const {
+        std::cout << "Render graph:";
+        for (int p : m_Order)
+            if (!m_Passes[p].m_Culled)
+                std::cout << " " << m_Passes[p].m_Name;
+        std::cout << " (" << m_CulledCount << " culled, " << getTransientCount() << " transient targets in "
+                  << m_Pool.size() << " textures)" << std::endl;
+    }
+
+private:
+    struct Resource {
+        std::string name;
+        RenderTargetDesc desc;
+        unsigned int texture;
+        unsigned int framebuffer; // imported window target only
+        bool transient;
+        bool used;
+        int firstUse, lastUse;
+
+        explicit Resource(const std::string &resourceName)
+            : name(resourceName), texture(0), framebuffer(0), transient(false), used(false), firstUse(-1),
+              lastUse(-1) {
+            desc.width = desc.height = 0;
+            desc.internalFormat = desc.format = desc.type = GL_NONE;
+        }
+    };
+
+    struct PooledTarget {
+        RenderTargetDesc desc;
+        unsigned int texture;
+        int freeAfter; // schedule position after which it can be reused
+        unsigned int lastFrame;
+    };
+
+    // Pooled textures no frame has used for this long are deleted (e.g.
+    // after a resolution change)
+    static const unsigned int EVICT_AFTER_FRAMES = 8;
+
+    std::deque<Pass> m_Passes;
+    std::vector<Resource> m_Resources;
+    std::vector<int> m_Order;
+    std::vector<PooledTarget> m_Pool;
+    std::map<std::vector<unsigned int>, unsigned int> m_Framebuffers;
+    bool m_Compiled;
+    int m_CulledCount;
+    unsigned int m_Frame;
+
+    // Walks back from the passes with visible results
+    void cullPasses() {
+        std::vector<bool> needed(m_Passes.size(), false);
+        std::vector<int> stack;
+        for (size_t p = 0; p < m_Passes.size(); ++p) {
+            const Pass &pass = m_Passes[p];
+            bool external = false;
+            for (RenderResource r : pass.m_Writes)
+                external = external || !m_Resources[r].transient;
+            if (pass.m_Depth >= 0)
+                external = external || !m_Resources[pass.m_Depth].transient;
+            if (external) {
+                needed[p] = true;
+                stack.push_back((int)p);
+            }
+        }
+        std::vector<int> position(m_Passes.size());
+        for (size_t i = 0; i < m_Order.size(); ++i)
+            position[m_Order[i]] = (int)i;
+        while (!stack.empty()) {
+            int p = stack.back();
+            stack.pop_back();
+            for (size_t r = 0; r < m_Resources.size(); ++r) {
+                if (!m_Passes[p].loads((RenderResource)r))
+                    continue;
+                // Every earlier writer of something this pass loads
+                for (size_t w = 0; w < m_Passes.size(); ++w) {
+                    if (!needed[w] && position[w] < position[p] && m_Passes[w].writes((RenderResource)r)) {
+                        needed[w] = true;
+                        stack.push_back((int)w);
+                    }
+                }
+            }
+        }
+        m_CulledCount = 0;
+        for (size_t p = 0; p < m_Passes.size(); ++p) {
+            m_Passes[p].m_Culled = !needed[p];
+            m_CulledCount += !needed[p];
+        }
+    }
+
+    // Lifetimes over the surviving schedule, then first-fit into the pool
+    void allocateTargets() {
+        for (size_t i = 0; i < m_Order.size(); ++i) {
+            const Pass &pass = m_Passes[m_Order[i]];
+            if (pass.m_Culled)
+                continue;
+            for (size_t r = 0; r < m_Resources.size(); ++r) {
+                Resource &resource = m_Resources[r];
+                if (!pass.reads((RenderResource)r) && !pass.writes((RenderResource)r))
+                    continue;
+                if (!resource.used)
+                    resource.firstUse = (int)i;
+                resource.used = true;
+                resource.lastUse = (int)i;
+            }
+        }
+
+        for (PooledTarget &target : m_Pool)
+            target.freeAfter = -1;
+        // Transients in order of first use, so each only has to check
+        // that a pooled texture's previous user is already finished
+        std::vector<int> transients;
+        for (size_t r = 0; r < m_Resources.size(); ++r)
+            if (m_Resources[r].transient && m_Resources[r].used)
+                transients.push_back((int)r);
+        std::stable_sort(transients.begin(), transients.end(),
+                         [&](int a, int b) { return m_Resources[a].firstUse < m_Resources[b].firstUse; });
+        for (int r : transients) {
+            Resource &resource = m_Resources[r];
+            PooledTarget *slot = nullptr;
+            for (PooledTarget &target : m_Pool) {
+                if (target.desc == resource.desc && target.freeAfter < resource.firstUse) {
+                    slot = &target;
+                    break;
+                }
+            }
+            if (!slot) {
+                m_Pool.push_back(PooledTarget{resource.desc, createTexture(resource.desc), -1, m_Frame});
+                slot = &m_Pool.back();
+            }
+            slot->freeAfter = resource.lastUse;
+            slot->lastFrame = m_Frame;
+            resource.texture = slot->texture;
+        }
+        evictUnused();
+        m_Frame++;
+    }
+
+    void evictUnused() {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_Pool.size(); ++i) {
+            if (m_Frame - m_Pool[i].lastFrame <= EVICT_AFTER_FRAMES) {
+                m_Pool[kept++] = m_Pool[i];
+                continue;
+            }
+            // Framebuffers keep deleted textures alive, drop them too
+            unsigned int texture = m_Pool[i].texture;
+            for (auto it = m_Framebuffers.begin(); it != m_Framebuffers.end();) {
+                if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end()) {
+                    glDeleteFramebuffers(1, &it->second);
+                    it = m_Framebuffers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            glDeleteTextures(1, &texture);
+        }
+        m_Pool.resize(kept);
+    }
+
+    static unsigned int createTexture(const RenderTargetDesc &desc) {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type,
+                     NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    // Key is the colour textures, a 0, then the depth texture (or 0)
+    unsigned int framebufferFor(const std::vector<unsigned int> &key, const RenderTargetDesc &depthDesc) {
+        auto found = m_Framebuffers.find(key);
+        if (found != m_Framebuffers.end())
+            return found->second;
+
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        std::vector<GLenum> drawBuffers;
+        size_t i = 0;
+        for (; key[i] != 0; ++i) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, key[i], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+        }
+        unsigned int depth = key[i + 1];
+        if (depth) {
+            GLenum attachment = depthDesc.format == GL_DEPTH_STENCIL ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth, 0);
+        }
+        if (drawBuffers.empty()) {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        } else {
+            glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_GRAPH:: Framebuffer not complete!" << std::endl;
+        m_Framebuffers[key] = fbo;
+        return fbo;
+    }
+
+    void bindAttachments(const Pass &pass) {
+        std::vector<unsigned int> key;
+        const RenderTargetDesc *size = nullptr;
+        bool window = false;
+        unsigned int windowFramebuffer = 0;
+        for (RenderResource r : pass.m_Writes) {
+            const Resource &resource = m_Resources[r];
+            if (resource.transient) {
+                key.push_back(resource.texture);
+                size = &resource.desc;
+            } else if (resource.texture == 0 && resource.desc.width > 0) {
+                window = true;
+                windowFramebuffer = resource.framebuffer;
+                size = &resource.desc;
+            }
+        }
+        unsigned int depth = 0;
+        if (pass.m_Depth >= 0 && m_Resources[pass.m_Depth].transient) {
+            depth = m_Resources[pass.m_Depth].texture;
+            if (!size)
+                size = &m_Resources[pass.m_Depth].desc;
+        }
+        if (!size)
+            return; // no attachments, the pass binds what it needs
+
+        if (window) {
+            glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer);
+        } else {
+            key.push_back(0);
+            key.push_back(depth);
+            const RenderTargetDesc &depthDesc = depth ? m_Resources[pass.m_Depth].desc : *size;
+            glBindFramebuffer(GL_FRAMEBUFFER, framebufferFor(key, depthDesc));
+        }
+        glViewport(0, 0, size->width, size->height);
+        if (pass.m_Clear)
+            glClear(pass.m_Clear);
+    }
+};
+
+#endif
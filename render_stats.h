@@ -0,0 +1,28 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstddef>
+
+// Draw calls and triangles submitted by the CPU this frame. Indirect
+// draws count once per multi-draw call, with the triangles of every
+// command in it (what the GPU cull keeps isn't known on the CPU).
+struct RenderStats {
+    size_t drawCalls;
+    size_t triangles;
+
+    RenderStats() : drawCalls(0), triangles(0) {}
+
+    void reset() { drawCalls = triangles = 0; }
+
+    void addDraw(size_t drawTriangles) {
+        drawCalls++;
+        triangles += drawTriangles;
+    }
+};
+
+inline RenderStats &renderStats() {
+    static RenderStats stats;
+    return stats;
+}
+
+#endif
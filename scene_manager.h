@@ -4,6 +4,9 @@
 
 #include "shader.h" 
 #include "model.h"
+#include "scene_objects.h"
+#include "frame_uniforms.h"
+#include "stream_buffer.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -11,34 +14,38 @@
 class SceneUtils{
 
   public:
-  SceneUtils()
+  SceneUtils() : drawStream(nullptr)
   {
 
   }
 
+  // When set, per-draw data goes through this ring as a DrawData block
+  // instead of a "model" uniform (see frame_uniforms.h)
+  void setDrawStream(StreamBuffer *stream) { drawStream = stream; }
+
   //hard coded first test render scene method
   void renderScene_test(Shader &shader, Model &model1, Model &model2, Model &model3) {
       // Object 1
       glm::mat4 model = glm::mat4(1.0f);
       model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
       model = glm::scale(model, glm::vec3(0.5f));
-      shader.setMat4("model", model);
-      model1.Draw(shader);
+      if (setModelMatrix(shader, model))
+        model1.Draw(shader);
       
       // Object 2
       model = glm::mat4(1.0f);
       model = glm::translate(model, glm::vec3(3.0f, -1.0f, 1.0f));
       model = glm::scale(model, glm::vec3(0.4f));
       model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-      shader.setMat4("model", model);
-      model2.Draw(shader);
+      if (setModelMatrix(shader, model))
+        model2.Draw(shader);
       
       // Object 3 
       model = glm::mat4(1.0f);
       model = glm::translate(model, glm::vec3(-3.0f, 1.5f, -1.0f));
       model = glm::scale(model, glm::vec3(0.6f));
-      shader.setMat4("model", model);
-      model3.Draw(shader);
+      if (setModelMatrix(shader, model))
+        model3.Draw(shader);
   }
 
 
@@ -49,8 +56,8 @@ class SceneUtils{
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f + i, 0.0f + i, 0.0f));
         model = glm::scale(model, glm::vec3(0.5f));
-        shader.setMat4("model", model);
-        model_it->Draw(shader);
+        if (setModelMatrix(shader, model))
+          model_it->Draw(shader);
         ++i;
       }
 
@@ -61,11 +68,17 @@ class SceneUtils{
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, position);
         model = glm::scale(model, scale);
-        shader.setMat4("model", model);
-        Model->Draw(shader);
+        if (setModelMatrix(shader, model))
+          Model->Draw(shader);
 
   }
 
+  void renderObject(Shader &shader, const SceneObject &object)
+  {
+        if (setModelMatrix(shader, object.getModelMatrix()))
+          object.model->Draw(shader);
+  }
+
   void processShaderPipeline(
       unsigned int &envMap,
       unsigned int &albedo,
@@ -100,6 +113,44 @@ class SceneUtils{
     
   }
 
+  // Position-only stream, for shaders that only need aPos
+  void renderObjectDepth(Shader &shader, const SceneObject &object)
+  {
+        if (setModelMatrix(shader, object.getModelMatrix()))
+          object.model->DrawDepth();
+  }
+
+  // Material textures only; the caller binds the per-frame shadow and
+  // env maps once on units 5 and 6
+  void processShaderPipeline(Shader &pbrShader, const SceneObject &object)
+  {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, object.material.albedo);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, object.material.normal);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, object.material.metallic);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, object.material.roughness);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, object.material.ao);
+
+    renderObject(pbrShader, object);
+  }
+
+  private:
+  StreamBuffer *drawStream;
+
+  // False when the ring is full; the block would still hold the previous
+  // draw's matrix, so the caller skips the draw
+  bool setModelMatrix(Shader &shader, const glm::mat4 &model)
+  {
+    if (drawStream)
+      return drawStream->writeAndBind(DRAW_DATA_BINDING, DrawData{model});
+    shader.setMat4("model", model);
+    return true;
+  }
+
 };
 
 #endif
@@ -0,0 +1,209 @@
+#ifndef SCENE_OBJECTS_H
+#define SCENE_OBJECTS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "model.h"
+#include "shadow_culling.h"
+#include "thread_pool.h"
+
+struct OccluderMesh;
+
+struct Material {
+    unsigned int albedo;
+    unsigned int normal;
+    unsigned int metallic;
+    unsigned int roughness;
+    unsigned int ao;
+};
+
+struct SceneObject {
+    std::string name;
+    Model *model;
+    Material material;
+    glm::vec3 position;
+    glm::vec3 scale;
+    bool castsShadow;
+    bool isStatic;
+    // Simplified mesh for software occlusion culling, null if this object
+    // doesn't hide anything worth testing against
+    const OccluderMesh *occluder;
+
+    AABB worldBounds;
+    bool transformDirty;
+
+    SceneObject(const std::string &objName, Model *objModel, const Material &objMaterial,
+                glm::vec3 objPosition, glm::vec3 objScale)
+        : name(objName), model(objModel), material(objMaterial), position(objPosition),
+          scale(objScale), castsShadow(true), isStatic(true), occluder(nullptr), transformDirty(true) {
+        updateBounds();
+    }
+
+    glm::mat4 getModelMatrix() const {
+        glm::mat4 m = glm::mat4(1.0f);
+        m = glm::translate(m, position);
+        m = glm::scale(m, scale);
+        return m;
+    }
+
+    void setTransform(glm::vec3 newPosition, glm::vec3 newScale) {
+        if (newPosition == position && newScale == scale)
+            return;
+        position = newPosition;
+        scale = newScale;
+        transformDirty = true;
+    }
+
+    void updateBounds() { worldBounds = model->bounds.transformed(getModelMatrix()); }
+};
+
+enum CasterFilter {
+    CASTERS_ALL,
+    CASTERS_STATIC,
+    CASTERS_DYNAMIC
+};
+
+// Owns the scene objects and the BVH over their world bounds. Object index
+// and BVH proxy are the same number.
+class Scene {
+public:
+    std::vector<SceneObject> objects;
+
+    Scene() : m_Built(false) {}
+
+    size_t add(const SceneObject &object) {
+        objects.push_back(object);
+        objects.back().updateBounds();
+        objects.back().transformDirty = false;
+        if (m_Built) {
+            m_BVH.createProxy(objects.back().worldBounds);
+            if (objects.back().isStatic)
+                m_PendingStaticChanges.push_back(objects.back().worldBounds);
+        }
+        return objects.size() - 1;
+    }
+
+    void buildBVH(ThreadPool *pool = nullptr) {
+        std::vector<AABB> boxes(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            objects[i].updateBounds();
+            objects[i].transformDirty = false;
+            boxes[i] = objects[i].worldBounds;
+        }
+        m_BVH.build(boxes, pool);
+        m_Built = true;
+    }
+
+    // Pushes moved objects into the BVH. A handful of moves are refit
+    // incrementally; if a large share of the scene moved, or the refits
+    // have degraded the tree, it is rebuilt in bulk on the pool instead.
+    //
+    // Static objects that moved are also recorded (old and new bounds) in
+    // getStaticChanges() so cached shadow layers can be invalidated.
+    void update(ThreadPool *pool = nullptr) {
+        m_StaticChanges.swap(m_PendingStaticChanges);
+        m_PendingStaticChanges.clear();
+        m_Moved.clear();
+        if (!m_Built) {
+            buildBVH(pool);
+            return;
+        }
+        std::vector<int> dirty;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (objects[i].transformDirty)
+                dirty.push_back((int)i);
+        }
+        if (dirty.empty())
+            return;
+        m_Moved = dirty;
+
+        for (int i : dirty) {
+            if (objects[i].isStatic)
+                m_StaticChanges.push_back(objects[i].worldBounds);
+            objects[i].updateBounds();
+            objects[i].transformDirty = false;
+            if (objects[i].isStatic)
+                m_StaticChanges.push_back(objects[i].worldBounds);
+        }
+
+        if (dirty.size() * 4 > objects.size()) {
+            buildBVH(pool);
+            return;
+        }
+        for (int i : dirty)
+            m_BVH.moveProxy(i, objects[i].worldBounds);
+        if (m_BVH.isDegraded())
+            m_BVH.rebuild(pool);
+    }
+
+    void cull(const Frustum &frustum, std::vector<int> &visible) const {
+        visible.clear();
+        m_BVH.queryFrustum(frustum, visible);
+        std::sort(visible.begin(), visible.end());
+    }
+
+    // Shadow casters for one light volume: BVH query against the light's
+    // ortho frustum, then drop non-shadowing objects and ones whose shadow
+    // can't reach the camera frustum.
+    void cullShadowCasters(const ShadowCasterCuller &culler, std::vector<int> &casters,
+                           CasterFilter filter = CASTERS_ALL) const {
+        casters.clear();
+        m_BVH.queryFrustum(culler.getLightFrustum(), casters);
+        size_t kept = 0;
+        for (size_t i = 0; i < casters.size(); ++i) {
+            const SceneObject &object = objects[casters[i]];
+            if (filter == CASTERS_STATIC && !object.isStatic)
+                continue;
+            if (filter == CASTERS_DYNAMIC && object.isStatic)
+                continue;
+            if (object.castsShadow && culler.isRelevant(object.worldBounds))
+                casters[kept++] = casters[i];
+        }
+        casters.resize(kept);
+        std::sort(casters.begin(), casters.end());
+    }
+
+    // Objects whose (fat) bounds a point light's sphere touches
+    void queryLightInfluence(const glm::vec3 &lightPos, float radius, std::vector<int> &out) const {
+        out.clear();
+        m_BVH.querySphere(lightPos, radius, out);
+    }
+
+    // Closest object whose world box is hit by the ray, -1 if none
+    int pick(const Ray &ray, float maxT, float &tHit) const {
+        return m_BVH.raycast(ray, maxT, tHit, [&](int proxy, float &t) {
+            glm::vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+            return intersectRayAABB(ray.origin, invDir, objects[proxy].worldBounds, maxT, t);
+        });
+    }
+
+    AABB getBounds() const {
+        AABB bounds;
+        for (const SceneObject &object : objects)
+            bounds.expand(object.worldBounds);
+        return bounds;
+    }
+
+    const BVH &getBVH() const { return m_BVH; }
+
+    // Bounds touched by static objects during the last update()
+    const std::vector<AABB> &getStaticChanges() const { return m_StaticChanges; }
+
+    // Objects whose transform changed during the last update()
+    const std::vector<int> &getMovedObjects() const { return m_Moved; }
+
+private:
+    BVH m_BVH;
+    bool m_Built;
+    std::vector<AABB> m_StaticChanges;
+    std::vector<AABB> m_PendingStaticChanges;
+    std::vector<int> m_Moved;
+};
+
+#endif
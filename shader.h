@@ -8,31 +8,20 @@
 #include <sstream>
 #include <iostream>
 
+#include "asset_pack.h"
+#include "gl_ext.h"
+
 class Shader {
 public:
     unsigned int ID;
     
-    Shader(const char* vertexPath, const char* fragmentPath) {
+    // defines ("#define X\n" lines) go right after each stage's #version
+    Shader(const char* vertexPath, const char* fragmentPath, const char* defines = nullptr) {
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        
-        try {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            vShaderFile.close();
-            fShaderFile.close();
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        } catch (std::ifstream::failure& e) {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        if (readSource(vertexPath, vertexCode) && readSource(fragmentPath, fragmentCode)) {
+            vertexCode = addDefines(resolveIncludes(vertexCode, directoryOf(vertexPath)), defines);
+            fragmentCode = addDefines(resolveIncludes(fragmentCode, directoryOf(fragmentPath)), defines);
         }
         
         const char* vShaderCode = vertexCode.c_str();
@@ -59,6 +48,25 @@ public:
         glDeleteShader(fragment);
     }
     
+    // Compute program, only valid when hasGL43()
+    explicit Shader(const char* computePath) {
+        std::string computeCode;
+        if (readSource(computePath, computeCode))
+            computeCode = resolveIncludes(computeCode, directoryOf(computePath));
+
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+    }
+
     void use() { glUseProgram(ID); }
     
     void setBool(const std::string &name, bool value) const {
@@ -79,8 +87,75 @@ public:
     void setMat4(const std::string &name, const glm::mat4 &mat) const {
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
+    // Points a uniform block at a buffer binding, no-op if the program
+    // doesn't use the block
+    void setUniformBlock(const std::string &name, unsigned int binding) const {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     
 private:
+    // Through the asset pack, which falls back to the loose file
+    static bool readSource(const std::string &path, std::string &source) {
+        AssetData data;
+        if (!assetPack().load(path, data)) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        source.assign(data.data(), data.size());
+        return true;
+    }
+
+    static std::string directoryOf(const std::string &path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    static std::string addDefines(const std::string &source, const char *defines) {
+        if (!defines)
+            return source;
+        size_t version = source.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return defines + source;
+        return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+    }
+
+    // Inlines #include "file" lines (paths relative to the including file)
+    // so shaders can share code like the BRDF
+    static std::string resolveIncludes(const std::string &source, const std::string &directory, int depth = 0) {
+        if (depth > 8) {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP" << std::endl;
+            return source;
+        }
+        std::stringstream in(source);
+        std::stringstream out;
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+                out << line << "\n";
+                continue;
+            }
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos) {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE: " << line << std::endl;
+                continue;
+            }
+            std::string path = directory + line.substr(open + 1, close - open - 1);
+            AssetData included;
+            if (!assetPack().load(path, included)) {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << path << std::endl;
+                continue;
+            }
+            out << resolveIncludes(std::string(included.data(), included.size()), directoryOf(path), depth + 1)
+                << "\n";
+        }
+        return out.str();
+    }
+
     void checkCompileErrors(unsigned int shader, std::string type) {
         int success;
         char infoLog[1024];
@@ -0,0 +1,34 @@
+#version 330 core
+// Lighting pass of the deferred path: one BRDF evaluation per pixel,
+// point lights come from the same cluster lists as the forward path
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gORM;
+uniform sampler2D gDepth;
+uniform mat4 invViewProjection;
+
+#include "normal_encoding.glsl"
+#include "pbr_lighting.glsl"
+
+void main() {
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth == 1.0)
+        discard; // Sky, already drawn
+
+    vec4 clip = invViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 WorldPos = clip.xyz / clip.w;
+
+    vec3 albedo = pow(texture(gAlbedo, TexCoords).rgb, vec3(2.2));
+    vec3 N = DecodeNormal(texture(gNormal, TexCoords).rg);
+    vec3 orm = texture(gORM, TexCoords).rgb;
+
+    vec3 color = ShadeSurface(WorldPos, N, albedo, orm.b, orm.g, orm.r);
+    color = color / (color + vec3(1.0));
+    color = pow(color, vec3(1.0/2.2)); 
+
+    FragColor = vec4(color, 1.0);
+}
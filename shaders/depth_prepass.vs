@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+#include "frame_data.glsl"
+#include "draw_data.glsl"
+
+// Must match pbr.vs bit for bit, the PBR pass depth-tests with GL_EQUAL
+invariant gl_Position;
+
+void main() {
+    vec3 WorldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,4 @@
+// Per-draw constants, one sub-allocation per draw (see frame_uniforms.h)
+layout (std140) uniform DrawData {
+    mat4 model;
+};
@@ -0,0 +1,9 @@
+// Per-frame constants, streamed once per frame (see frame_uniforms.h).
+// Layout must match FrameData on the CPU side.
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    vec3 sunPosition;
+    vec3 sunColor;
+};
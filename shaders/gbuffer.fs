@@ -0,0 +1,26 @@
+#version 330 core
+// Geometry pass of the deferred path, runs with pbr.vs
+layout (location = 0) out vec4 gAlbedo;   // RGBA8, sRGB albedo as sampled
+layout (location = 1) out vec2 gNormal;   // RG16, octahedral world normal
+layout (location = 2) out vec4 gORM;      // RGBA8, ao / roughness / metallic
+
+in vec2 TexCoords;
+in vec3 WorldPos;
+in vec3 Normal;
+in mat3 TBN;
+
+#include "material.glsl"
+
+#include "normal_encoding.glsl"
+
+void main() {
+    vec3 tangentNormal = MATERIAL_TEXTURE(normalMap, normalArray, TexCoords).xyz * 2.0 - 1.0;
+    vec3 N = normalize(TBN * tangentNormal);
+
+    // Albedo stays gamma encoded, 8 bits hold it better that way
+    gAlbedo = vec4(MATERIAL_TEXTURE(albedoMap, albedoArray, TexCoords).rgb, 1.0);
+    gNormal = EncodeNormal(N);
+    gORM = vec4(MATERIAL_TEXTURE(aoMap, aoArray, TexCoords).r,
+                MATERIAL_TEXTURE(roughnessMap, roughnessArray, TexCoords).r,
+                MATERIAL_TEXTURE(metallicMap, metallicArray, TexCoords).r, 1.0);
+}
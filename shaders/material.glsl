@@ -0,0 +1,22 @@
+// Material maps. With MATERIAL_ARRAYS (the GPU-driven programs) a draw
+// whose material is in a texture array pool reads its layer from the
+// object buffer, MaterialLayer -1 falls back to the 2D maps.
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+uniform sampler2D metallicMap;
+uniform sampler2D roughnessMap;
+uniform sampler2D aoMap;
+
+#ifdef MATERIAL_ARRAYS
+uniform sampler2DArray albedoArray;
+uniform sampler2DArray normalArray;
+uniform sampler2DArray metallicArray;
+uniform sampler2DArray roughnessArray;
+uniform sampler2DArray aoArray;
+
+flat in int MaterialLayer;
+
+#define MATERIAL_TEXTURE(map, array, uv) (MaterialLayer >= 0 ? texture(array, vec3(uv, float(MaterialLayer))) : texture(map, uv))
+#else
+#define MATERIAL_TEXTURE(map, array, uv) texture(map, uv)
+#endif
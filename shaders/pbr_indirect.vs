@@ -0,0 +1,45 @@
+#version 430 core
+// pbr.vs for multi-draw indirect: the model matrix and material layer
+// come from the object buffer, indexed by the draw id the command's
+// baseInstance selects
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangent; // w: handedness
+layout (location = 5) in uint aDrawID;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    ivec4 material; // x: texture array layer, -1 if not pooled
+};
+
+layout (std430, binding = 0) readonly buffer Objects { ObjectData objects[]; };
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+out mat3 TBN;
+flat out int MaterialLayer;
+
+#include "frame_data.glsl"
+
+// Also used for the GPU-driven depth pre-pass, so GL_EQUAL matches
+invariant gl_Position;
+
+void main() {
+    mat4 model = objects[aDrawID].model;
+    TexCoords = aTexCoords;
+    MaterialLayer = objects[aDrawID].material.x;
+    WorldPos = vec3(model * vec4(aPos, 1.0));
+    
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    vec3 T = normalize(normalMatrix * aTangent.xyz);
+    vec3 N = normalize(normalMatrix * aNormal);
+    vec3 B = cross(N, T) * aTangent.w;
+    TBN = mat3(T, B, N);
+    Normal = N;
+    
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,201 @@
+// Lighting shared by the forward (pbr.fs) and deferred
+// (deferred_lighting.fs) paths: sun with cascaded shadows, clustered
+// point lights and image based ambient, all through the same GGX BRDF.
+
+// camPos, view and the sun (a shadowed, unbounded point light)
+#include "frame_data.glsl"
+
+uniform bool shadows = true; 
+
+// Clustered point lights (see clustered_lighting.h)
+uniform samplerBuffer lightData;     // 2 texels per light: pos+radius, color
+uniform usamplerBuffer clusterGrid;  // offset, count per cluster
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterScaleBias;
+uniform vec2 screenSize;
+
+// Cascaded sun shadow, one array layer per cascade
+const int MAX_CASCADES = 4;
+uniform sampler2DArray shadowMap;
+uniform mat4 lightSpaceMatrices[MAX_CASCADES];
+uniform float cascadePlaneDistances[MAX_CASCADES];
+uniform float cascadeBias[MAX_CASCADES];
+uniform int cascadeCount;
+
+// === ADD THESE UNIFORMS ===
+uniform sampler2D envMap;
+uniform float envMapIntensity;
+
+const float PI = 3.14159265359;
+
+// === ADD THESE IBL FUNCTIONS ===
+const vec2 invAtan = vec2(0.1591, 0.3183);
+
+vec2 SampleSphericalMap(vec3 v) {
+    vec2 uv = vec2(atan(v.z, v.x), asin(v.y));
+    uv *= invAtan;
+    uv += 0.5;
+    return uv;
+}
+
+vec3 SampleEnvMap(vec3 R, float roughness) {
+    float mipLevel = roughness * 4.0;
+    vec2 uv = SampleSphericalMap(R);
+    return textureLod(envMap, uv, mipLevel).rgb;
+}
+
+vec3 SampleDiffuseEnv(vec3 N) {
+    vec2 uv = SampleSphericalMap(N);
+    return textureLod(envMap, uv, 5.0).rgb;
+}
+
+// Shadow calculation, picks the cascade from the fragment's view depth
+float ShadowCalculation(vec3 fragPosWorld, float viewDepth, vec3 normal, vec3 lightDir) {
+    int layer = -1;
+    for (int i = 0; i < cascadeCount; ++i) {
+        if (viewDepth < cascadePlaneDistances[i]) {
+            layer = i;
+            break;
+        }
+    }
+    if (layer == -1)
+        return 0.0;
+
+    vec4 fragPosLightSpace = lightSpaceMatrices[layer] * vec4(fragPosWorld, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+    
+    float currentDepth = projCoords.z;
+    if(currentDepth > 1.0)
+        return 0.0;
+    
+    float bias = max(cascadeBias[layer] * 4.0 * (1.0 - dot(normal, lightDir)), cascadeBias[layer]);
+    float shadow = 0.0;
+    
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    for(int x = -2; x <= 2; ++x) {
+        for(int y = -1; y <= 1; ++y) {
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, layer)).r;
+            shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
+        }
+    }
+    shadow /= 18.0;
+        
+    return shadow;
+}
+
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness*roughness;
+    float a2 = a*a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH*NdotH;
+    float num   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+    return num / denom;
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+    float r = (roughness + 1.0);
+    float k = (r*r) / 8.0;
+    float num   = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+    return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2  = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1  = GeometrySchlickGGX(NdotL, roughness);
+    return ggx1 * ggx2;
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// Cook-Torrance GGX for one light with incoming radiance
+vec3 EvaluateLight(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness, vec3 F0) {
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, roughness);   
+    float G   = GeometrySmith(N, V, L, roughness);      
+    vec3 F    = fresnelSchlick(max(dot(H, V), 0.0), F0);
+       
+    vec3 numerator    = NDF * G * F; 
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
+    vec3 specular = numerator / denominator;
+    
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;	  
+    float NdotL = max(dot(N, L), 0.0);
+    
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+// Lit HDR colour of one surface point, before tone mapping
+vec3 ShadeSurface(vec3 P, vec3 N, vec3 albedo, float metallic, float roughness, float ao) {
+    vec3 V = normalize(camPos - P);
+    vec3 F0 = vec3(0.04); 
+    F0 = mix(F0, albedo, metallic);
+
+    // === DIRECT LIGHTING ===
+    float viewDepth = -(view * vec4(P, 1.0)).z;
+
+    vec3 sunL = normalize(sunPosition - P);
+    float sunDistance = length(sunPosition - P);
+    vec3 Lo = EvaluateLight(N, V, sunL, sunColor / (sunDistance * sunDistance),
+                            albedo, metallic, roughness, F0);
+    if(shadows) {
+        float shadow = ShadowCalculation(P, viewDepth, N, sunL);
+        Lo *= (1.0 - shadow);
+    }
+
+    // Only the point lights assigned to this fragment's cluster
+    int slice = clamp(int(log(viewDepth) * clusterScaleBias.x + clusterScaleBias.y), 0, clusterDims.z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / screenSize * vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+    int cluster = tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+    uvec2 range = texelFetch(clusterGrid, cluster).xy;
+    for(uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 posRadius = texelFetch(lightData, light * 2);
+        vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+
+        vec3 toLight = posRadius.xyz - P;
+        float distance = length(toLight);
+        // Inverse square, windowed to reach zero at the influence radius
+        float window = clamp(1.0 - pow(distance / posRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        Lo += EvaluateLight(N, V, toLight / distance, color * attenuation,
+                            albedo, metallic, roughness, F0);
+    }
+   
+    // === REPLACE THIS AMBIENT BLOCK ===
+    // OLD:
+    // vec3 ambient = vec3(0.03) * albedo * ao;
+    
+    // NEW IBL AMBIENT:
+    vec3 R = reflect(-V, N);
+    vec3 envColor = SampleEnvMap(R, roughness);
+    vec3 envDiffuse = SampleDiffuseEnv(N);
+    
+    vec3 F = fresnelSchlick(max(dot(N, V), 0.0), F0);
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+    
+    vec3 diffuseIBL = envDiffuse * albedo;
+    vec3 specularIBL = envColor * F;
+    vec3 ambient = (kD * diffuseIBL + specularIBL) * ao * envMapIntensity;
+
+    float hemisphericAO = clamp(dot(N, vec3(0,1,0)) * 0.5 + 0.5, 0.2, 1.0);
+    ambient *= hemisphericAO;
+    // === END REPLACEMENT ===
+    
+
+    return ambient + Lo;
+}
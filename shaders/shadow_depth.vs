@@ -2,7 +2,8 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+
+#include "draw_data.glsl"
 
 void main() {
     gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
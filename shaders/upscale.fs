@@ -0,0 +1,41 @@
+#version 330 core
+// Upscales the dynamic-resolution scene colour to the window. With
+// edgeAware off this is plain bilinear. With it on, each of the four
+// bilinear taps is also weighted by how close it is to the bilinear
+// result, so taps across an edge count less and edges stay sharper.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform bool edgeAware;
+uniform float edgeSharpness = 8.0;
+
+float Luma(vec3 c) {
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+    ivec2 size = textureSize(source, 0);
+    vec2 p = TexCoords * vec2(size) - 0.5;
+    ivec2 i = ivec2(floor(p));
+    vec2 f = p - floor(p);
+
+    ivec2 maxTexel = size - 1;
+    vec3 a = texelFetch(source, clamp(i, ivec2(0), maxTexel), 0).rgb;
+    vec3 b = texelFetch(source, clamp(i + ivec2(1, 0), ivec2(0), maxTexel), 0).rgb;
+    vec3 c = texelFetch(source, clamp(i + ivec2(0, 1), ivec2(0), maxTexel), 0).rgb;
+    vec3 d = texelFetch(source, clamp(i + ivec2(1, 1), ivec2(0), maxTexel), 0).rgb;
+
+    vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    vec3 color = a * w.x + b * w.y + c * w.z + d * w.w;
+
+    if (edgeAware) {
+        float l = Luma(color);
+        vec4 similarity = 1.0 / (1.0 + edgeSharpness * abs(vec4(Luma(a), Luma(b), Luma(c), Luma(d)) - l));
+        w *= similarity;
+        color = (a * w.x + b * w.y + c * w.z + d * w.w) / max(dot(w, vec4(1.0)), 1e-5);
+    }
+
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,61 @@
+#ifndef SHADOW_CULLING_H
+#define SHADOW_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+// Decides which objects can cast a shadow into what the camera sees.
+//
+// Everything is done in light view space, where the light looks down -Z.
+// The camera frustum (clipped to the light's ortho volume) gives the
+// receiver region; a caster only matters if its footprint overlaps that
+// region in XY and it isn't entirely behind the farthest receiver. That
+// is the light volume extruded from the receivers back towards the light.
+class ShadowCasterCuller {
+public:
+    ShadowCasterCuller() : m_ReceiversVisible(false) {}
+
+    void setup(const glm::mat4 &lightView, const glm::mat4 &lightProjection,
+               const glm::mat4 &cameraViewProjection) {
+        m_LightView = lightView;
+        m_LightFrustum = Frustum(lightProjection * lightView);
+
+        // Ortho volume in light view space: xy from the clip box, z in [-far, -near]
+        glm::mat4 invProj = glm::inverse(lightProjection);
+        glm::vec3 lo(invProj * glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f));
+        glm::vec3 hi(invProj * glm::vec4(1.0f, 1.0f, -1.0f, 1.0f));
+        AABB lightVolume(glm::min(lo, hi), glm::max(lo, hi));
+
+        glm::vec3 corners[8];
+        frustumCorners(cameraViewProjection, corners);
+        m_Receivers = AABB();
+        for (int i = 0; i < 8; ++i)
+            m_Receivers.expand(glm::vec3(lightView * glm::vec4(corners[i], 1.0f)));
+
+        m_ReceiversVisible = m_Receivers.overlaps(lightVolume);
+        m_Receivers.min = glm::max(m_Receivers.min, lightVolume.min);
+        m_Receivers.max = glm::min(m_Receivers.max, lightVolume.max);
+    }
+
+    const Frustum &getLightFrustum() const { return m_LightFrustum; }
+
+    bool isRelevant(const AABB &worldBounds) const {
+        if (!m_ReceiversVisible)
+            return false;
+        if (!m_LightFrustum.intersects(worldBounds))
+            return false;
+        AABB caster = worldBounds.transformed(m_LightView);
+        return caster.min.x <= m_Receivers.max.x && caster.max.x >= m_Receivers.min.x &&
+               caster.min.y <= m_Receivers.max.y && caster.max.y >= m_Receivers.min.y &&
+               caster.max.z >= m_Receivers.min.z;
+    }
+
+private:
+    glm::mat4 m_LightView;
+    Frustum m_LightFrustum;
+    AABB m_Receivers;
+    bool m_ReceiversVisible;
+};
+
+#endif
@@ -0,0 +1,778 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SOFTWARE_RASTER_SIMD 1
+#endif
+
+#include "clustered_lighting.h"
+#include "model.h"
+#include "profiler.h"
+#include "render_stats.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+// CPU copy of an image with a box filtered mip chain, sampled the way the
+// GL path samples its textures (bilinear between two mips). LDR images
+// keep 8-bit texels, HDR ones floats. Channels the image doesn't have
+// read as 0 and alpha as 1, and an image that failed to load samples
+// black, like an incomplete GL texture.
+class SoftwareTexture {
+public:
+    enum Wrap {
+        WRAP_REPEAT,
+        WRAP_CLAMP
+    };
+
+    SoftwareTexture() : m_Channels(0), m_Hdr(false), m_Wrap(WRAP_REPEAT) {}
+
+    // Uses the current stbi_set_flip_vertically_on_load setting
+    bool load(const std::string &path, Wrap wrap = WRAP_REPEAT) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (!data) {
+            std::cout << "ERROR::SOFTWARE_TEXTURE::FILE_NOT_LOADED " << path << std::endl;
+            return false;
+        }
+        m_Levels.assign(1, Level{width, height, std::vector<float>(), std::vector<uint8_t>()});
+        m_Levels[0].ldr.assign(data, data + (size_t)width * height * channels);
+        stbi_image_free(data);
+        m_Channels = channels;
+        m_Hdr = false;
+        m_Wrap = wrap;
+        buildMips();
+        return true;
+    }
+
+    bool loadHdr(const std::string &path, Wrap wrap = WRAP_CLAMP) {
+        int width, height, channels;
+        float *data = stbi_loadf(path.c_str(), &width, &height, &channels, 0);
+        if (!data) {
+            std::cout << "ERROR::SOFTWARE_TEXTURE::FILE_NOT_LOADED " << path << std::endl;
+            return false;
+        }
+        m_Levels.assign(1, Level{width, height, std::vector<float>(), std::vector<uint8_t>()});
+        m_Levels[0].hdr.assign(data, data + (size_t)width * height * channels);
+        stbi_image_free(data);
+        m_Channels = channels;
+        m_Hdr = true;
+        m_Wrap = wrap;
+        buildMips();
+        return true;
+    }
+
+    bool empty() const { return m_Levels.empty(); }
+    int getLevels() const { return (int)m_Levels.size(); }
+
+    // Explicit mip level, like textureLod()
+    glm::vec4 sampleLod(const glm::vec2 &uv, float lod) const {
+        if (m_Levels.empty())
+            return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        lod = glm::clamp(lod, 0.0f, (float)(m_Levels.size() - 1));
+        int base = (int)lod;
+        float blend = lod - base;
+        glm::vec4 color = bilinear(m_Levels[base], uv);
+        if (blend > 0.0f && base + 1 < (int)m_Levels.size())
+            color = glm::mix(color, bilinear(m_Levels[base + 1], uv), blend);
+        return color;
+    }
+
+    // Level picked from the UV change to the neighbouring pixels, like
+    // texture() does from its derivatives
+    glm::vec4 sampleGrad(const glm::vec2 &uv, const glm::vec2 &ddx, const glm::vec2 &ddy) const {
+        if (m_Levels.empty())
+            return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 size((float)m_Levels[0].width, (float)m_Levels[0].height);
+        float rho = std::max(glm::length(ddx * size), glm::length(ddy * size));
+        return sampleLod(uv, rho > 1.0f ? std::log2(rho) : 0.0f);
+    }
+
+private:
+    struct Level {
+        int width, height;
+        std::vector<float> hdr;
+        std::vector<uint8_t> ldr;
+    };
+
+    std::vector<Level> m_Levels;
+    int m_Channels;
+    bool m_Hdr;
+    Wrap m_Wrap;
+
+    float texel(const Level &level, size_t index) const {
+        return m_Hdr ? level.hdr[index] : level.ldr[index] * (1.0f / 255.0f);
+    }
+
+    glm::vec4 fetch(const Level &level, int x, int y) const {
+        size_t index = ((size_t)y * level.width + x) * m_Channels;
+        glm::vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+        for (int c = 0; c < m_Channels; ++c)
+            color[c] = texel(level, index + c);
+        return color;
+    }
+
+    int wrap(int i, int size) const {
+        if (m_Wrap == WRAP_CLAMP)
+            return std::min(std::max(i, 0), size - 1);
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+
+    glm::vec4 bilinear(const Level &level, const glm::vec2 &uv) const {
+        float x = uv.x * level.width - 0.5f;
+        float y = uv.y * level.height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float ax = x - fx, ay = y - fy;
+        int x0 = wrap((int)fx, level.width), x1 = wrap((int)fx + 1, level.width);
+        int y0 = wrap((int)fy, level.height), y1 = wrap((int)fy + 1, level.height);
+        glm::vec4 top = glm::mix(fetch(level, x0, y0), fetch(level, x1, y0), ax);
+        glm::vec4 bottom = glm::mix(fetch(level, x0, y1), fetch(level, x1, y1), ax);
+        return glm::mix(top, bottom, ay);
+    }
+
+    // 2x2 box filter down to 1x1, what glGenerateMipmap does
+    void buildMips() {
+        while (m_Levels.back().width > 1 || m_Levels.back().height > 1) {
+            const Level &src = m_Levels.back();
+            Level dst{std::max(src.width / 2, 1), std::max(src.height / 2, 1), std::vector<float>(),
+                      std::vector<uint8_t>()};
+            size_t count = (size_t)dst.width * dst.height * m_Channels;
+            if (m_Hdr)
+                dst.hdr.resize(count);
+            else
+                dst.ldr.resize(count);
+            for (int y = 0; y < dst.height; ++y) {
+                int sy0 = std::min(2 * y, src.height - 1), sy1 = std::min(2 * y + 1, src.height - 1);
+                for (int x = 0; x < dst.width; ++x) {
+                    int sx0 = std::min(2 * x, src.width - 1), sx1 = std::min(2 * x + 1, src.width - 1);
+                    for (int c = 0; c < m_Channels; ++c) {
+                        float sum = texel(src, ((size_t)sy0 * src.width + sx0) * m_Channels + c) +
+                                    texel(src, ((size_t)sy0 * src.width + sx1) * m_Channels + c) +
+                                    texel(src, ((size_t)sy1 * src.width + sx0) * m_Channels + c) +
+                                    texel(src, ((size_t)sy1 * src.width + sx1) * m_Channels + c);
+                        size_t index = ((size_t)y * dst.width + x) * m_Channels + c;
+                        if (m_Hdr)
+                            dst.hdr[index] = sum * 0.25f;
+                        else
+                            dst.ldr[index] = (uint8_t)(sum * 0.25f * 255.0f + 0.5f);
+                    }
+                }
+            }
+            m_Levels.push_back(std::move(dst));
+        }
+    }
+};
+
+// Same maps as Material, as CPU images
+struct SoftwareMaterial {
+    SoftwareTexture albedo;
+    SoftwareTexture normal;
+    SoftwareTexture metallic;
+    SoftwareTexture roughness;
+    SoftwareTexture ao;
+};
+
+struct SoftwareDrawItem {
+    const ModelData *model;
+    const SoftwareMaterial *material;
+    glm::mat4 transform;
+};
+
+// Everything pbr.fs reads from the frame uniforms
+struct SoftwareFrame {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 camPos;
+    glm::vec3 sunPosition;
+    glm::vec3 sunColor;
+    std::vector<PointLight> lights;
+    const SoftwareTexture *envMap;
+    float envMapIntensity;
+};
+
+// 8-bit RGB colour, top row first, plus the depth the last frame resolved
+struct SoftwareFramebuffer {
+    int width, height;
+    std::vector<uint8_t> color;
+    std::vector<float> depth;
+
+    SoftwareFramebuffer(int w, int h)
+        : width(w), height(h), color((size_t)w * h * 3, 0), depth((size_t)w * h, 1.0f) {}
+
+    bool writePPM(const std::string &path) const {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cout << "ERROR::SOFTWARE_RENDERER::FILE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        std::fwrite(color.data(), 1, color.size(), file);
+        std::fclose(file);
+        return true;
+    }
+};
+
+// Tile based rasterizer running the forward PBR path on the CPU, as a
+// fallback where there is no GL and as a reference for image tests.
+//
+// A frame goes through four stages, each spread over the pool:
+//  - vertices are transformed once per draw (4-wide matrix columns)
+//  - triangles are clipped, snapped to 1/16 pixel and binned into
+//    TILE_SIZE square tiles, in chunks that keep submission order
+//  - each tile resolves visibility into a local depth + triangle id
+//    buffer with exact integer edge functions and a top-left fill rule
+//  - each tile shades its visible pixels once with the pbr.fs model
+// Differences from the GL forward pass: there are no sun shadows, and
+// every point light is tested against its radius instead of going through
+// the clusters (same result, the windowed falloff is zero past it).
+class SoftwareRenderer {
+public:
+    static const int TILE_SIZE = 64;
+    static const int SUBPIXEL_BITS = 4;
+    static const size_t CHUNK_TRIANGLES = 2048;
+
+    void render(const std::vector<SoftwareDrawItem> &items, const SoftwareFrame &frame, SoftwareFramebuffer &target,
+                ThreadPool *pool = nullptr) {
+        PROFILE_SCOPE("software render");
+        m_Width = target.width;
+        m_Height = target.height;
+        m_TilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+        m_TilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+
+        transformVertices(items, frame, pool);
+        setupTriangles(pool);
+        binTriangles();
+        rasterizeTiles(frame, target, pool);
+    }
+
+private:
+    // Post-transform vertex, what pbr.vs hands to the rasterizer
+    struct ShadedVertex {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+        glm::vec2 uv;
+    };
+
+    struct Draw {
+        const MeshData *mesh;
+        const SoftwareMaterial *material;
+        uint32_t firstVertex;
+    };
+
+    struct Chunk {
+        uint32_t draw;
+        size_t firstIndex, indexCount;
+    };
+
+    // Screen space triangle, possibly a piece of a clipped source triangle.
+    // corner[i] are the barycentrics of its corners in the source triangle
+    // so attributes are always interpolated from the source vertices.
+    struct RasterTriangle {
+        int32_t x[3], y[3]; // 1/16 pixel, y down
+        int64_t area;       // twice the area in subpixel units, > 0
+        float x0, y0;       // corner 0 in pixels
+        float w1dx, w1dy, w2dx, w2dy;
+        float z[3], invW[3];
+        glm::vec3 corner[3];
+        uint32_t vertex[3];
+        uint32_t draw;
+    };
+
+    struct ChunkOutput {
+        std::vector<RasterTriangle> triangles;
+        std::vector<std::pair<uint32_t, uint32_t>> bins; // tile, local triangle
+    };
+
+    struct ClipVertex {
+        glm::vec4 clip;
+        glm::vec3 bary;
+    };
+
+    // Pieces further out than this (in NDC) are clipped so the snapped
+    // coordinates stay small enough for 64-bit edge functions
+    static constexpr float GUARD_BAND = 4.0f;
+    static constexpr float PI = 3.14159265359f;
+    static const uint32_t NO_TRIANGLE = 0xffffffffu;
+
+    int m_Width, m_Height, m_TilesX, m_TilesY;
+    std::vector<Draw> m_Draws;
+    std::vector<ShadedVertex> m_Vertices;
+    std::vector<Chunk> m_Chunks;
+    std::vector<ChunkOutput> m_ChunkOutputs;
+    std::vector<RasterTriangle> m_Triangles;
+    std::vector<uint32_t> m_TileStart;
+    std::vector<uint32_t> m_TileTriangles;
+
+    template <typename F> static void forEach(ThreadPool *pool, size_t count, size_t grain, F func) {
+        if (pool)
+            pool->parallelFor(0, count, grain, func);
+        else
+            func(0, count);
+    }
+
+    void transformVertices(const std::vector<SoftwareDrawItem> &items, const SoftwareFrame &frame, ThreadPool *pool) {
+        PROFILE_SCOPE("software vertices");
+        m_Draws.clear();
+        m_Chunks.clear();
+        size_t vertexCount = 0;
+        for (const SoftwareDrawItem &item : items) {
+            for (const MeshData &mesh : item.model->meshes) {
+                uint32_t draw = (uint32_t)m_Draws.size();
+                m_Draws.push_back(Draw{&mesh, item.material, (uint32_t)vertexCount});
+                vertexCount += mesh.vertices.size();
+                renderStats().addDraw(mesh.indices.size() / 3);
+                for (size_t first = 0; first < mesh.indices.size(); first += CHUNK_TRIANGLES * 3)
+                    m_Chunks.push_back(
+                        Chunk{draw, first, std::min(CHUNK_TRIANGLES * 3, mesh.indices.size() - first)});
+            }
+        }
+        m_Vertices.resize(vertexCount);
+
+        glm::mat4 viewProjection = frame.projection * frame.view;
+        size_t draw = 0;
+        for (const SoftwareDrawItem &item : items) {
+            glm::mat4 mvp = viewProjection * item.transform;
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(item.transform)));
+            for (size_t m = 0; m < item.model->meshes.size(); ++m, ++draw) {
+                const std::vector<Vertex> &vertices = item.model->meshes[m].vertices;
+                ShadedVertex *out = &m_Vertices[m_Draws[draw].firstVertex];
+                const glm::mat4 &model = item.transform;
+                forEach(pool, vertices.size(), 4096, [&, out](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        const Vertex &v = vertices[i];
+                        transformPoint(mvp, v.Position, out[i].clip);
+                        glm::vec4 world;
+                        transformPoint(model, v.Position, world);
+                        out[i].world = glm::vec3(world);
+                        out[i].normal = glm::normalize(normalMatrix * v.Normal);
+                        out[i].tangent = glm::normalize(normalMatrix * glm::vec3(v.Tangent));
+                        out[i].bitangent = glm::cross(out[i].normal, out[i].tangent) * v.Tangent.w;
+                        out[i].uv = v.TexCoords;
+                    }
+                });
+            }
+        }
+    }
+
+    // m * (p, 1), one matrix column per SSE register
+    static void transformPoint(const glm::mat4 &m, const glm::vec3 &p, glm::vec4 &out) {
+#ifdef SOFTWARE_RASTER_SIMD
+        __m128 c0 = _mm_loadu_ps(&m[0][0]), c1 = _mm_loadu_ps(&m[1][0]);
+        __m128 c2 = _mm_loadu_ps(&m[2][0]), c3 = _mm_loadu_ps(&m[3][0]);
+        __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y)));
+        __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3);
+        _mm_storeu_ps(&out.x, _mm_add_ps(xy, zw));
+#else
+        out = m * glm::vec4(p, 1.0f);
+#endif
+    }
+
+    void setupTriangles(ThreadPool *pool) {
+        PROFILE_SCOPE("software setup");
+        m_ChunkOutputs.resize(m_Chunks.size());
+        forEach(pool, m_Chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                const Chunk &chunk = m_Chunks[c];
+                const Draw &draw = m_Draws[chunk.draw];
+                ChunkOutput &output = m_ChunkOutputs[c];
+                output.triangles.clear();
+                output.bins.clear();
+                for (size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i += 3) {
+                    uint32_t vertex[3];
+                    for (int k = 0; k < 3; ++k)
+                        vertex[k] = draw.firstVertex + draw.mesh->indices[i + k];
+                    clipTriangle(vertex, chunk.draw, output);
+                }
+            }
+        });
+    }
+
+    // Plane distances, >= 0 inside: x/y frustum sides, near, far, then the
+    // guard band planes
+    static float planeDistance(const glm::vec4 &v, int plane) {
+        switch (plane) {
+        case 0: return v.w + v.x;
+        case 1: return v.w - v.x;
+        case 2: return v.w + v.y;
+        case 3: return v.w - v.y;
+        case 4: return v.w + v.z;
+        case 5: return v.w - v.z;
+        case 6: return GUARD_BAND * v.w + v.x;
+        case 7: return GUARD_BAND * v.w - v.x;
+        case 8: return GUARD_BAND * v.w + v.y;
+        default: return GUARD_BAND * v.w - v.y;
+        }
+    }
+
+    void clipTriangle(const uint32_t vertex[3], uint32_t draw, ChunkOutput &output) const {
+        ClipVertex polygon[16];
+        for (int k = 0; k < 3; ++k) {
+            polygon[k].clip = m_Vertices[vertex[k]].clip;
+            polygon[k].bary = glm::vec3(k == 0, k == 1, k == 2);
+        }
+
+        // Entirely outside one frustum plane
+        for (int plane = 0; plane < 6; ++plane)
+            if (planeDistance(polygon[0].clip, plane) < 0.0f && planeDistance(polygon[1].clip, plane) < 0.0f &&
+                planeDistance(polygon[2].clip, plane) < 0.0f)
+                return;
+
+        // Near plane and guard band, the far plane is left to the depth test
+        int count = 3;
+        static const int CLIP_PLANES[5] = {4, 6, 7, 8, 9};
+        for (int plane : CLIP_PLANES) {
+            bool inside = true;
+            for (int k = 0; k < count; ++k)
+                inside = inside && planeDistance(polygon[k].clip, plane) >= 0.0f;
+            if (inside)
+                continue;
+            ClipVertex clipped[16];
+            int clippedCount = 0;
+            for (int k = 0; k < count; ++k) {
+                const ClipVertex &a = polygon[k];
+                const ClipVertex &b = polygon[(k + 1) % count];
+                float da = planeDistance(a.clip, plane), db = planeDistance(b.clip, plane);
+                if (da >= 0.0f)
+                    clipped[clippedCount++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f)) {
+                    float t = da / (da - db);
+                    clipped[clippedCount++] = ClipVertex{glm::mix(a.clip, b.clip, t), glm::mix(a.bary, b.bary, t)};
+                }
+            }
+            count = clippedCount;
+            if (count < 3)
+                return;
+            std::copy(clipped, clipped + count, polygon);
+        }
+
+        for (int k = 1; k + 1 < count; ++k)
+            emitTriangle(polygon[0], polygon[k], polygon[k + 1], vertex, draw, output);
+    }
+
+    static int32_t floorDiv(int32_t value, int32_t divisor) {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    void emitTriangle(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c, const uint32_t vertex[3],
+                      uint32_t draw, ChunkOutput &output) const {
+        const float subpixel = (float)(1 << SUBPIXEL_BITS);
+        const ClipVertex *corners[3] = {&a, &b, &c};
+        RasterTriangle tri;
+        for (int k = 0; k < 3; ++k) {
+            const glm::vec4 &clip = corners[k]->clip;
+            float invW = 1.0f / clip.w;
+            float sx = (clip.x * invW * 0.5f + 0.5f) * m_Width;
+            float sy = (0.5f - clip.y * invW * 0.5f) * m_Height;
+            tri.x[k] = (int32_t)std::lround(sx * subpixel);
+            tri.y[k] = (int32_t)std::lround(sy * subpixel);
+            tri.z[k] = clip.z * invW * 0.5f + 0.5f;
+            tri.invW[k] = invW;
+            tri.corner[k] = corners[k]->bary;
+            tri.vertex[k] = vertex[k];
+        }
+        tri.draw = draw;
+
+        // No face culling (the GL path draws both sides), so wind every
+        // triangle the same way and drop the degenerate ones
+        tri.area = edge(tri, 0, 1, tri.x[2], tri.y[2]);
+        if (tri.area == 0)
+            return;
+        if (tri.area < 0) {
+            std::swap(tri.x[1], tri.x[2]);
+            std::swap(tri.y[1], tri.y[2]);
+            std::swap(tri.z[1], tri.z[2]);
+            std::swap(tri.invW[1], tri.invW[2]);
+            std::swap(tri.corner[1], tri.corner[2]);
+            tri.area = -tri.area;
+        }
+
+        // Pixel centres the bounding box can reach
+        int32_t half = 1 << (SUBPIXEL_BITS - 1);
+        int32_t minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        int32_t maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        int32_t minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+        int32_t maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+        int px0 = std::max(floorDiv(minX - half + (1 << SUBPIXEL_BITS) - 1, 1 << SUBPIXEL_BITS), 0);
+        int px1 = std::min(floorDiv(maxX - half, 1 << SUBPIXEL_BITS), m_Width - 1);
+        int py0 = std::max(floorDiv(minY - half + (1 << SUBPIXEL_BITS) - 1, 1 << SUBPIXEL_BITS), 0);
+        int py1 = std::min(floorDiv(maxY - half, 1 << SUBPIXEL_BITS), m_Height - 1);
+        if (px0 > px1 || py0 > py1)
+            return;
+
+        // Screen barycentrics of corners 1 and 2 as planes through corner 0
+        float area = (float)tri.area / (subpixel * subpixel);
+        tri.x0 = tri.x[0] / subpixel;
+        tri.y0 = tri.y[0] / subpixel;
+        float x1 = tri.x[1] / subpixel, y1 = tri.y[1] / subpixel;
+        float x2 = tri.x[2] / subpixel, y2 = tri.y[2] / subpixel;
+        tri.w1dx = -(tri.y0 - y2) / area;
+        tri.w1dy = (tri.x0 - x2) / area;
+        tri.w2dx = -(y1 - tri.y0) / area;
+        tri.w2dy = (x1 - tri.x0) / area;
+
+        uint32_t index = (uint32_t)output.triangles.size();
+        output.triangles.push_back(tri);
+        for (int ty = py0 / TILE_SIZE; ty <= py1 / TILE_SIZE; ++ty)
+            for (int tx = px0 / TILE_SIZE; tx <= px1 / TILE_SIZE; ++tx)
+                output.bins.push_back(std::make_pair((uint32_t)(ty * m_TilesX + tx), index));
+    }
+
+    // Edge a->b at point p, positive on the inside of a wound triangle
+    static int64_t edge(const RasterTriangle &tri, int a, int b, int64_t px, int64_t py) {
+        return (int64_t)(tri.x[b] - tri.x[a]) * (py - tri.y[a]) - (int64_t)(tri.y[b] - tri.y[a]) * (px - tri.x[a]);
+    }
+
+    // Counting sort of the chunk bins by tile; chunks are walked in order so
+    // each tile sees its triangles in submission order
+    void binTriangles() {
+        PROFILE_SCOPE("software binning");
+        size_t tileCount = (size_t)m_TilesX * m_TilesY;
+        m_TileStart.assign(tileCount + 1, 0);
+        size_t triangleCount = 0;
+        for (const ChunkOutput &output : m_ChunkOutputs) {
+            triangleCount += output.triangles.size();
+            for (const std::pair<uint32_t, uint32_t> &bin : output.bins)
+                m_TileStart[bin.first + 1]++;
+        }
+        for (size_t t = 0; t < tileCount; ++t)
+            m_TileStart[t + 1] += m_TileStart[t];
+
+        m_Triangles.clear();
+        m_Triangles.reserve(triangleCount);
+        m_TileTriangles.resize(m_TileStart[tileCount]);
+        std::vector<uint32_t> cursor(m_TileStart.begin(), m_TileStart.end() - 1);
+        for (const ChunkOutput &output : m_ChunkOutputs) {
+            uint32_t base = (uint32_t)m_Triangles.size();
+            m_Triangles.insert(m_Triangles.end(), output.triangles.begin(), output.triangles.end());
+            for (const std::pair<uint32_t, uint32_t> &bin : output.bins)
+                m_TileTriangles[cursor[bin.first]++] = base + bin.second;
+        }
+    }
+
+    void rasterizeTiles(const SoftwareFrame &frame, SoftwareFramebuffer &target, ThreadPool *pool) {
+        PROFILE_SCOPE("software tiles");
+        glm::mat4 invViewProjection = glm::inverse(frame.projection * frame.view);
+        forEach(pool, (size_t)m_TilesX * m_TilesY, 1, [&](size_t begin, size_t end) {
+            std::vector<float> depth(TILE_SIZE * TILE_SIZE);
+            std::vector<uint32_t> ids(TILE_SIZE * TILE_SIZE);
+            for (size_t t = begin; t < end; ++t) {
+                int tx0 = (int)(t % m_TilesX) * TILE_SIZE, ty0 = (int)(t / m_TilesX) * TILE_SIZE;
+                int tx1 = std::min(tx0 + TILE_SIZE, m_Width), ty1 = std::min(ty0 + TILE_SIZE, m_Height);
+                std::fill(depth.begin(), depth.end(), 1.0f);
+                std::fill(ids.begin(), ids.end(), NO_TRIANGLE);
+                for (uint32_t i = m_TileStart[t]; i < m_TileStart[t + 1]; ++i)
+                    rasterizeTriangle(m_TileTriangles[i], tx0, ty0, tx1, ty1, depth.data(), ids.data());
+                shadeTile(frame, invViewProjection, tx0, ty0, tx1, ty1, depth.data(), ids.data(), target);
+            }
+        });
+    }
+
+    // Depth test (GL_LESS) into the tile, keeping the id of the nearest
+    // triangle per pixel
+    void rasterizeTriangle(uint32_t id, int tx0, int ty0, int tx1, int ty1, float *depth, uint32_t *ids) const {
+        const RasterTriangle &tri = m_Triangles[id];
+        const int32_t one = 1 << SUBPIXEL_BITS, half = one >> 1;
+        int32_t minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        int32_t maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        int32_t minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+        int32_t maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+        int x0 = std::max(floorDiv(minX - half + one - 1, one), tx0);
+        int x1 = std::min(floorDiv(maxX - half, one), tx1 - 1);
+        int y0 = std::max(floorDiv(minY - half + one - 1, one), ty0);
+        int y1 = std::min(floorDiv(maxY - half, one), ty1 - 1);
+        if (x0 > x1 || y0 > y1)
+            return;
+
+        // Edge k is opposite corner k. Pixels exactly on an edge belong to
+        // the triangle only for "top-left" edges, so neighbours sharing the
+        // edge never both draw it.
+        static const int EDGE_FROM[3] = {1, 2, 0}, EDGE_TO[3] = {2, 0, 1};
+        int64_t row[3], stepX[3], stepY[3];
+        int64_t startX = (int64_t)x0 * one + half, startY = (int64_t)y0 * one + half;
+        for (int k = 0; k < 3; ++k) {
+            int a = EDGE_FROM[k], b = EDGE_TO[k];
+            int64_t dx = tri.x[b] - tri.x[a], dy = tri.y[b] - tri.y[a];
+            bool topLeft = dy > 0 || (dy == 0 && dx < 0);
+            row[k] = edge(tri, a, b, startX, startY) - (topLeft ? 0 : 1);
+            stepX[k] = -dy * one;
+            stepY[k] = dx * one;
+        }
+
+        float invArea = 1.0f / (float)tri.area;
+        float dz1 = tri.z[1] - tri.z[0], dz2 = tri.z[2] - tri.z[0];
+        for (int y = y0; y <= y1; ++y) {
+            int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+            float *depthRow = depth + (y - ty0) * TILE_SIZE;
+            uint32_t *idRow = ids + (y - ty0) * TILE_SIZE;
+            for (int x = x0; x <= x1; ++x) {
+                if ((e0 | e1 | e2) >= 0) {
+                    float z = tri.z[0] + (e1 * dz1 + e2 * dz2) * invArea;
+                    if (z < depthRow[x - tx0]) {
+                        depthRow[x - tx0] = z;
+                        idRow[x - tx0] = id;
+                    }
+                }
+                e0 += stepX[0];
+                e1 += stepX[1];
+                e2 += stepX[2];
+            }
+            for (int k = 0; k < 3; ++k)
+                row[k] += stepY[k];
+        }
+    }
+
+    // Source triangle barycentrics at a screen point, perspective correct
+    static glm::vec3 sourceBarycentrics(const RasterTriangle &tri, float x, float y) {
+        float w1 = tri.w1dx * (x - tri.x0) + tri.w1dy * (y - tri.y0);
+        float w2 = tri.w2dx * (x - tri.x0) + tri.w2dy * (y - tri.y0);
+        float p0 = (1.0f - w1 - w2) * tri.invW[0], p1 = w1 * tri.invW[1], p2 = w2 * tri.invW[2];
+        return (p0 * tri.corner[0] + p1 * tri.corner[1] + p2 * tri.corner[2]) / (p0 + p1 + p2);
+    }
+
+    void shadeTile(const SoftwareFrame &frame, const glm::mat4 &invViewProjection, int tx0, int ty0, int tx1, int ty1,
+                   const float *depth, const uint32_t *ids, SoftwareFramebuffer &target) const {
+        for (int y = ty0; y < ty1; ++y) {
+            for (int x = tx0; x < tx1; ++x) {
+                size_t local = (size_t)(y - ty0) * TILE_SIZE + (x - tx0);
+                size_t pixel = (size_t)y * m_Width + x;
+                float px = x + 0.5f, py = y + 0.5f;
+                glm::vec3 color;
+                if (ids[local] == NO_TRIANGLE) {
+                    color = shadeSky(frame, invViewProjection, px, py);
+                } else {
+                    const RasterTriangle &tri = m_Triangles[ids[local]];
+                    color = shadePixel(frame, tri, px, py);
+                }
+                target.depth[pixel] = depth[local];
+                for (int c = 0; c < 3; ++c)
+                    target.color[pixel * 3 + c] = (uint8_t)(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    glm::vec3 shadeSky(const SoftwareFrame &frame, const glm::mat4 &invViewProjection, float px, float py) const {
+        glm::vec4 ndc(2.0f * px / m_Width - 1.0f, 1.0f - 2.0f * py / m_Height, 1.0f, 1.0f);
+        glm::vec4 farPoint = invViewProjection * ndc;
+        glm::vec3 dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - frame.camPos);
+        glm::vec3 color = glm::vec3(frame.envMap ? frame.envMap->sampleLod(sphericalUV(dir), 0.0f) : glm::vec4(0.0f));
+        color = color / (color + glm::vec3(1.0f));
+        return glm::pow(color, glm::vec3(1.0f / 2.2f));
+    }
+
+    glm::vec3 shadePixel(const SoftwareFrame &frame, const RasterTriangle &tri, float px, float py) const {
+        const ShadedVertex &v0 = m_Vertices[tri.vertex[0]];
+        const ShadedVertex &v1 = m_Vertices[tri.vertex[1]];
+        const ShadedVertex &v2 = m_Vertices[tri.vertex[2]];
+        glm::vec3 b = sourceBarycentrics(tri, px, py);
+        glm::vec3 bx = sourceBarycentrics(tri, px + 1.0f, py);
+        glm::vec3 by = sourceBarycentrics(tri, px, py + 1.0f);
+        glm::vec2 uv = b.x * v0.uv + b.y * v1.uv + b.z * v2.uv;
+        glm::vec2 ddx = bx.x * v0.uv + bx.y * v1.uv + bx.z * v2.uv - uv;
+        glm::vec2 ddy = by.x * v0.uv + by.y * v1.uv + by.z * v2.uv - uv;
+
+        glm::vec3 world = b.x * v0.world + b.y * v1.world + b.z * v2.world;
+        glm::vec3 normal = b.x * v0.normal + b.y * v1.normal + b.z * v2.normal;
+        glm::vec3 tangent = b.x * v0.tangent + b.y * v1.tangent + b.z * v2.tangent;
+        glm::vec3 bitangent = b.x * v0.bitangent + b.y * v1.bitangent + b.z * v2.bitangent;
+
+        const SoftwareMaterial &material = *m_Draws[tri.draw].material;
+        glm::vec3 albedo = glm::pow(glm::vec3(material.albedo.sampleGrad(uv, ddx, ddy)), glm::vec3(2.2f));
+        float metallic = material.metallic.sampleGrad(uv, ddx, ddy).x;
+        float roughness = material.roughness.sampleGrad(uv, ddx, ddy).x;
+        float ao = material.ao.sampleGrad(uv, ddx, ddy).x;
+        glm::vec3 tangentNormal = glm::vec3(material.normal.sampleGrad(uv, ddx, ddy)) * 2.0f - 1.0f;
+        glm::vec3 N = glm::normalize(tangent * tangentNormal.x + bitangent * tangentNormal.y + normal * tangentNormal.z);
+
+        glm::vec3 color = shadeSurface(frame, world, N, albedo, metallic, roughness, ao);
+        color = color / (color + glm::vec3(1.0f));
+        return glm::pow(color, glm::vec3(1.0f / 2.2f));
+    }
+
+    // pbr_lighting.glsl, minus the shadow lookup and the cluster walk
+    static glm::vec2 sphericalUV(const glm::vec3 &v) {
+        return glm::vec2(std::atan2(v.z, v.x) * 0.1591f, std::asin(glm::clamp(v.y, -1.0f, 1.0f)) * 0.3183f) + 0.5f;
+    }
+
+    static float distributionGGX(const glm::vec3 &N, const glm::vec3 &H, float roughness) {
+        float a = roughness * roughness;
+        float a2 = a * a;
+        float NdotH = std::max(glm::dot(N, H), 0.0f);
+        float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+        return a2 / (PI * denom * denom);
+    }
+
+    static float geometrySchlickGGX(float NdotV, float roughness) {
+        float r = roughness + 1.0f;
+        float k = r * r / 8.0f;
+        return NdotV / (NdotV * (1.0f - k) + k);
+    }
+
+    static float geometrySmith(const glm::vec3 &N, const glm::vec3 &V, const glm::vec3 &L, float roughness) {
+        return geometrySchlickGGX(std::max(glm::dot(N, V), 0.0f), roughness) *
+               geometrySchlickGGX(std::max(glm::dot(N, L), 0.0f), roughness);
+    }
+
+    static glm::vec3 fresnelSchlick(float cosTheta, const glm::vec3 &F0) {
+        return F0 + (1.0f - F0) * std::pow(glm::clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+    }
+
+    static glm::vec3 evaluateLight(const glm::vec3 &N, const glm::vec3 &V, const glm::vec3 &L,
+                                   const glm::vec3 &radiance, const glm::vec3 &albedo, float metallic,
+                                   float roughness, const glm::vec3 &F0) {
+        glm::vec3 H = glm::normalize(V + L);
+        float NDF = distributionGGX(N, H, roughness);
+        float G = geometrySmith(N, V, L, roughness);
+        glm::vec3 F = fresnelSchlick(std::max(glm::dot(H, V), 0.0f), F0);
+        float NdotL = std::max(glm::dot(N, L), 0.0f);
+        glm::vec3 specular = NDF * G * F / (4.0f * std::max(glm::dot(N, V), 0.0f) * NdotL + 0.0001f);
+        glm::vec3 kD = (glm::vec3(1.0f) - F) * (1.0f - metallic);
+        return (kD * albedo / PI + specular) * radiance * NdotL;
+    }
+
+    static glm::vec3 shadeSurface(const SoftwareFrame &frame, const glm::vec3 &P, const glm::vec3 &N,
+                                  const glm::vec3 &albedo, float metallic, float roughness, float ao) {
+        glm::vec3 V = glm::normalize(frame.camPos - P);
+        glm::vec3 F0 = glm::mix(glm::vec3(0.04f), albedo, metallic);
+
+        glm::vec3 toSun = frame.sunPosition - P;
+        float sunDistance = glm::length(toSun);
+        glm::vec3 Lo = evaluateLight(N, V, toSun / sunDistance, frame.sunColor / (sunDistance * sunDistance), albedo,
+                                     metallic, roughness, F0);
+
+        for (const PointLight &light : frame.lights) {
+            glm::vec3 toLight = light.position - P;
+            float distance = glm::length(toLight);
+            if (distance >= light.radius)
+                continue;
+            float window = glm::clamp(1.0f - std::pow(distance / light.radius, 4.0f), 0.0f, 1.0f);
+            float attenuation = window * window / (distance * distance + 1.0f);
+            Lo += evaluateLight(N, V, toLight / distance, light.color * attenuation, albedo, metallic, roughness, F0);
+        }
+
+        if (!frame.envMap)
+            return Lo;
+        glm::vec3 R = glm::reflect(-V, N);
+        glm::vec3 envColor = glm::vec3(frame.envMap->sampleLod(sphericalUV(R), roughness * 4.0f));
+        glm::vec3 envDiffuse = glm::vec3(frame.envMap->sampleLod(sphericalUV(N), 5.0f));
+        glm::vec3 F = fresnelSchlick(std::max(glm::dot(N, V), 0.0f), F0);
+        glm::vec3 kD = (glm::vec3(1.0f) - F) * (1.0f - metallic);
+        glm::vec3 ambient = (kD * envDiffuse * albedo + envColor * F) * ao * frame.envMapIntensity;
+        ambient *= glm::clamp(N.y * 0.5f + 0.5f, 0.2f, 1.0f);
+        return ambient + Lo;
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "gl_ext.h"
+
+// Ring buffer for data written once per frame (uniform blocks, per-draw
+// data). The storage is split into one region per frame in flight; a
+// region is fenced when its frame ends and only reused once the GPU has
+// passed that fence, so writes never stall on buffers still in use and
+// never need orphaning.
+//
+// With buffer storage (GL 4.4) the whole buffer stays persistently and
+// coherently mapped and write() is a memcpy. Without it, write() falls
+// back to glBufferSubData into the same fenced regions.
+class StreamBuffer {
+public:
+    // write() result when the data doesn't fit anywhere
+    static const size_t NO_SPACE = (size_t)-1;
+
+    unsigned int ID;
+
+    StreamBuffer(GLenum target, size_t bytesPerFrame, int framesInFlight = 3)
+        : m_Target(target), m_RegionSize(bytesPerFrame), m_Frames(framesInFlight),
+          m_Region(framesInFlight - 1), m_FirstRegion(0), m_Head(0), m_End(0), m_Mapped(nullptr),
+          m_Fences(framesInFlight, (GLsync)0), m_Stalls(0), m_Spills(0), m_Failures(0) {
+        GLint alignment = 1;
+        if (target == GL_UNIFORM_BUFFER)
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_Alignment = (size_t)std::max(alignment, 16);
+        m_RegionSize = align(m_RegionSize);
+
+        size_t total = m_RegionSize * m_Frames;
+        glGenBuffers(1, &ID);
+        glBindBuffer(m_Target, ID);
+        if (hasBufferStorage()) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(m_Target, total, NULL, flags);
+            m_Mapped = (unsigned char*)glMapBufferRange(m_Target, 0, total, flags);
+        } else {
+            glBufferData(m_Target, total, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(m_Target, 0);
+    }
+
+    ~StreamBuffer() {
+        for (GLsync fence : m_Fences)
+            if (fence)
+                glDeleteSync(fence);
+        if (m_Mapped) {
+            glBindBuffer(m_Target, ID);
+            glUnmapBuffer(m_Target);
+            glBindBuffer(m_Target, 0);
+        }
+        glDeleteBuffers(1, &ID);
+    }
+
+    bool isPersistent() const { return m_Mapped != nullptr; }
+
+    // Moves to the next region, waiting for the GPU if it is still
+    // reading it (only happens when the CPU is framesInFlight ahead)
+    void beginFrame() {
+        enterRegion((m_Region + 1) % m_Frames);
+        m_FirstRegion = m_Region;
+    }
+
+    // Fences everything written since beginFrame()
+    void endFrame() {
+        for (int region = m_FirstRegion;; region = (region + 1) % m_Frames) {
+            m_Fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (region == m_Region)
+                break;
+        }
+    }
+
+    // Copies data into this frame's region, returns its buffer offset
+    // (aligned for glBindBufferRange), or NO_SPACE when every region is
+    // taken by this frame. Nothing is written then.
+    size_t write(const void *data, size_t size) {
+        size_t offset = allocate(size);
+        if (offset == NO_SPACE)
+            return NO_SPACE;
+        if (m_Mapped) {
+            std::memcpy(m_Mapped + offset, data, size);
+        } else {
+            glBindBuffer(m_Target, ID);
+            glBufferSubData(m_Target, offset, size, data);
+            glBindBuffer(m_Target, 0);
+        }
+        return offset;
+    }
+
+    template <typename T>
+    size_t write(const T &value) { return write(&value, sizeof(T)); }
+
+    // Writes and binds a uniform block range in one go. On failure the
+    // binding keeps its previous range.
+    bool writeAndBind(GLuint binding, const void *data, size_t size) {
+        size_t offset = write(data, size);
+        if (offset == NO_SPACE)
+            return false;
+        glBindBufferRange(m_Target, binding, ID, offset, size);
+        return true;
+    }
+
+    template <typename T>
+    bool writeAndBind(GLuint binding, const T &value) { return writeAndBind(binding, &value, sizeof(T)); }
+
+    size_t getBytesPerFrame() const { return m_RegionSize; }
+    // Regions that had to wait on a fence, and frames that spilled past
+    // their own region
+    unsigned int getStallCount() const { return m_Stalls; }
+    unsigned int getSpillCount() const { return m_Spills; }
+    // Writes dropped because the whole ring was full
+    unsigned int getFailureCount() const { return m_Failures; }
+
+private:
+    GLenum m_Target;
+    size_t m_RegionSize;
+    size_t m_Alignment;
+    int m_Frames;
+    int m_Region, m_FirstRegion;
+    size_t m_Head, m_End;
+    unsigned char *m_Mapped;
+    std::vector<GLsync> m_Fences;
+    unsigned int m_Stalls, m_Spills, m_Failures;
+
+    size_t align(size_t value) const { return (value + m_Alignment - 1) / m_Alignment * m_Alignment; }
+
+    void enterRegion(int region) {
+        m_Region = region;
+        waitFor(m_Region);
+        m_Head = m_Region * m_RegionSize;
+        m_End = m_Head + m_RegionSize;
+    }
+
+    size_t allocate(size_t size) {
+        if (m_Head + size > m_End) {
+            // This frame outgrew its region. Earlier writes may still be
+            // bound, so borrow the next region (waiting for it like a new
+            // frame would) and fence both at endFrame().
+            int next = (m_Region + 1) % m_Frames;
+            // Going round to the first region would overwrite ranges this
+            // frame still has bound, so the write fails instead
+            if (next == m_FirstRegion || size > m_RegionSize) {
+                if (m_Failures++ == 0)
+                    std::cout << "ERROR::STREAM_BUFFER::OUT_OF_SPACE " << size << " bytes" << std::endl;
+                return NO_SPACE;
+            }
+            if (m_Spills++ == 0)
+                std::cout << "StreamBuffer: " << m_RegionSize
+                          << " bytes per frame is too small" << std::endl;
+            enterRegion(next);
+        }
+        size_t offset = m_Head;
+        m_Head = align(offset + size);
+        return offset;
+    }
+
+    void waitFor(int region) {
+        GLsync fence = m_Fences[region];
+        if (!fence)
+            return;
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            m_Stalls++;
+            while ((result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000)) == GL_TIMEOUT_EXPIRED)
+                ;
+        }
+        glDeleteSync(fence);
+        m_Fences[region] = 0;
+    }
+};
+
+#endif
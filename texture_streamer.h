@@ -0,0 +1,256 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_pack.h"
+#include "asset_streamer.h"
+#include "bounds.h"
+#include "cooked_asset.h"
+#include "profiler.h"
+#include "scene_objects.h"
+
+// Mip residency of cooked textures under a VRAM budget. Every texture
+// keeps its small levels (TAIL_SIZE texels a side and below); finer
+// ones are loaded once an object using the texture is close enough to
+// show them, and stay cached until the budget needs the room, least
+// recently used first.
+//
+// The resident levels are those from GL_TEXTURE_BASE_LEVEL down. Levels
+// above the base are respecified empty to give their memory back, so
+// texture IDs never change and materials are left alone.
+//
+// Levels wanted this frame are never evicted to make room for others. A
+// scene that needs more than the budget gets less detail where the
+// shortfall is smallest, it doesn't cycle the same levels in and out.
+class TextureStreamer {
+public:
+    static const int TAIL_SIZE = 64;
+    // Loads in flight at once, so the loader queue stays short and a new
+    // view is served soon
+    static const int MAX_LOADS = 4;
+
+    TextureStreamer(AssetStreamer &loader, size_t budgetBytes)
+        : m_Loader(loader), m_Budget(budgetBytes), m_Resident(0), m_Incoming(0), m_Loads(0), m_Frame(0) {}
+
+    // Takes over textureID and fills it with the tail of the cooked
+    // texture in file, which stays mapped for later loads
+    bool add(unsigned int textureID, const std::shared_ptr<AssetData> &file, const std::string &name) {
+        Entry entry;
+        if (!CookedAsset::parseTexture(file->data(), file->size(), entry.image, entry.levels) ||
+            entry.levels.empty()) {
+            std::cout << "ERROR::TEXTURE_STREAMER::INVALID_FILE " << name << std::endl;
+            return false;
+        }
+        int count = (int)entry.levels.size();
+        entry.id = textureID;
+        entry.file = file;
+        entry.tail = 0;
+        while (entry.tail + 1 < count && levelExtent(entry, entry.tail) > TAIL_SIZE)
+            ++entry.tail;
+        entry.resident = entry.wanted = entry.tail;
+        entry.loading = false;
+        entry.lastUsed = m_Frame;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (int l = 0; l < count; ++l)
+            CookedAsset::uploadLevel(entry.image, l, l < entry.tail ? nullptr : entry.levels[l]);
+        CookedAsset::setSampler(entry.image, entry.tail, count);
+        m_Resident += levelBytes(entry, entry.tail, count);
+        m_ByTexture[textureID] = m_Entries.size();
+        m_Entries.push_back(entry);
+        return true;
+    }
+
+    // Works out the level each texture needs from the objects in the
+    // view frustum, then loads what is missing within the budget.
+    // projectionScale is pixels per unit at distance 1, the viewport
+    // height over 2 tan(fovy / 2).
+    void update(const Scene &scene, const Frustum &frustum, const glm::vec3 &eye, float projectionScale) {
+        PROFILE_SCOPE("texture streaming");
+        ++m_Frame;
+        for (Entry &entry : m_Entries)
+            entry.wanted = entry.tail;
+        scene.cull(frustum, m_Visible);
+        for (int i : m_Visible) {
+            const SceneObject &object = scene.objects[i];
+            if (object.model->uvDensity <= 0.0f)
+                continue;
+            // Texels per pixel of a 1 texel texture at the object's
+            // nearest point
+            const AABB &box = object.worldBounds;
+            glm::vec3 gap = glm::max(glm::max(box.min - eye, eye - box.max), glm::vec3(0.0f));
+            float scale = std::max(object.scale.x, std::max(object.scale.y, object.scale.z));
+            float footprint = object.model->uvDensity * std::max(glm::length(gap), 0.1f) /
+                              (scale * projectionScale);
+            const unsigned int maps[5] = {object.material.albedo, object.material.normal,
+                                          object.material.metallic, object.material.roughness,
+                                          object.material.ao};
+            for (unsigned int id : maps) {
+                std::unordered_map<unsigned int, size_t>::const_iterator found = m_ByTexture.find(id);
+                if (found == m_ByTexture.end())
+                    continue;
+                Entry &entry = m_Entries[found->second];
+                float texelsPerPixel = levelExtent(entry, 0) * footprint;
+                int level = texelsPerPixel > 1.0f ? (int)std::log2(texelsPerPixel) : 0;
+                entry.wanted = std::min(entry.wanted, level);
+                entry.lastUsed = m_Frame;
+            }
+        }
+
+        // Biggest shortfall first
+        m_Order.clear();
+        for (size_t e = 0; e < m_Entries.size(); ++e)
+            if (!m_Entries[e].loading && m_Entries[e].wanted < m_Entries[e].resident)
+                m_Order.push_back(e);
+        std::stable_sort(m_Order.begin(), m_Order.end(), [this](size_t a, size_t b) {
+            return m_Entries[a].resident - m_Entries[a].wanted > m_Entries[b].resident - m_Entries[b].wanted;
+        });
+        for (size_t e : m_Order) {
+            if (m_Loads >= MAX_LOADS)
+                break;
+            Entry &entry = m_Entries[e];
+            // Fewer levels than wanted when the budget can't take them all
+            int first = entry.wanted;
+            while (first < entry.resident && !makeRoom(levelBytes(entry, first, entry.resident), e))
+                ++first;
+            if (first < entry.resident)
+                load(e, first);
+        }
+    }
+
+    bool contains(unsigned int textureID) const { return m_ByTexture.count(textureID) != 0; }
+
+    void print() const {
+        int reduced = 0;
+        for (const Entry &entry : m_Entries)
+            if (entry.lastUsed == m_Frame && entry.resident > entry.wanted && !entry.loading)
+                ++reduced;
+        std::cout << "Texture streaming: " << m_Resident / 1048576.0 << " of " << m_Budget / 1048576.0
+                  << " MB resident, " << m_Entries.size() << " textures, " << m_Loads << " loading, "
+                  << reduced << " short of their detail" << std::endl;
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        std::shared_ptr<AssetData> file;
+        CookedImage image; // header only
+        std::vector<const unsigned char *> levels;
+        int tail;     // first level that is always resident
+        int resident; // GL_TEXTURE_BASE_LEVEL
+        int wanted;   // finest level the current view needs
+        bool loading;
+        unsigned int lastUsed; // frame
+    };
+
+    AssetStreamer &m_Loader;
+    size_t m_Budget;
+    size_t m_Resident;
+    size_t m_Incoming; // levels being loaded, already counted against the budget
+    int m_Loads;
+    unsigned int m_Frame;
+    std::vector<Entry> m_Entries;
+    std::unordered_map<unsigned int, size_t> m_ByTexture;
+    std::vector<int> m_Visible;
+    std::vector<size_t> m_Order;
+
+    static int levelExtent(const Entry &entry, int level) {
+        return std::max(std::max(entry.image.width >> level, 1), std::max(entry.image.height >> level, 1));
+    }
+
+    // Estimate, drivers may pad RGB to RGBA
+    static size_t levelBytes(const Entry &entry, int first, int last) {
+        size_t bytes = 0;
+        for (int l = first; l < last; ++l)
+            bytes += CookedAsset::levelSize(entry.image, l);
+        return bytes;
+    }
+
+    // Evicts levels nothing needs right now, least recently used texture
+    // first, until bytes more fit. Evicts nothing if that can't be done.
+    bool makeRoom(size_t bytes, size_t loading) {
+        size_t used = m_Resident + m_Incoming;
+        if (used + bytes <= m_Budget)
+            return true;
+        std::vector<size_t> victims;
+        size_t spare = 0;
+        for (size_t e = 0; e < m_Entries.size(); ++e) {
+            const Entry &entry = m_Entries[e];
+            if (e != loading && !entry.loading && entry.resident < entry.wanted) {
+                victims.push_back(e);
+                spare += levelBytes(entry, entry.resident, entry.wanted);
+            }
+        }
+        if (used + bytes > m_Budget + spare)
+            return false;
+        std::stable_sort(victims.begin(), victims.end(),
+                         [this](size_t a, size_t b) { return m_Entries[a].lastUsed < m_Entries[b].lastUsed; });
+        for (size_t e : victims) {
+            Entry &entry = m_Entries[e];
+            while (entry.resident < entry.wanted && m_Resident + m_Incoming + bytes > m_Budget)
+                drop(entry, entry.resident + 1);
+            if (m_Resident + m_Incoming + bytes <= m_Budget)
+                break;
+        }
+        return true;
+    }
+
+    void drop(Entry &entry, int first) {
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+        for (int l = entry.resident; l < first; ++l)
+            CookedAsset::uploadLevel(entry.image, l, nullptr);
+        m_Resident -= levelBytes(entry, entry.resident, first);
+        entry.resident = first;
+    }
+
+    // Levels first..resident-1: the loader faults their pages in, the
+    // upload happens in the streamer's per-frame update
+    void load(size_t e, int first) {
+        Entry &entry = m_Entries[e];
+        int last = entry.resident;
+        entry.loading = true;
+        m_Incoming += levelBytes(entry, first, last);
+        ++m_Loads;
+        std::shared_ptr<AssetData> file = entry.file;
+        std::vector<const unsigned char *> levels(entry.levels.begin() + first, entry.levels.begin() + last);
+        std::vector<size_t> sizes;
+        for (int l = first; l < last; ++l)
+            sizes.push_back(CookedAsset::levelSize(entry.image, l));
+        m_Loader.request([this, e, first, last, file, levels, sizes]() -> AssetStreamer::Finish {
+            unsigned char sum = 0;
+            for (size_t l = 0; l < levels.size(); ++l)
+                for (size_t i = 0; i < sizes[l]; i += 4096)
+                    sum ^= levels[l][i];
+            volatile unsigned char touched = sum;
+            (void)touched;
+            return [this, e, first, last] { finishLoad(e, first, last); };
+        });
+    }
+
+    void finishLoad(size_t e, int first, int last) {
+        Entry &entry = m_Entries[e];
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        for (int l = first; l < last; ++l)
+            CookedAsset::uploadLevel(entry.image, l, entry.levels[l]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+        size_t bytes = levelBytes(entry, first, last);
+        m_Incoming -= bytes;
+        m_Resident += bytes;
+        entry.resident = first;
+        entry.loading = false;
+        --m_Loads;
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool shared by the CPU side jobs (BVH builds,
+// culling, asset loading). Tasks are plain std::function<void()>.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = 0) : m_Stop(false) {
+        if (threadCount == 0) {
+            unsigned int hw = std::thread::hardware_concurrency();
+            threadCount = hw > 1 ? hw - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; ++i)
+            m_Workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Condition.notify_all();
+        for (std::thread &worker : m_Workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned int size() const { return (unsigned int)m_Workers.size(); }
+
+    template <typename F>
+    std::future<void> enqueue(F &&task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::forward<F>(task));
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.push([packaged] { (*packaged)(); });
+        }
+        m_Condition.notify_one();
+        return result;
+    }
+
+    // Splits [begin, end) into chunks of at least grainSize and runs
+    // func(chunkBegin, chunkEnd) on the workers. The calling thread takes
+    // the first chunk itself and blocks until every chunk has finished.
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, F func) {
+        if (end <= begin)
+            return;
+        size_t count = end - begin;
+        grainSize = std::max<size_t>(grainSize, 1);
+        size_t chunks = std::min<size_t>((count + grainSize - 1) / grainSize, size() + 1);
+        if (chunks <= 1) {
+            func(begin, end);
+            return;
+        }
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunks - 1);
+        for (size_t c = 1; c < chunks; ++c) {
+            size_t b = begin + c * chunkSize;
+            size_t e = std::min(end, b + chunkSize);
+            if (b >= e)
+                break;
+            pending.push_back(enqueue([=] { func(b, e); }));
+        }
+        func(begin, std::min(end, begin + chunkSize));
+        for (std::future<void> &f : pending)
+            wait(f);
+    }
+
+    // Waits for a future while helping with queued work, so tasks that
+    // spawn and wait on subtasks can't deadlock the pool.
+    void wait(std::future<void> &f) {
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask())
+                f.wait_for(std::chrono::microseconds(100));
+        }
+        f.get();
+    }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::queue<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stop;
+
+    bool runPendingTask() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Tasks.empty())
+                return false;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop();
+        }
+        task();
+        return true;
+    }
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this] { return m_Stop || !m_Tasks.empty(); });
+                if (m_Stop && m_Tasks.empty())
+                    return;
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+#endif
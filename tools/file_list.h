@@ -0,0 +1,73 @@
+#ifndef FILE_LIST_H
+#define FILE_LIST_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Directory walking and file name checks shared by the asset tools
+
+// Case-insensitive, suffix is given in lower case
+inline bool endsWith(const std::string &text, const char *suffix) {
+    size_t length = std::strlen(suffix);
+    if (text.size() < length)
+        return false;
+    for (size_t i = 0; i < length; ++i)
+        if (std::tolower((unsigned char)text[text.size() - length + i]) != suffix[i])
+            return false;
+    return true;
+}
+
+inline bool isDirectory(const std::string &path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+// Appends path itself if it is a file, else every file below it, in
+// sorted order so outputs don't depend on the filesystem
+inline void listFiles(const std::string &path, std::vector<std::string> &files) {
+    if (!isDirectory(path)) {
+        files.push_back(path);
+        return;
+    }
+    std::vector<std::string> entries;
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((path + "/*").c_str(), &entry);
+    if (find != INVALID_HANDLE_VALUE) {
+        do
+            entries.push_back(entry.cFileName);
+        while (FindNextFileA(find, &entry));
+        FindClose(find);
+    }
+#else
+    if (DIR *dir = opendir(path.c_str())) {
+        while (dirent *entry = readdir(dir))
+            entries.push_back(entry->d_name);
+        closedir(dir);
+    }
+#endif
+    std::sort(entries.begin(), entries.end());
+    for (const std::string &name : entries)
+        if (name != "." && name != "..")
+            listFiles(path + "/" + name, files);
+}
+
+#endif
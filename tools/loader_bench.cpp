@@ -0,0 +1,379 @@
+// Microbenchmarks for the asset loading path, one stage at a time:
+//
+//   obj parse       tinyobj::LoadObj (single threaded)
+//   obj stream      ObjStreamReader, parse + weld straight from the mapping
+//   vertex expand   Model::expandVertices
+//   tangents        Model::computeTangents
+//   weld            Model::weldVertices (single threaded)
+//   stbi_load       PNG decode, files spread over the threads
+//   mesh upload     Mesh construction (setupMesh), needs GL
+//   texture upload  glTexImage2D + mipmaps, needs GL
+//   glb load        GltfLoader::load end to end, needs GL
+//
+// CPU stages run without a GL context. GL stages run when the binary has
+// the headless backend (HEADLESS_EGL) and a context can be created.
+//
+//   loader_bench [--threads 1,2,4] [--repeat N] [--synthetic TRIANGLES]...
+//                [--no-synthetic] [--csv file] [model.obj | model.glb | texture.png]...
+//
+// Without file arguments it uses the bundled models/ assets plus
+// synthetic grids of 1M and 4M triangles written next to the binary.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file_list.h"
+#include "gltf_loader.h"
+#include "model.h"
+#include "thread_pool.h"
+#ifdef HEADLESS_EGL
+#include "headless_context.h"
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+static const char *BUNDLED_MODELS[] = {
+    "models/plane/simple_plane.obj", "models/table/table.obj",  "models/table/sphere.obj",
+    "models/cup/cup.obj",            "models/dumpsters/dumpsters.obj", "models/trash_bags/trash_bags.obj",
+};
+
+static const char *BUNDLED_TEXTURES[] = {
+    "models/cup/albedo.png",        "models/cup/normal.png",        "models/cup/roughness.png",
+    "models/trash_bags/albedo.png", "models/trash_bags/normal.png", "models/dumpsters/metallic.png",
+};
+
+struct Result {
+    std::string stage;
+    std::string asset;
+    unsigned int threads;
+    double ms;
+    double bytes;     // input (or uploaded) bytes per run
+    double triangles; // 0 for textures
+};
+
+static std::vector<Result> results;
+static int repeatCount = 3;
+
+// Median wall time of repeatCount runs, in ms
+// setup runs before every repeat, outside the timed part
+static double timeMedian(const std::function<void()> &run, const std::function<void()> &setup = nullptr) {
+    std::vector<double> times;
+    for (int i = 0; i < repeatCount; ++i) {
+        if (setup)
+            setup();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void report(const std::string &stage, const std::string &asset, unsigned int threads, double ms,
+                   double bytes, double triangles) {
+    results.push_back(Result{stage, asset, threads, ms, bytes, triangles});
+    double seconds = std::max(ms, 1e-6) / 1000.0;
+    printf("%-15s %-36s %2u thr %10.3f ms %10.1f MB/s", stage.c_str(), asset.c_str(), threads, ms,
+           bytes / 1.0e6 / seconds);
+    if (triangles > 0.0)
+        printf(" %10.2f Mtri/s", triangles / 1.0e6 / seconds);
+    printf("\n");
+}
+
+static size_t fileSize(const std::string &path) {
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    return in ? (size_t)in.tellg() : 0;
+}
+
+// A size x size grid of quads (2 * size^2 triangles) with positions,
+// normals and UVs, so every loader stage has work to do
+static std::string writeSyntheticObj(size_t triangles) {
+    size_t size = std::max<size_t>(1, (size_t)std::sqrt(triangles / 2.0));
+    std::ostringstream name;
+    name << "loader_bench_grid_" << 2 * size * size << ".obj";
+    std::ofstream out(name.str().c_str());
+    if (!out) {
+        std::cout << "ERROR::LOADER_BENCH::FILE_NOT_WRITTEN " << name.str() << std::endl;
+        return "";
+    }
+    char line[128];
+    for (size_t z = 0; z <= size; ++z)
+        for (size_t x = 0; x <= size; ++x) {
+            float h = 0.1f * std::sin(x * 0.3f) * std::cos(z * 0.2f);
+            snprintf(line, sizeof(line), "v %.5f %.5f %.5f\nvt %.5f %.5f\n", (float)x, h, (float)z,
+                     (float)x / size, (float)z / size);
+            out << line;
+        }
+    out << "vn 0 1 0\n";
+    for (size_t z = 0; z < size; ++z)
+        for (size_t x = 0; x < size; ++x) {
+            size_t a = z * (size + 1) + x + 1;
+            size_t b = a + 1, c = a + size + 1, d = c + 1;
+            snprintf(line, sizeof(line), "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\nf %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, c,
+                     c, b, b, b, b, c, c, d, d);
+            out << line;
+        }
+    return name.str();
+}
+
+static std::vector<unsigned int> parseThreadCounts(const char *list) {
+    std::vector<unsigned int> counts;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+        if (std::atoi(item.c_str()) > 0)
+            counts.push_back((unsigned int)std::atoi(item.c_str()));
+    return counts;
+}
+
+static void benchModel(const std::string &path, const std::vector<unsigned int> &threadCounts, bool gl) {
+    size_t bytes = fileSize(path);
+    ObjData obj;
+    bool ok = true;
+    double ms = timeMedian([&]() {
+        obj = ObjData();
+        ok = Model::parseObj(path, obj);
+    });
+    if (!ok || bytes == 0) {
+        std::cout << "ERROR::LOADER_BENCH::MODEL_NOT_LOADED " << path << std::endl;
+        return;
+    }
+    double triangles = 0.0;
+    for (const tinyobj::shape_t &shape : obj.shapes)
+        triangles += shape.mesh.num_face_vertices.size();
+    report("obj parse", path, 1, ms, (double)bytes, triangles);
+
+    for (unsigned int threads : threadCounts) {
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+        ms = timeMedian([&]() {
+            std::vector<MeshData> meshes;
+            ObjStreamReader reader(pool.get());
+            if (!reader.load(path, meshes))
+                std::cout << "ERROR::LOADER_BENCH::MODEL_NOT_STREAMED " << path << std::endl;
+        });
+        report("obj stream", path, threads, ms, (double)bytes, triangles);
+    }
+
+    ModelData data;
+    for (unsigned int threads : threadCounts) {
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+        std::vector<MeshData> meshes(obj.shapes.size());
+        double vertexBytes = 0.0;
+        ms = timeMedian([&]() {
+            for (size_t s = 0; s < obj.shapes.size(); ++s)
+                Model::expandVertices(obj, obj.shapes[s], meshes[s], pool.get());
+        });
+        for (const MeshData &mesh : meshes)
+            vertexBytes += mesh.vertices.size() * sizeof(Vertex);
+        report("vertex expand", path, threads, ms, vertexBytes, triangles);
+
+        std::vector<MeshData> expanded = meshes;
+        ms = timeMedian(
+            [&]() {
+                for (MeshData &mesh : meshes)
+                    Model::computeTangents(mesh, pool.get());
+            },
+            [&]() { meshes = expanded; });
+        report("tangents", path, threads, ms, vertexBytes, triangles);
+
+        std::vector<MeshData> tangents = meshes;
+        ms = timeMedian(
+            [&]() {
+                for (MeshData &mesh : meshes)
+                    Model::weldVertices(mesh);
+            },
+            [&]() { meshes = tangents; });
+        report("weld", path, threads, ms, vertexBytes, triangles);
+        data.meshes = meshes;
+    }
+
+    if (!gl)
+        return;
+    double uploadBytes = 0.0;
+    for (const MeshData &mesh : data.meshes)
+        uploadBytes += mesh.vertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)) +
+                       mesh.indices.size() * sizeof(unsigned int);
+    // The previous run's model is destroyed in setup, so its glDelete*
+    // calls aren't timed
+    std::unique_ptr<Model> model;
+    ms = timeMedian(
+        [&]() {
+            model.reset(new Model("bench", data));
+            glFinish();
+        },
+        [&]() { model.reset(); });
+    model.reset();
+    report("mesh upload", path, 1, ms, uploadBytes, triangles);
+}
+
+// Whole .glb loads (map, buffer upload, images, GL objects), so the
+// number is comparable to obj parse + expand + tangents + mesh upload
+static void benchGlb(const std::string &path, const std::vector<unsigned int> &threadCounts, bool gl) {
+    if (!gl)
+        return;
+    double bytes = fileSize(path);
+    for (unsigned int threads : threadCounts) {
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+        double triangles = 0.0;
+        // Parts are freed in setup like the mesh upload models. Material
+        // textures have no owner and stay alive, fine for a tool.
+        std::vector<GltfPart> parts;
+        double ms = timeMedian(
+            [&]() {
+                GltfLoader loader(pool.get());
+                if (!loader.load(path, parts))
+                    std::cout << "ERROR::LOADER_BENCH::GLB_NOT_LOADED " << path << std::endl;
+                glFinish();
+            },
+            [&]() { parts.clear(); });
+        for (const GltfPart &part : parts)
+            for (const Mesh &mesh : part.model->meshes)
+                triangles += mesh.getIndexCount() / 3;
+        parts.clear();
+        report("glb load", path, threads, ms, bytes, triangles);
+    }
+}
+
+static void benchTextures(const std::vector<std::string> &paths, const std::vector<unsigned int> &threadCounts,
+                          bool gl) {
+    if (paths.empty())
+        return;
+    double bytes = 0.0;
+    for (const std::string &path : paths)
+        bytes += fileSize(path);
+    std::string label = std::to_string(paths.size()) + " textures";
+
+    for (unsigned int threads : threadCounts) {
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+        auto decode = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                int width, height, components;
+                unsigned char *pixels = stbi_load(paths[i].c_str(), &width, &height, &components, 0);
+                if (!pixels)
+                    std::cout << "ERROR::LOADER_BENCH::TEXTURE_NOT_LOADED " << paths[i] << std::endl;
+                stbi_image_free(pixels);
+            }
+        };
+        double ms = timeMedian([&]() {
+            if (pool)
+                pool->parallelFor(0, paths.size(), 1, decode);
+            else
+                decode(0, paths.size());
+        });
+        report("stbi_load", label, threads, ms, bytes, 0.0);
+    }
+
+    if (!gl)
+        return;
+    for (const std::string &path : paths) {
+        int width, height, components;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 0);
+        if (!pixels)
+            continue;
+        GLenum format = components == 1 ? GL_RED : components == 3 ? GL_RGB : GL_RGBA;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        double ms = timeMedian([&]() {
+            unsigned int texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glFinish();
+            glDeleteTextures(1, &texture);
+        });
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        report("texture upload", path, 1, ms, (double)width * height * components, 0.0);
+        stbi_image_free(pixels);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t < hw; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+
+    std::vector<size_t> synthetic = {1000000, 4000000};
+    bool customSynthetic = false;
+    std::vector<std::string> models, glbs, textures;
+    std::string csvPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            threadCounts = parseThreadCounts(argv[++i]);
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeatCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--synthetic" && i + 1 < argc) {
+            if (!customSynthetic)
+                synthetic.clear();
+            customSynthetic = true;
+            synthetic.push_back((size_t)std::atof(argv[++i]));
+        } else if (arg == "--no-synthetic")
+            synthetic.clear();
+        else if (arg == "--csv" && i + 1 < argc)
+            csvPath = argv[++i];
+        else if (endsWith(arg, ".obj"))
+            models.push_back(arg);
+        else if (endsWith(arg, ".glb"))
+            glbs.push_back(arg);
+        else
+            textures.push_back(arg);
+    }
+    if (models.empty() && glbs.empty() && textures.empty()) {
+        models.assign(std::begin(BUNDLED_MODELS), std::end(BUNDLED_MODELS));
+        textures.assign(std::begin(BUNDLED_TEXTURES), std::end(BUNDLED_TEXTURES));
+    }
+
+    bool gl = false;
+#ifdef HEADLESS_EGL
+    HeadlessContext context;
+    gl = context.create(16, 16) && gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress);
+#endif
+    if (!gl)
+        std::cout << "No GL context, skipping the upload stages" << std::endl;
+
+    std::vector<std::string> generated;
+    for (size_t triangles : synthetic) {
+        std::string path = writeSyntheticObj(triangles);
+        if (!path.empty())
+            generated.push_back(path);
+    }
+
+    for (const std::string &path : models)
+        benchModel(path, threadCounts, gl);
+    for (const std::string &path : generated)
+        benchModel(path, threadCounts, gl);
+    for (const std::string &path : glbs)
+        benchGlb(path, threadCounts, gl);
+    benchTextures(textures, threadCounts, gl);
+
+    for (const std::string &path : generated)
+        std::remove(path.c_str());
+
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath.c_str());
+        csv << "stage,asset,threads,ms,mb_per_s,mtri_per_s\n";
+        for (const Result &r : results) {
+            double seconds = std::max(r.ms, 1e-6) / 1000.0;
+            csv << r.stage << "," << r.asset << "," << r.threads << "," << r.ms << "," << r.bytes / 1.0e6 / seconds
+                << "," << r.triangles / 1.0e6 / seconds << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+// Offline asset cooker: turns the sources under models/ into the runtime
+// files the viewer loads with --cooked (see cooked_asset.h).
+//
+//   .obj            streamed parse + weld, tangents, vertex cache and
+//                   fetch order -> .mesh
+//   .png .jpg .tga  decoded (flipped like loadTexture) with box filtered
+//   .bmp            mips -> .tex
+//   .hdr            float texels + mips, as loadEquirectangularMap -> .tex
+//
+// Every output records a hash of its source bytes and of the settings
+// below; outputs whose hash still matches are skipped, so a rerun only
+// cooks what changed. Assets are cooked in parallel on a ThreadPool.
+//
+//   pbr_cook [--out cooked] [--threads N] [--force] [dir | file]...
+//
+// Paths are kept as given (default "models"), run it from the directory
+// the viewer runs from so cooked/models/... matches what it looks up.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "cooked_asset.h"
+#include "file_list.h"
+#include "mapped_file.h"
+#include "model.h"
+#include "obj_stream.h"
+#include "thread_pool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Part of every hash: changing what a cook step does must change these
+static const char *MESH_SETTINGS = "mesh: stream weld, tangents, forsyth cache 32, fetch order";
+static const char *TEXTURE_SETTINGS = "texture: flip y, box mips";
+
+enum AssetKind { ASSET_MESH, ASSET_TEXTURE, ASSET_HDR };
+
+struct Asset {
+    std::string source;
+    AssetKind kind;
+};
+
+static std::mutex printMutex;
+
+static bool classify(const std::string &path, AssetKind &kind) {
+    if (endsWith(path, ".obj"))
+        kind = ASSET_MESH;
+    else if (endsWith(path, ".hdr"))
+        kind = ASSET_HDR;
+    else if (endsWith(path, ".png") || endsWith(path, ".jpg") || endsWith(path, ".jpeg") || endsWith(path, ".tga") ||
+             endsWith(path, ".bmp"))
+        kind = ASSET_TEXTURE;
+    else
+        return false;
+    return true;
+}
+
+static void collect(const std::string &path, std::vector<Asset> &assets) {
+    std::vector<std::string> files;
+    listFiles(path, files);
+    AssetKind kind;
+    for (const std::string &file : files)
+        if (classify(file, kind))
+            assets.push_back(Asset{file, kind});
+}
+
+// mkdir -p of the file's directory
+static void makeParentDirectories(const std::string &file) {
+    for (size_t slash = file.find('/', 1); slash != std::string::npos; slash = file.find('/', slash + 1)) {
+        std::string dir = file.substr(0, slash);
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+
+// Average post-transform cache misses per triangle for a FIFO cache
+static float acmr(const MeshData &mesh, size_t cacheSize = 32) {
+    std::vector<unsigned int> fifo;
+    size_t misses = 0;
+    for (unsigned int index : mesh.indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) != fifo.end())
+            continue;
+        ++misses;
+        fifo.push_back(index);
+        if (fifo.size() > cacheSize)
+            fifo.erase(fifo.begin());
+    }
+    return mesh.indices.empty() ? 0.0f : misses / (mesh.indices.size() / 3.0f);
+}
+
+static bool cookMesh(const Asset &asset, const std::string &output, uint64_t hash, ThreadPool *pool,
+                     std::string &summary) {
+    ModelData data;
+    if (!Model::loadData(asset.source, data, pool))
+        return false;
+    size_t vertices = 0, triangles = 0;
+    double before = 0.0, after = 0.0;
+    for (MeshData &mesh : data.meshes) {
+        before += acmr(mesh) * mesh.indices.size() / 3;
+        Model::optimizeVertexCache(mesh);
+        Model::optimizeVertexFetch(mesh);
+        after += acmr(mesh) * mesh.indices.size() / 3;
+        vertices += mesh.vertices.size();
+        triangles += mesh.indices.size() / 3;
+    }
+    char text[128];
+    std::snprintf(text, sizeof(text), "%zu vertices, %zu triangles, ACMR %.2f -> %.2f", vertices, triangles,
+                  triangles ? before / triangles : 0.0, triangles ? after / triangles : 0.0);
+    summary = text;
+    return CookedAsset::writeModel(output, data, hash);
+}
+
+static bool cookTexture(const Asset &asset, const std::string &output, uint64_t hash, std::string &summary) {
+    CookedImage image;
+    image.hdr = asset.kind == ASSET_HDR;
+    void *pixels = image.hdr ? (void *)stbi_loadf(asset.source.c_str(), &image.width, &image.height, &image.channels, 0)
+                             : (void *)stbi_load(asset.source.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!pixels) {
+        std::cout << "ERROR::PBR_COOK::IMAGE_NOT_DECODED " << asset.source << std::endl;
+        return false;
+    }
+    size_t bytes = (size_t)image.width * image.height * image.channels * (image.hdr ? 4 : 1);
+    image.levels.push_back(std::vector<unsigned char>((unsigned char *)pixels, (unsigned char *)pixels + bytes));
+    stbi_image_free(pixels);
+    CookedAsset::buildMips(image);
+    char text[128];
+    std::snprintf(text, sizeof(text), "%dx%d, %d channels%s, %zu mips", image.width, image.height, image.channels,
+                  image.hdr ? " float" : "", image.levels.size());
+    summary = text;
+    return CookedAsset::writeTexture(output, image, hash);
+}
+
+int main(int argc, char **argv) {
+    std::string outDir = "cooked";
+    unsigned int threads = 0;
+    bool force = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc)
+            outDir = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--force")
+            force = true;
+        else
+            inputs.push_back(arg);
+    }
+    if (inputs.empty())
+        inputs.push_back("models");
+
+    std::vector<Asset> assets;
+    for (const std::string &input : inputs)
+        collect(input, assets);
+    if (assets.empty()) {
+        std::cout << "Nothing to cook in";
+        for (const std::string &input : inputs)
+            std::cout << " " << input;
+        std::cout << std::endl;
+        return 1;
+    }
+
+    // Both loaders in the viewer flip, cooked rows match what they upload
+    stbi_set_flip_vertically_on_load(true);
+    // --threads 1 cooks on this thread only, 0 uses the pool default
+    std::unique_ptr<ThreadPool> pool(threads == 1 ? nullptr : new ThreadPool(threads ? threads - 1 : 0));
+    std::atomic<int> cooked(0), upToDate(0), failed(0);
+    auto start = std::chrono::steady_clock::now();
+    auto cookRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Asset &asset = assets[i];
+            bool mesh = asset.kind == ASSET_MESH;
+            std::string output = mesh ? CookedAsset::meshPath(outDir, asset.source)
+                                      : CookedAsset::texturePath(outDir, asset.source);
+            MappedFile source;
+            if (!source.open(asset.source)) {
+                ++failed;
+                continue;
+            }
+            const char *settings = mesh ? MESH_SETTINGS : TEXTURE_SETTINGS;
+            uint64_t hash = CookedAsset::hash(settings, std::strlen(settings));
+            hash = CookedAsset::hash(source.data(), source.size(), hash);
+            source.close();
+
+            uint64_t existing;
+            if (!force && CookedAsset::readHash(output, mesh ? CookedAsset::MESH_MAGIC : CookedAsset::TEXTURE_MAGIC,
+                                                existing) &&
+                existing == hash) {
+                ++upToDate;
+                continue;
+            }
+            auto assetStart = std::chrono::steady_clock::now();
+            makeParentDirectories(output);
+            std::string summary;
+            bool ok = mesh ? cookMesh(asset, output, hash, pool.get(), summary) : cookTexture(asset, output, hash, summary);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - assetStart).count();
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (ok) {
+                ++cooked;
+                std::printf("cooked %-44s %8.1f ms  %s\n", asset.source.c_str(), ms, summary.c_str());
+            } else {
+                ++failed;
+                std::remove(output.c_str());
+                std::printf("FAILED %s\n", asset.source.c_str());
+            }
+        }
+    };
+    if (pool)
+        pool->parallelFor(0, assets.size(), 1, cookRange);
+    else
+        cookRange(0, assets.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%d cooked, %d up to date, %d failed in %.2f s (%u threads) -> %s\n", cooked.load(), upToDate.load(),
+                failed.load(), seconds, pool ? pool->size() + 1 : 1, outDir.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+// Packs loose assets into the single file the viewer maps with --pack
+// (format in asset_pack.h).
+//
+//   pbr_pack [--out assets.pack] [--store] [--threads N] [dir | file]...
+//   pbr_pack --list assets.pack
+//
+// Inputs default to models and shaders; add the pbr_cook output
+// directory to pack cooked files too. Entries are LZ4 compressed when
+// that saves at least an eighth of them, otherwise (and for everything
+// with --store) they are stored and used by the viewer straight from
+// the mapping. Images that are compressed already are always stored.
+// Paths are kept as given, run it from the directory the viewer runs
+// from so the names match what it loads.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "file_list.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+struct PackedFile {
+    std::string path;
+    std::string name;
+    uint64_t id;
+    uint64_t size;
+    uint32_t codec;
+    std::vector<char> compressed;
+    size_t slot; // in the index
+};
+
+static bool worthCompressing(const std::string &path) {
+    return !endsWith(path, ".png") && !endsWith(path, ".jpg") && !endsWith(path, ".jpeg");
+}
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + AssetPack::ALIGNMENT - 1) / AssetPack::ALIGNMENT * AssetPack::ALIGNMENT;
+}
+
+static int listPack(const std::string &file) {
+    AssetPack pack;
+    if (!pack.open(file))
+        return 1;
+    uint64_t size = 0, stored = 0;
+    for (size_t i = 0; i < pack.count(); ++i) {
+        const AssetPack::Entry &entry = pack.entry(i);
+        std::printf("%-56s %10llu %10llu  %s\n", pack.name(entry), (unsigned long long)entry.size,
+                    (unsigned long long)entry.storedSize, entry.codec == AssetPack::CODEC_LZ4 ? "lz4" : "stored");
+        size += entry.size;
+        stored += entry.storedSize;
+    }
+    std::printf("%zu entries, %.2f MB -> %.2f MB\n", pack.count(), size / 1048576.0, stored / 1048576.0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::string outFile = "assets.pack";
+    unsigned int threads = 0;
+    bool store = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc)
+            outFile = argv[++i];
+        else if (arg == "--list" && i + 1 < argc)
+            return listPack(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--store")
+            store = true;
+        else
+            inputs.push_back(arg);
+    }
+    if (inputs.empty()) {
+        inputs.push_back("models");
+        inputs.push_back("shaders");
+    }
+
+    std::vector<std::string> paths;
+    for (const std::string &input : inputs)
+        listFiles(input, paths);
+    std::vector<PackedFile> files;
+    for (const std::string &path : paths) {
+        std::string name = AssetPack::normalize(path);
+        if (name == AssetPack::normalize(outFile))
+            continue;
+        files.push_back(PackedFile{path, name, AssetPack::id(name), 0, AssetPack::CODEC_STORED, std::vector<char>(), 0});
+    }
+    if (files.empty()) {
+        std::cout << "Nothing to pack" << std::endl;
+        return 1;
+    }
+
+    // Lookups only have the hash, two paths sharing one can't both go in
+    std::vector<PackedFile *> byId;
+    for (PackedFile &file : files)
+        byId.push_back(&file);
+    std::sort(byId.begin(), byId.end(), [](const PackedFile *a, const PackedFile *b) { return a->id < b->id; });
+    for (size_t i = 1; i < byId.size(); ++i) {
+        if (byId[i]->id == byId[i - 1]->id) {
+            std::cout << "ERROR::PBR_PACK::ID_COLLISION " << byId[i - 1]->name << " " << byId[i]->name << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<ThreadPool> pool(threads == 1 ? nullptr : new ThreadPool(threads ? threads - 1 : 0));
+    std::vector<char> failed(files.size(), 0);
+    auto compressRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PackedFile &file = files[i];
+            MappedFile source;
+            if (!source.open(file.path)) {
+                failed[i] = 1;
+                continue;
+            }
+            file.size = source.size();
+            if (store || file.size == 0 || file.size > UINT32_MAX || !worthCompressing(file.path))
+                continue;
+            std::vector<char> compressed = AssetPack::compress(source.data(), source.size());
+            if (compressed.size() <= file.size - file.size / 8) {
+                file.codec = AssetPack::CODEC_LZ4;
+                file.compressed.swap(compressed);
+            }
+        }
+    };
+    if (pool)
+        pool->parallelFor(0, files.size(), 1, compressRange);
+    else
+        compressRange(0, files.size());
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+        return 1;
+
+    // Index in id order for the binary search, data in path order so
+    // assets from one directory sit together
+    std::string names;
+    std::vector<AssetPack::Entry> index;
+    for (PackedFile *file : byId) {
+        file->slot = index.size();
+        index.push_back(AssetPack::Entry{file->id, 0, 0, file->size, file->codec, (uint32_t)names.size()});
+        names.append(file->name.c_str(), file->name.size() + 1);
+    }
+    uint64_t offset = alignUp(sizeof(AssetPack::Header) + index.size() * sizeof(AssetPack::Entry) + names.size());
+    uint64_t totalSize = 0, totalStored = 0;
+    for (const PackedFile &file : files) {
+        AssetPack::Entry &entry = index[file.slot];
+        entry.offset = offset;
+        entry.storedSize = file.codec == AssetPack::CODEC_LZ4 ? file.compressed.size() : file.size;
+        offset = alignUp(offset + entry.storedSize);
+        totalSize += entry.size;
+        totalStored += entry.storedSize;
+    }
+
+    std::ofstream out(outFile.c_str(), std::ios::binary | std::ios::trunc);
+    AssetPack::Header header = {AssetPack::MAGIC, AssetPack::VERSION, (uint32_t)index.size(), (uint32_t)names.size()};
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)index.data(), index.size() * sizeof(AssetPack::Entry));
+    out.write(names.data(), names.size());
+    uint64_t written = sizeof(header) + index.size() * sizeof(AssetPack::Entry) + names.size();
+    const std::vector<char> padding(AssetPack::ALIGNMENT, 0);
+    for (const PackedFile &file : files) {
+        uint64_t aligned = alignUp(written);
+        out.write(padding.data(), (std::streamsize)(aligned - written));
+        written = aligned;
+        if (file.codec == AssetPack::CODEC_LZ4) {
+            out.write(file.compressed.data(), file.compressed.size());
+            written += file.compressed.size();
+        } else {
+            MappedFile source;
+            if (file.size && (!source.open(file.path) || source.size() != file.size)) {
+                std::cout << "ERROR::PBR_PACK::FILE_CHANGED " << file.path << std::endl;
+                return 1;
+            }
+            out.write(source.data(), (std::streamsize)file.size);
+            written += file.size;
+        }
+    }
+    if (!out) {
+        std::cout << "ERROR::PBR_PACK::FILE_NOT_WRITTEN " << outFile << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu entries, %.2f MB -> %.2f MB in %.2f s (%u threads) -> %s\n", files.size(),
+                totalSize / 1048576.0, totalStored / 1048576.0, seconds, pool ? pool->size() + 1 : 1,
+                outFile.c_str());
+    return 0;
+}